@@ -72,6 +72,13 @@
 
 #include "LinuxBaseLibrary.h"
 #include "LinuxCOSEMServer.h"
+#include "LinuxClientAssociation.h"
+#include "LinuxAssociationPool.h"
+#include "LinuxAttributeCache.h"
+#include "LinuxRegistration.h"
+#include "LinuxMetrics.h"
+#include "LinuxRelay.h"
+#include "UplinkEncoder.h"
 
 #include "HDLCLLC.h"
 #include "COSEM.h"
@@ -91,254 +98,63 @@
 #include <functional>
 #include <string>
 #include <chrono>
+#include <cmath>
 #include <thread>
 #include <memory>
 #include <numeric>
 #include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
 
-class LinuxClientEngine : public EPRI::COSEMClientEngine
-{
+/// Thin handle onto one meter association.  Copies share the association,
+/// so completion callbacks can safely capture an APsim by value.
+class APsim {
 public:
-    LinuxClientEngine() = delete;
-    LinuxClientEngine(const Options& Opt, EPRI::Transport * pXPort) :
-        pXPort(pXPort),
-        COSEMClientEngine(Opt, pXPort)
-    {
-    }
-    virtual ~LinuxClientEngine()
-    {
-        delete pXPort;
-    }
-
-    virtual bool OnOpenConfirmation(EPRI::COSEMAddressType ServerAddress)
-    {
-        EPRI::Base()->GetDebug()->TRACE("Associated with Server %d...\n",
-            ServerAddress);
-        return true;
-    }
-
-    virtual bool OnGetConfirmation(RequestToken Token, const GetResponse& Response)
-    {
-        EPRI::Base()->GetDebug()->TRACE("Get Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid && Response.Result.which() == EPRI::Get_Data_Result_Choice::data_access_result)
-        {
-            EPRI::Base()->GetDebug()->TRACE("\tReturned Error Code %d...\n",
-                Response.Result.get<EPRI::APDUConstants::Data_Access_Result>());
-            return false;
-        }
+    using Completion = EPRI::LinuxClientAssociation::CompletionFunction;
+    using GetCompletion = EPRI::LinuxClientAssociation::GetCompletionFunction;
+    using GetListCompletion = EPRI::LinuxClientAssociation::GetListCompletionFunction;
 
-        switch(Response.Descriptor.class_id) {
-            case EPRI::CLSID_IData:
-                {
-                    EPRI::IData     SerialNumbers;
-                    EPRI::DLMSValue Value;
-
-                    SerialNumbers.value = Response.Result.get<EPRI::DLMSVector>();
-                    if (EPRI::COSEMType::VALUE_RETRIEVED == SerialNumbers.value.GetNextValue(&Value))
-                    {
-                        recent = EPRI::DLMSValueGet<EPRI::VISIBLE_STRING_CType>(Value);
-                        std::cout << "Setting recent to \"" << recent << "\"\n";
-                        EPRI::Base()->GetDebug()->TRACE("%s\n", recent.c_str());
-                    }
+    /// one attribute of one COSEM object, as read by GetList
+    struct Attribute {
+        unsigned class_id;
+        unsigned attribute;
+        std::string obis;
+    };
 
-                }
-                break;
-            case EPRI::CLSID_IAssociationLN:
-                {
-                    EPRI::IAssociationLN CurrentAssociation;
-                    EPRI::DLMSValue      Value;
-
-                    switch (Response.Descriptor.attribute_id)
-                    {
-                    case EPRI::IAssociationLN::ATTR_PARTNERS_ID:
-                        {
-                            CurrentAssociation.associated_partners_id = Response.Result.get<EPRI::DLMSVector>();
-                            if (EPRI::COSEMType::VALUE_RETRIEVED == CurrentAssociation.associated_partners_id.GetNextValue(&Value) &&
-                                IsSequence(Value))
-                            {
-                                EPRI::DLMSSequence& Element = DLMSValueGetSequence(Value);
-                                EPRI::Base()->GetDebug()->TRACE("ClientSAP %d; ServerSAP %d\n",
-                                    EPRI::DLMSValueGet<EPRI::INTEGER_CType>(Element[0]),
-                                    EPRI::DLMSValueGet<EPRI::LONG_UNSIGNED_CType>(Element[1]));
-                            }
-                        }
-                        break;
-
-                    default:
-                        EPRI::Base()->GetDebug()->TRACE("Attribute %d not supported for parsing.", Response.Descriptor.attribute_id);
-                        break;
-                    }
-                }
-                break;
-        }
-        return true;
-    }
-
-    virtual bool OnSetConfirmation(RequestToken Token, const SetResponse& Response)
-    {
-        EPRI::Base()->GetDebug()->TRACE("Set Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid)
-        {
-            EPRI::Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
-                Response.Result);
-        }
-        return true;
-    }
-
-    virtual bool OnActionConfirmation(RequestToken Token, const ActionResponse& Response)
-    {
-        EPRI::Base()->GetDebug()->TRACE("Action Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid)
-        {
-            EPRI::Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
-                Response.Result);
-        }
-        return true;
-    }
-
-    virtual bool OnReleaseConfirmation()
+    APsim(EPRI::LinuxBaseLibrary& bl, const std::string& meterURL, int SourceAddress = 1)
+        : meterURL{meterURL}
+        , m_pAssociation{std::make_shared<EPRI::LinuxClientAssociation>(bl.get_io_service(),
+            EPRI::LinuxClientAssociation::Options(SourceAddress))}
     {
-        EPRI::Base()->GetDebug()->TRACE("Release Confirmation from Server\n");
-        return true;
     }
 
-    virtual bool OnReleaseConfirmation(EPRI::COSEMAddressType ServerAddress)
+    /// wraps an association which is already open, such as one taken from a
+    /// pool
+    APsim(const std::string& meterURL, std::shared_ptr<EPRI::LinuxClientAssociation> pAssociation)
+        : meterURL{meterURL}
+        , m_pAssociation{pAssociation}
     {
-        EPRI::Base()->GetDebug()->TRACE("Release Confirmation from Server %d\n", ServerAddress);
-        return true;
-    }
-
-    virtual bool OnAbortIndication(EPRI::COSEMAddressType ServerAddress)
-    {
-        if (EPRI::INVALID_ADDRESS == ServerAddress)
-        {
-            EPRI::Base()->GetDebug()->TRACE("Abort Indication.  Not Associated.\n");
-        }
-        else
-        {
-            EPRI::Base()->GetDebug()->TRACE("Abort Indication from Server %d\n", ServerAddress);
-        }
-        return true;
-    }
-
-    std::string recent_data() const {
-        return recent;
     }
-private:
-    EPRI::Transport * pXPort{nullptr};
-    std::string recent;
-};
 
-
-class APsim {
-public:
-    APsim(EPRI::LinuxBaseLibrary& bl, const std::string& meterURL, int SourceAddress = 1)
-        : bl(bl)
-        , m_pClientEngine{EPRI::COSEMClientEngine::Options(SourceAddress),
-            new EPRI::TCPWrapper((m_pSocket = EPRI::Base()->GetCore()->GetIP()->CreateSocket(EPRI::LinuxIP::Options(EPRI::LinuxIP::Options::MODE_CLIENT, EPRI::LinuxIP::Options::VERSION6))))}
-    {
-        if (EPRI::SUCCESSFUL != m_pSocket->Open(meterURL.c_str()))
-        {
-            std::cout << "Failed to initiate connect to " << meterURL << "\n";
-        }
-    }
-    ~APsim()
+    bool open(Completion done)
     {
-        if (m_pSocket)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds{100});
-            bl.get_io_service().poll();
-            EPRI::Base()->GetCore()->GetIP()->ReleaseSocket(m_pSocket);
-            m_pSocket = nullptr;
-            std::cout << "Socket released.\n";
-        }
-        else
-        {
-            std::cout << "TCP Not Opened!\n";
-        }
-    }
-    bool open()
-    {
-        static constexpr int max_tries{400};
-        int tries{max_tries};
-        do {
-            std::this_thread::sleep_for(std::chrono::milliseconds{100});
-            bl.get_io_service().poll();
-            if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsTransportConnected())
-            {
-                bool Send = true;
-                int DestinationAddress = 1;
-                EPRI::COSEMSecurityOptions::SecurityLevel Security = EPRI::COSEMSecurityOptions::SECURITY_NONE;
-                EPRI::COSEMSecurityOptions SecurityOptions;
-                SecurityOptions.ApplicationContextName = SecurityOptions.ContextLNRNoCipher;
-                size_t APDUSize = 640;
-                m_pClientEngine.Open(DestinationAddress,
-                                      SecurityOptions,
-                                      EPRI::xDLMS::InitiateRequest(APDUSize));
-            }
-            else
-            {
-                // std::cout << "Transport Connection Not Established Yet!\n";
-                --tries;
-            }
-        } while (!(m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsTransportConnected()) && tries > 0);
-        return tries;
+        return m_pAssociation->Open(meterURL, done);
     }
 
-    bool close()
+    bool close(Completion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (!m_pClientEngine.Release(EPRI::xDLMS::InitiateRequest()))
+        if (!m_pAssociation->Release(done))
         {
-            std::cout << "Problem submitting COSEM Release!\n";
+            std::clog << "Problem submitting COSEM Release!\n";
             return false;
         }
         return true;
     }
 
-    bool serviceConnect(bool reconnect)
-    {
-        return Action(70, (reconnect ? 2 : 1), "0-0:96.3.10*255", nullptr);
-    }
-
-    bool Action(unsigned class_id, unsigned method, std::string obis, EPRI::COSEMType MyData)
+    bool Get(unsigned class_id, unsigned attribute, std::string obis, GetCompletion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
-        {
-            EPRI::Cosem_Method_Descriptor Descriptor;
-
-            Descriptor.class_id = (EPRI::ClassIDType)class_id;
-            Descriptor.method_id = (EPRI::ObjectAttributeIdType)method;
-            if (Descriptor.instance_id.Parse(obis))
-            {
-                if (m_pClientEngine.Action(Descriptor,
-                                        EPRI::DLMSOptional<EPRI::DLMSVector>(MyData),
-                                        &m_ActionToken))
-                {
-                    PrintLine(std::string("\tAction Request Sent: Token ") + std::to_string(m_ActionToken) + "\n");
-                    return true;
-                }
-            }
-            else
-            {
-                PrintLine("Malformed OBIS Code!\n");
-            }
-        }
-        else
-        {
-            PrintLine("Not Connected!\n");
-        }
-        return false;
-    }
-
-    bool Get(unsigned class_id, unsigned attribute, std::string obis)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
+        if (m_pAssociation->IsAssociated())
         {
             EPRI::Cosem_Attribute_Descriptor Descriptor;
 
@@ -346,9 +162,9 @@ public:
             Descriptor.attribute_id = (EPRI::ObjectAttributeIdType)attribute;
             if (Descriptor.instance_id.Parse(obis))
             {
-                if (m_pClientEngine.Get(Descriptor, &m_GetToken))
+                if (m_pAssociation->Get(Descriptor, done))
                 {
-                    PrintLine(std::string("\tGet Request Sent: Token ") + std::to_string(m_GetToken) + "\n");
+                    PrintLine("\tGet Request Sent\n");
                     return true;
                 }
             }
@@ -364,27 +180,26 @@ public:
         return false;
     }
 
-    bool Set(unsigned class_id, unsigned attribute, std::string obis, EPRI::COSEMType MyData)
+    bool GetList(const std::vector<Attribute>& attributes, GetListCompletion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
+        if (m_pAssociation->IsAssociated())
         {
-            EPRI::Cosem_Attribute_Descriptor Descriptor;
+            std::vector<EPRI::Cosem_Attribute_Descriptor> Descriptors(attributes.size());
 
-            Descriptor.class_id = (EPRI::ClassIDType)class_id;
-            Descriptor.attribute_id = (EPRI::ObjectAttributeIdType)attribute;
-            if (Descriptor.instance_id.Parse(obis))
+            for (std::size_t i = 0; i < attributes.size(); ++i)
             {
-                if (m_pClientEngine.Set(Descriptor, MyData, &m_SetToken))
+                Descriptors[i].class_id = (EPRI::ClassIDType)attributes[i].class_id;
+                Descriptors[i].attribute_id = (EPRI::ObjectAttributeIdType)attributes[i].attribute;
+                if (!Descriptors[i].instance_id.Parse(attributes[i].obis))
                 {
-                    PrintLine(std::string("\tSet Request Sent: Token ") + std::to_string(m_SetToken) + "\n");
-                    return true;
+                    PrintLine("Malformed OBIS Code!\n");
+                    return false;
                 }
             }
-            else
+            if (m_pAssociation->GetList(Descriptors, done))
             {
-                PrintLine("Malformed OBIS Code!\n");
+                PrintLine("\tGet List Request Sent\n");
+                return true;
             }
         }
         else
@@ -393,149 +208,287 @@ public:
         }
         return false;
     }
+
     void PrintLine(const std::string& str) const {
-        std::cout << str;
+        std::clog << str;
     }
-    std::string recent_data() const {
-        return m_pClientEngine.recent_data();
+    /// extracts the string carried by a Data object get response
+    static std::string recent_data(const EPRI::COSEMClientEngine::GetResponse& Response) {
+        EPRI::IData     SerialNumbers;
+        EPRI::DLMSValue Value;
+
+        SerialNumbers.value = Response.Result.get<EPRI::DLMSVector>();
+        if (EPRI::COSEMType::VALUE_RETRIEVED == SerialNumbers.value.GetNextValue(&Value))
+        {
+            return EPRI::DLMSValueGet<EPRI::VISIBLE_STRING_CType>(Value);
+        }
+        return {};
     }
 private:
-    EPRI::LinuxBaseLibrary& bl;
-    EPRI::ISocket* m_pSocket = nullptr;
-    LinuxClientEngine m_pClientEngine;
-    EPRI::COSEMClientEngine::RequestToken m_GetToken;
-    EPRI::COSEMClientEngine::RequestToken m_SetToken;
-    EPRI::COSEMClientEngine::RequestToken m_ActionToken;
+    std::string meterURL;
+    std::shared_ptr<EPRI::LinuxClientAssociation> m_pAssociation;
 };
 
+/// The set of meters the AP reads and the payload size to read from them,
+/// as maintained by the HES through the registration protocol (see
+/// EPRI::RegistrationMessage).
+///
+/// Readers get an immutable Snapshot through an atomically swapped
+/// shared_ptr, so the polling loop sees a consistent view without locking
+/// or copying.  Each registration message publishes a fresh snapshot; the
+/// writers' mutex never blocks a reader.
 class Config {
 public:
     enum class Payload { small, medium, large };
+    struct Snapshot {
+        std::vector<std::string> meters;
+        Payload payload_size{Payload::small};
+    };
+    Config()
+        : current_{std::make_shared<const Snapshot>()}
+    {}
     Config(const Config& other) = delete;
     Config(Config&& other) = delete;
-    Config(const std::string& data) {
-        if (!std::all_of(data.cbegin(), data.cend(), isprint)) {
-            throw std::range_error("invalid string");
+    /// applies one registration message and returns its sequence number,
+    /// or 0 if it was rejected; a delta which does not follow on from the
+    /// last message applied is rejected
+    uint32_t apply(const EPRI::RegistrationMessage& msg) {
+        const std::lock_guard<std::mutex> lock(mtx_);
+        if (msg.m_Payload > static_cast<uint8_t>(Payload::large)) {
+            std::cerr << "invalid Payload size " << unsigned(msg.m_Payload) << '\n';
+            return 0;
         }
-        std::stringstream ss{data};
-        std::string item;
-        std::string plsize;
-        if (std::getline(ss, plsize, ',')) {
-            while (std::getline(ss, item, ',')) {
-                meters_.emplace_back(item);
-            }
-            if (plsize == "small") {
-                payload_size_ = Payload::small;
-                std::swap(meters_, meters_);
-            } else if (plsize == "medium") {
-                payload_size_ = Payload::medium;
-                std::swap(meters_, meters_);
-            } else if (plsize == "large") {
-                payload_size_ = Payload::large;
-                std::swap(meters_, meters_);
+        if (msg.m_Type == EPRI::RegistrationMessage::SNAPSHOT) {
+            meters_.clear();
+        } else if (msg.m_Sequence != sequence_ + 1) {
+            std::clog << "Ignoring registration delta " << msg.m_Sequence
+                << ", expected " << sequence_ + 1 << '\n';
+            return 0;
+        }
+        for (const auto& change : msg.m_Changes) {
+            if (change.first == EPRI::RegistrationMessage::ADD) {
+                meters_.insert(change.second);
             } else {
-                throw std::range_error("invalid Payload size");
+                meters_.erase(change.second);
             }
         }
+        auto next{std::make_shared<Snapshot>()};
+        next->meters.assign(meters_.cbegin(), meters_.cend());
+        next->payload_size = static_cast<Payload>(msg.m_Payload);
+        std::atomic_store(&current_, std::shared_ptr<const Snapshot>{std::move(next)});
+        sequence_ = msg.m_Sequence;
+        return sequence_;
     }
-    void interpret(const std::string& data) {
-        try {
-            Config other{data};
-            const std::lock_guard<std::mutex> lock(mtx_);
-            std::swap(meters_, other.meters_);
-            std::swap(payload_size_, other.payload_size_);
-        } catch (std::range_error r) {
-            std::cerr << r.what() << ": " << data << '\n';
-        }
-    }
-    std::vector<std::string> meters() const {
-        const std::lock_guard<std::mutex> lock(mtx_);
-        return meters_;
-    }
-    std::size_t count() const { 
-        const std::lock_guard<std::mutex> lock(mtx_);
-        return meters_.size();
-    }
-    const Payload payload_size() const {
-        const std::lock_guard<std::mutex> lock(mtx_);
-        return payload_size_;
-    }
-    void clear() {
-        const std::lock_guard<std::mutex> lock(mtx_);
-        meters_.clear();
+    /// the current configuration; it never changes once published
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load(&current_);
     }
 private:
-    Payload payload_size_;
-    std::vector<std::string> meters_{};
-    mutable std::mutex mtx_;
+    std::shared_ptr<const Snapshot> current_;
+    // writer-side state, only touched under mtx_
+    std::set<std::string> meters_{};
+    uint32_t sequence_{0};
+    std::mutex mtx_;
 };
 
-/// very simple class representing a meter reading
-struct MeterReading {
-    std::string meterAddr;
-    std::string meterData;
-    friend std::ostream& operator<<(std::ostream& out, const MeterReading& mr) {
-        return out << "{\"meter\":\"" << mr.meterAddr << "\",\"data\":\"" << mr.meterData << "\"}";
+/// sets which classes the AP caches, and for how long
+void configureCache(EPRI::LinuxAttributeCache& cache) {
+    // the Data objects hold serial number strings; the disconnect
+    // control's state is also invalidated by any ACTION sent to it
+    cache.SetTTL(1, std::chrono::seconds{60});
+    cache.SetTTL(70, std::chrono::seconds{10});
+}
+
+/// Keeps up to a fixed number of meter transactions in flight at once on the
+/// shared io_service and reports each one as soon as it finishes.  Associations
+/// are kept open in a pool between runs, so a meter only pays for the connect
+/// and AARQ/AARE on first contact or after its association was lost.  Values
+/// which rarely change are kept in an attribute cache and answered without
+/// a FAN round trip until their time to live runs out.
+class MeterPoller {
+public:
+    using Completion = std::function<void(const MeterReading&)>;
+
+    /// the time and outcome of every transaction is recorded in metrics
+    MeterPoller(EPRI::LinuxBaseLibrary& bl, EPRI::LinuxMetrics& metrics, std::size_t concurrency = 64,
+            uint32_t idleTimeOutInMS = 60000)
+        : bl(bl)
+        , concurrency_{std::max<std::size_t>(concurrency, 1)}
+        , metrics_(metrics)
+        , pool_{bl.get_io_service(),
+            EPRI::LinuxClientAssociation::Options(client_address, 1, 640, 40000, 16, &metrics), idleTimeOutInMS}
+    {
+        configureCache(cache_);
+    }
+
+    const EPRI::LinuxAttributeCache& cache() const { return cache_; }
+
+    void run(const std::vector<std::string>& meters, const std::string& obis, const Completion& done) {
+        auto& io = bl.get_io_service();
+        // catch up on closes and aborts which arrived while we were idle so
+        // that the pool sees which associations are still alive
+        io.poll();
+        io.reset();
+        auto next{meters.cbegin()};
+        std::size_t in_flight{0};
+        std::function<void()> launch;
+        auto finish = [&](const std::string& meter, const std::string& data) {
+            done(MeterReading{meter, data});
+            --in_flight;
+            launch();
+        };
+        launch = [&]() {
+            for ( ; next != meters.cend() && in_flight < concurrency_; ++next) {
+                ++in_flight;
+                read(*next, obis, finish);
+            }
+        };
+        launch();
+        while (in_flight) {
+            io.run_one();
+            if (io.stopped()) {
+                io.reset();
+            }
+        }
+        // let the released sockets be cleaned up
+        io.poll();
+        io.reset();
     }
-};
 
-std::vector<MeterReading> runScript(EPRI::LinuxBaseLibrary& bl, const Config& cfg) {
-    std::vector<MeterReading> result;
-    const auto meters{cfg.meters()};
-    for (const auto& metername : meters) {
-        std::cout << "Trying to connect to meter at " << metername << "\n";
-        APsim apsim(bl, metername);
-        apsim.open();
-        switch (cfg.payload_size()) {
-            case Config::Payload::medium:
-                apsim.Get(1, 2, "0-0:96.1.4*255");
-                break;
-            case Config::Payload::large:
-                apsim.Get(1, 2, "0-0:96.1.9*255");
-                break;
-            default:
-                apsim.Get(1, 2, "0-0:96.1.0*255");
-                break;
+private:
+    using Finish = std::function<void(const std::string&, const std::string&)>;
+
+    /// the client SAP of every association the poller opens
+    static constexpr uint16_t client_address{1};
+
+    /// read one meter over a pooled association; finish is called exactly once
+    void read(const std::string& meter, const std::string& obis, Finish finish) {
+        std::string cached;
+        if (cache_.Find(meter, client_address, 1, obis, 2, &cached)) {
+            // answered locally, but still from the io_service so that run()
+            // is not re-entered from its own launch loop
+            bl.get_io_service().post([meter, cached, finish]() { finish(meter, cached); });
+            return;
         }
-        apsim.close();
-        std::cout << "Saving " << apsim.recent_data() << "\n";
-        result.emplace_back(MeterReading{metername, apsim.recent_data()});
+        std::clog << "Reading meter at " << meter << "\n";
+        const auto started{std::chrono::steady_clock::now()};
+        auto complete = [this, meter, obis, started, finish](bool ok, const std::string& data) {
+            metrics_.RecordMeter(meter, std::chrono::steady_clock::now() - started, ok);
+            if (ok) {
+                cache_.Store(meter, client_address, 1, obis, 2, data);
+            }
+            finish(meter, ok ? data : "");
+        };
+        pool_.Acquire(meter, [this, meter, obis, complete](EPRI::LinuxAssociationPool::AssociationPtr pAssociation) {
+            if (!pAssociation) {
+                complete(false, "");
+                return;
+            }
+            APsim apsim(meter, pAssociation);
+            // a payload beyond the negotiated APDU size comes back in
+            // blocks, which the association's wrapper socket reassembles
+            auto sent = apsim.Get(1, 2, obis, [this, meter, pAssociation, complete](bool ok,
+                    const EPRI::COSEMClientEngine::GetResponse& Response) {
+                pool_.Restore(meter, pAssociation);
+                complete(ok, ok ? APsim::recent_data(Response) : "");
+            });
+            if (!sent) {
+                pool_.Restore(meter, pAssociation);
+                complete(false, "");
+            }
+        });
     }
-    return result;
+
+    EPRI::LinuxBaseLibrary& bl;
+    std::size_t concurrency_;
+    EPRI::LinuxMetrics& metrics_;
+    EPRI::LinuxAssociationPool pool_;
+    EPRI::LinuxAttributeCache cache_;
+};
+
+void runScript(MeterPoller& poller, const Config& cfg, UplinkEncoder& uplink) {
+    const auto snapshot{cfg.snapshot()};
+    std::string obis;
+    switch (snapshot->payload_size) {
+        case Config::Payload::medium:
+            obis = "0-0:96.1.4*255";
+            break;
+        case Config::Payload::large:
+            obis = "0-0:96.1.9*255";
+            break;
+        default:
+            obis = "0-0:96.1.0*255";
+            break;
+    }
+    uplink.begin();
+    poller.run(snapshot->meters, obis, [&uplink](const MeterReading& reading) {
+        uplink.add(reading);
+    });
+    uplink.end();
 }
 
 
 using asio::ip::tcp;
 
+/// One registration session from the HES.  Frames are parsed as they
+/// arrive, however the stream is split up, and each one is acknowledged.
 class tcp_connection : public std::enable_shared_from_this<tcp_connection>
 {
 public:
-    tcp_connection(tcp::socket socket) 
+    tcp_connection(tcp::socket socket, Config& cfg) 
         : socket_(std::move(socket))
+        , cfg_(cfg)
+        , parser_{[this](const EPRI::RegistrationMessage& msg) {
+            EPRI::RegistrationMessage::EncodeAck(cfg_.apply(msg), &acks_);
+        }}
     {}
 
-    void start(Config& cfg) {
-        std::string remote{socket_.remote_endpoint().address().to_string()};
+    void start() {
+        do_read();
+    }
+
+private:
+    void do_read() {
+        auto self{shared_from_this()};
         socket_.async_read_some(asio::buffer(data_, max_length),
-            std::bind(&tcp_connection::handle_read, this,
-                std::placeholders::_1,
-                std::placeholders::_2,
-                std::ref(cfg))
-        );
+            [this, self](const std::error_code& error, std::size_t bytes_transferred) {
+                if (error) {
+                    if (error != asio::error::eof) {
+                        std::clog << "Registration read failed: " << error.message() << '\n';
+                    }
+                    return;
+                }
+                if (!parser_.Parse(data_, bytes_transferred)) {
+                    std::cerr << "Malformed registration message\n";
+                    return;
+                }
+                if (acks_.empty()) {
+                    do_read();
+                } else {
+                    do_write();
+                }
+            });
     }
 
-    void handle_read(const std::error_code& error, size_t bytes_transferred, Config& cfg) {
-        if (!error) {
-            cfg.interpret(std::string{data_, bytes_transferred});
-        } else {
-            std::cout << "Got an error in 'handle_read()' on line " << __LINE__ << std::endl;
-        }
+    void do_write() {
+        auto self{shared_from_this()};
+        sending_.swap(acks_);
+        asio::async_write(socket_, asio::buffer(sending_),
+            [this, self](const std::error_code& error, std::size_t) {
+                sending_.clear();
+                if (!error) {
+                    do_read();
+                }
+            });
     }
 
-private:
     tcp::socket socket_;
-    static constexpr unsigned max_length{1024};
-    char data_[max_length];
+    Config& cfg_;
+    EPRI::RegistrationParser parser_;
+    std::vector<uint8_t> acks_;
+    std::vector<uint8_t> sending_;
+    static constexpr unsigned max_length{4096};
+    uint8_t data_[max_length];
 };
 
 class RegistrationServer {
@@ -545,7 +498,7 @@ public:
         , acceptor_{io_service, tcp::endpoint(tcp::v6(), 4059)}
         , cfg{cfg}
     {
-        std::cout << "Listening on port 4059\n";
+        std::clog << "Listening on port 4059\n";
         do_accept();
     }
 private:
@@ -553,7 +506,7 @@ private:
         acceptor_.async_accept(socket_,
             [this](std::error_code ec) {
                 if (!ec) {
-                    std::make_shared<tcp_connection>(std::move(socket_))->start(cfg);
+                    std::make_shared<tcp_connection>(std::move(socket_), cfg)->start();
                 }
                 do_accept();
             });
@@ -564,43 +517,105 @@ private:
     Config& cfg;
 };
 
-void regs(Config& cfg) {
+/// Answers every connection on the loopback interface with the current
+/// metrics as a JSON document and then closes it, so that they can be
+/// read with nothing more than a TCP connect (the taskrunner's {metrics}
+/// command does just that).
+class MetricsServer {
+public:
+    static constexpr unsigned short port{9101};
+
+    MetricsServer(asio::io_service& io_service, const EPRI::LinuxMetrics& metrics)
+        : socket_{io_service}
+        , acceptor_{io_service, tcp::endpoint(asio::ip::address_v6::loopback(), port)}
+        , metrics_(metrics)
+    {
+        do_accept();
+    }
+private:
+    void do_accept() {
+        acceptor_.async_accept(socket_,
+            [this](std::error_code ec) {
+                if (!ec) {
+                    auto socket{std::make_shared<tcp::socket>(std::move(socket_))};
+                    auto report{std::make_shared<std::string>(metrics_.ToJSON() + '\n')};
+                    asio::async_write(*socket, asio::buffer(*report),
+                        [socket, report](const std::error_code&, std::size_t) {});
+                }
+                do_accept();
+            });
+    }
+
+    tcp::socket socket_;
+    tcp::acceptor acceptor_;
+    const EPRI::LinuxMetrics& metrics_;
+};
+
+/// copies the allocator's and the trace queue's figures into metrics, so
+/// that the metrics endpoint reports them along with the transactions
+void publishProcess(EPRI::LinuxBaseLibrary& bl, EPRI::LinuxMetrics& metrics) {
+    const auto memory{bl.GetMemory()->GetStatistics()};
+    metrics.SetGauge("memory_bytes_live", memory.BytesLive);
+    metrics.SetGauge("memory_high_water_mark", memory.HighWaterMark);
+    metrics.SetGauge("memory_allocations", memory.Allocations);
+    metrics.SetGauge("memory_allocations_per_sec", std::llround(memory.AllocationsPerSecond));
+    metrics.SetGauge("trace_lines_dropped", bl.GetDebug()->Dropped());
+}
+
+void regs(Config& cfg, const EPRI::LinuxMetrics& metrics) {
     try {
         asio::io_service io_service;
         RegistrationServer regServer(io_service, cfg);
+        MetricsServer metricsServer(io_service, metrics);
+        // the relay has a cache of its own, as it runs on this thread
+        // and the poller's is only used from the main one
+        EPRI::LinuxAttributeCache relayCache;
+        configureCache(relayCache);
+        EPRI::LinuxRelay relay(io_service, EPRI::LinuxRelay::Options(EPRI::LinuxRelay::DEFAULT_PORT, 60000,
+            &relayCache));
+        std::clog << "Relaying DLMS associations on port " << relay.GetPort() << '\n';
         io_service.run();
     } catch (std::exception& err) {
         std::cerr << err.what() << '\n';
     }
 }
 
-std::ostream& operator<<(std::ostream& out, const std::vector<MeterReading>& readings) {
-    out << "{\"meterdata\":[\n";
-    auto it{readings.cbegin()};
-    auto end{readings.cend()};
-    if (it != end) {
-        out << *it++;
-        for ( ; it != end; ++it) {
-            out << ",\n" << *it;
-        }
-    }
-    return out << "\n]}";
-}
-
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: APsim APaddress\n";
+    if (argc < 2 || argc > 4) {
+        std::cerr << "Usage: APsim APaddress [concurrency [json|binary]]\n";
         return 1;
     }
     std::string APaddress{argv[1]};
-    Config cfg("small,");
+    std::size_t concurrency{64};
+    if (argc >= 3) {
+        try {
+            concurrency = std::stoul(argv[2]);
+        } catch (const std::exception&) {
+            std::cerr << "Invalid concurrency \"" << argv[2] << "\"\n";
+            return 1;
+        }
+    }
+    auto framing{UplinkEncoder::Framing::json};
+    if (argc == 4) {
+        if (std::string{argv[3]} == "binary") {
+            framing = UplinkEncoder::Framing::binary;
+        } else if (std::string{argv[3]} != "json") {
+            std::cerr << "Invalid framing \"" << argv[3] << "\"\n";
+            return 1;
+        }
+    }
+    Config cfg;
     EPRI::LinuxBaseLibrary bl;
-    std::thread thr{regs, std::ref(cfg)};
+    EPRI::LinuxMetrics metrics;
+    MeterPoller poller(bl, metrics, concurrency);
+    UplinkEncoder uplink(std::cout, framing);
+    std::thread thr{regs, std::ref(cfg), std::cref(metrics)};
     while (1) {
-        std::cout << "There are " << cfg.count() << " registered meters\n";
-        auto meterdata{runScript(bl, cfg)};
-        std::cout << meterdata << '\n';
-        cfg.clear();
+        std::clog << "There are " << cfg.snapshot()->meters.size() << " registered meters\n";
+        runScript(poller, cfg, uplink);
+        std::clog << "Attribute cache holds " << poller.cache().Size() << " values; "
+            << poller.cache().GetHits() << " hits, " << poller.cache().GetMisses() << " misses\n";
+        publishProcess(bl, metrics);
         std::this_thread::sleep_for(std::chrono::milliseconds{1500});
     }
 } 
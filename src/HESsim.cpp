@@ -72,6 +72,10 @@
 
 #include "LinuxBaseLibrary.h"
 #include "LinuxCOSEMServer.h"
+#include "LinuxClientAssociation.h"
+#include "LinuxMetrics.h"
+#include "LinuxRegistration.h"
+#include "ReadScheduler.h"
 
 #include "HDLCLLC.h"
 #include "COSEM.h"
@@ -87,6 +91,7 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <iomanip>
+#include <sstream>
 #include <asio.hpp>
 #include <algorithm>
 #include <string>
@@ -94,224 +99,100 @@
 #include <thread>
 #include <memory>
 #include <numeric>
+#include <array>
+#include <iterator>
 #include <set>
-
-class LinuxClientEngine : public EPRI::COSEMClientEngine
-{
+#include <mutex>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+#include <functional>
+
+/// Thin handle onto one meter association.  Copies share the association,
+/// so completion callbacks can safely capture a HESsim by value.
+class HESsim {
 public:
-    LinuxClientEngine() = delete;
-    LinuxClientEngine(const Options& Opt, EPRI::Transport * pXPort) :
-        pXPort(pXPort),
-        COSEMClientEngine(Opt, pXPort)
-    {
-    }
-    virtual ~LinuxClientEngine()
-    {
-        delete pXPort;
-    }
-
-    virtual bool OnOpenConfirmation(EPRI::COSEMAddressType ServerAddress)
-    {
-        EPRI::Base()->GetDebug()->TRACE("Associated with Server %d...\n",
-            ServerAddress);
-        return true;
-    }
+    using Completion = EPRI::LinuxClientAssociation::CompletionFunction;
+    using GetCompletion = EPRI::LinuxClientAssociation::GetCompletionFunction;
+    using GetListCompletion = EPRI::LinuxClientAssociation::GetListCompletionFunction;
+
+    /// one attribute of one COSEM object, as read by GetList
+    struct Attribute {
+        unsigned class_id;
+        unsigned attribute;
+        std::string obis;
+    };
 
-    virtual bool OnGetConfirmation(RequestToken Token, const GetResponse& Response)
+    HESsim(EPRI::LinuxBaseLibrary& bl, const std::string& meterURL, int SourceAddress = 1)
+        : meterURL{meterURL}
+        , m_pAssociation{std::make_shared<EPRI::LinuxClientAssociation>(bl.get_io_service(),
+            EPRI::LinuxClientAssociation::Options(SourceAddress))}
     {
-        EPRI::Base()->GetDebug()->TRACE("Get Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid && Response.Result.which() == EPRI::Get_Data_Result_Choice::data_access_result)
-        {
-            EPRI::Base()->GetDebug()->TRACE("\tReturned Error Code %d...\n",
-                Response.Result.get<EPRI::APDUConstants::Data_Access_Result>());
-            return false;
-        }
-
-        switch(Response.Descriptor.class_id) {
-            case EPRI::CLSID_IData:
-                {
-                    EPRI::IData     SerialNumbers;
-                    EPRI::DLMSValue Value;
-
-                    SerialNumbers.value = Response.Result.get<EPRI::DLMSVector>();
-                    if (EPRI::COSEMType::VALUE_RETRIEVED == SerialNumbers.value.GetNextValue(&Value))
-                    {
-                        EPRI::Base()->GetDebug()->TRACE("%s\n", EPRI::DLMSValueGet<EPRI::VISIBLE_STRING_CType>(Value).c_str());
-                    }
-
-                }
-                break;
-            case EPRI::CLSID_IAssociationLN:
-                {
-                    EPRI::IAssociationLN CurrentAssociation;
-                    EPRI::DLMSValue      Value;
-
-                    switch (Response.Descriptor.attribute_id)
-                    {
-                    case EPRI::IAssociationLN::ATTR_PARTNERS_ID:
-                        {
-                            CurrentAssociation.associated_partners_id = Response.Result.get<EPRI::DLMSVector>();
-                            if (EPRI::COSEMType::VALUE_RETRIEVED == CurrentAssociation.associated_partners_id.GetNextValue(&Value) &&
-                                IsSequence(Value))
-                            {
-                                EPRI::DLMSSequence& Element = DLMSValueGetSequence(Value);
-                                EPRI::Base()->GetDebug()->TRACE("ClientSAP %d; ServerSAP %d\n",
-                                    EPRI::DLMSValueGet<EPRI::INTEGER_CType>(Element[0]),
-                                    EPRI::DLMSValueGet<EPRI::LONG_UNSIGNED_CType>(Element[1]));
-                            }
-                        }
-                        break;
-
-                    default:
-                        EPRI::Base()->GetDebug()->TRACE("Attribute %d not supported for parsing.", Response.Descriptor.attribute_id);
-                        break;
-                    }
-                }
-                break;
-        }
-        return true;
     }
 
-    virtual bool OnSetConfirmation(RequestToken Token, const SetResponse& Response)
+    bool open(Completion done)
     {
-        EPRI::Base()->GetDebug()->TRACE("Set Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid)
-        {
-            EPRI::Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
-                Response.Result);
-        }
-        return true;
+        return m_pAssociation->Open(meterURL, done);
     }
 
-    virtual bool OnActionConfirmation(RequestToken Token, const ActionResponse& Response)
+    bool close(Completion done)
     {
-        EPRI::Base()->GetDebug()->TRACE("Action Confirmation for Token %d...\n", Token);
-        if (Response.ResultValid)
+        if (!m_pAssociation->Release(done))
         {
-            EPRI::Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
-                Response.Result);
+            std::cout << "Problem submitting COSEM Release!\n";
+            return false;
         }
         return true;
     }
 
-    virtual bool OnReleaseConfirmation()
+    bool serviceConnect(bool reconnect, Completion done)
     {
-        EPRI::Base()->GetDebug()->TRACE("Release Confirmation from Server\n");
-        return true;
+        return Action(70, (reconnect ? 2 : 1), "0-0:96.3.10*255", nullptr, done);
     }
 
-    virtual bool OnReleaseConfirmation(EPRI::COSEMAddressType ServerAddress)
+    bool Action(unsigned class_id, unsigned method, std::string obis, EPRI::COSEMType MyData, Completion done)
     {
-        EPRI::Base()->GetDebug()->TRACE("Release Confirmation from Server %d\n", ServerAddress);
-        return true;
-    }
-
-    virtual bool OnAbortIndication(EPRI::COSEMAddressType ServerAddress)
-    {
-        if (EPRI::INVALID_ADDRESS == ServerAddress)
+        if (m_pAssociation->IsAssociated())
         {
-            EPRI::Base()->GetDebug()->TRACE("Abort Indication.  Not Associated.\n");
-        }
-        else
-        {
-            EPRI::Base()->GetDebug()->TRACE("Abort Indication from Server %d\n", ServerAddress);
-        }
-        return true;
-    }
-private:
-    EPRI::Transport * pXPort{nullptr};
-};
-
+            EPRI::Cosem_Method_Descriptor Descriptor;
 
-class HESsim {
-public:
-    HESsim(EPRI::LinuxBaseLibrary& bl, const std::string& meterURL, int SourceAddress = 1)
-        : bl(bl)
-        , m_pClientEngine{EPRI::COSEMClientEngine::Options(SourceAddress),
-            new EPRI::TCPWrapper((m_pSocket = EPRI::Base()->GetCore()->GetIP()->CreateSocket(EPRI::LinuxIP::Options(EPRI::LinuxIP::Options::MODE_CLIENT, EPRI::LinuxIP::Options::VERSION6))))}
-    {
-        if (EPRI::SUCCESSFUL != m_pSocket->Open(meterURL.c_str()))
-        {
-            std::cout << "Failed to initiate connect to " << meterURL << "\n";
-        }
-    }
-    ~HESsim()
-    {
-        if (m_pSocket)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds{100});
-            bl.get_io_service().poll();
-            EPRI::Base()->GetCore()->GetIP()->ReleaseSocket(m_pSocket);
-            m_pSocket = nullptr;
-            std::cout << "Socket released.\n";
-        }
-        else
-        {
-            std::cout << "TCP Not Opened!\n";
-        }
-    }
-    bool open()
-    {
-        static constexpr int max_tries{400};
-        int tries{max_tries};
-        do {
-            std::this_thread::sleep_for(std::chrono::milliseconds{100});
-            bl.get_io_service().poll();
-            if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsTransportConnected())
+            Descriptor.class_id = (EPRI::ClassIDType)class_id;
+            Descriptor.method_id = (EPRI::ObjectAttributeIdType)method;
+            if (Descriptor.instance_id.Parse(obis))
             {
-                bool Send = true;
-                int DestinationAddress = 1;
-                EPRI::COSEMSecurityOptions::SecurityLevel Security = EPRI::COSEMSecurityOptions::SECURITY_NONE;
-                EPRI::COSEMSecurityOptions SecurityOptions;
-                SecurityOptions.ApplicationContextName = SecurityOptions.ContextLNRNoCipher;
-                size_t APDUSize = 640;
-                m_pClientEngine.Open(DestinationAddress,
-                                      SecurityOptions,
-                                      EPRI::xDLMS::InitiateRequest(APDUSize));
+                if (m_pAssociation->Action(Descriptor,
+                                           EPRI::DLMSOptional<EPRI::DLMSVector>(MyData),
+                                           done))
+                {
+                    PrintLine("\tAction Request Sent\n");
+                    return true;
+                }
             }
             else
             {
-                // std::cout << "Transport Connection Not Established Yet!\n";
-                --tries;
+                PrintLine("Malformed OBIS Code!\n");
             }
-        } while (!(m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsTransportConnected()) && tries > 0);
-        return tries;
-    }
-
-    bool close()
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (!m_pClientEngine.Release(EPRI::xDLMS::InitiateRequest()))
+        }
+        else
         {
-            std::cout << "Problem submitting COSEM Release!\n";
-            return false;
+            PrintLine("Not Connected!\n");
         }
-        return true;
-    }
-
-    bool serviceConnect(bool reconnect)
-    {
-        return Action(70, (reconnect ? 2 : 1), "0-0:96.3.10*255", nullptr);
+        return false;
     }
 
-    bool Action(unsigned class_id, unsigned method, std::string obis, EPRI::COSEMType MyData)
+    bool Get(unsigned class_id, unsigned attribute, std::string obis, GetCompletion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
+        if (m_pAssociation->IsAssociated())
         {
-            EPRI::Cosem_Method_Descriptor Descriptor;
+            EPRI::Cosem_Attribute_Descriptor Descriptor;
 
             Descriptor.class_id = (EPRI::ClassIDType)class_id;
-            Descriptor.method_id = (EPRI::ObjectAttributeIdType)method;
+            Descriptor.attribute_id = (EPRI::ObjectAttributeIdType)attribute;
             if (Descriptor.instance_id.Parse(obis))
             {
-                if (m_pClientEngine.Action(Descriptor,
-                                        EPRI::DLMSOptional<EPRI::DLMSVector>(MyData),
-                                        &m_ActionToken))
+                if (m_pAssociation->Get(Descriptor, done))
                 {
-                    PrintLine(std::string("\tAction Request Sent: Token ") + std::to_string(m_ActionToken) + "\n");
+                    PrintLine("\tGet Request Sent\n");
                     return true;
                 }
             }
@@ -327,27 +208,26 @@ public:
         return false;
     }
 
-    bool Get(unsigned class_id, unsigned attribute, std::string obis)
+    bool GetList(const std::vector<Attribute>& attributes, GetListCompletion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
+        if (m_pAssociation->IsAssociated())
         {
-            EPRI::Cosem_Attribute_Descriptor Descriptor;
+            std::vector<EPRI::Cosem_Attribute_Descriptor> Descriptors(attributes.size());
 
-            Descriptor.class_id = (EPRI::ClassIDType)class_id;
-            Descriptor.attribute_id = (EPRI::ObjectAttributeIdType)attribute;
-            if (Descriptor.instance_id.Parse(obis))
+            for (std::size_t i = 0; i < attributes.size(); ++i)
             {
-                if (m_pClientEngine.Get(Descriptor, &m_GetToken))
+                Descriptors[i].class_id = (EPRI::ClassIDType)attributes[i].class_id;
+                Descriptors[i].attribute_id = (EPRI::ObjectAttributeIdType)attributes[i].attribute;
+                if (!Descriptors[i].instance_id.Parse(attributes[i].obis))
                 {
-                    PrintLine(std::string("\tGet Request Sent: Token ") + std::to_string(m_GetToken) + "\n");
-                    return true;
+                    PrintLine("Malformed OBIS Code!\n");
+                    return false;
                 }
             }
-            else
+            if (m_pAssociation->GetList(Descriptors, done))
             {
-                PrintLine("Malformed OBIS Code!\n");
+                PrintLine("\tGet List Request Sent\n");
+                return true;
             }
         }
         else
@@ -357,11 +237,9 @@ public:
         return false;
     }
 
-    bool Set(unsigned class_id, unsigned attribute, std::string obis, EPRI::COSEMType MyData)
+    bool Set(unsigned class_id, unsigned attribute, std::string obis, EPRI::COSEMType MyData, Completion done)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds{100});
-        bl.get_io_service().poll();
-        if (m_pSocket && m_pSocket->IsConnected() && m_pClientEngine.IsOpen())
+        if (m_pAssociation->IsAssociated())
         {
             EPRI::Cosem_Attribute_Descriptor Descriptor;
 
@@ -369,9 +247,9 @@ public:
             Descriptor.attribute_id = (EPRI::ObjectAttributeIdType)attribute;
             if (Descriptor.instance_id.Parse(obis))
             {
-                if (m_pClientEngine.Set(Descriptor, MyData, &m_SetToken))
+                if (m_pAssociation->Set(Descriptor, MyData, done))
                 {
-                    PrintLine(std::string("\tSet Request Sent: Token ") + std::to_string(m_SetToken) + "\n");
+                    PrintLine("\tSet Request Sent\n");
                     return true;
                 }
             }
@@ -391,112 +269,431 @@ public:
     }
 
 private:
-    EPRI::LinuxBaseLibrary& bl;
-    EPRI::ISocket* m_pSocket = nullptr;
-    LinuxClientEngine m_pClientEngine;
-    EPRI::COSEMClientEngine::RequestToken m_GetToken;
-    EPRI::COSEMClientEngine::RequestToken m_SetToken;
-    EPRI::COSEMClientEngine::RequestToken m_ActionToken;
+    std::string meterURL;
+    std::shared_ptr<EPRI::LinuxClientAssociation> m_pAssociation;
 };
 
-bool multiRead(EPRI::LinuxBaseLibrary& bl, const std::string& apaddress, const std::set<std::string>& meters, const HESConfig& cfg) { 
-    std::string payload_str{};
-    switch (cfg.get_payload_size()) {
-        case HESConfig::payload::medium:
-            payload_str = "medium";
-            break;
-        case HESConfig::payload::large:
-            payload_str = "large";
-            break;
-        default:
-            payload_str = "small";
-            break;
+/// One asynchronous step of a script: starts an operation which reports
+/// through the given completion, or returns false if it could not be started.
+using Step = std::function<bool(HESsim::Completion)>;
+
+/// runs the steps one after the other, stopping early if a step cannot be started
+void runSteps(std::shared_ptr<std::vector<Step>> steps, std::size_t index, bool result, HESsim::Completion done) {
+    if (index == steps->size()) {
+        done(result);
+        return;
     }
-    // concatenate all meter names
-    auto comma_concat = [](std::string a, std::string b) {
-        return std::move(a) + ',' + b;
+    auto next = [steps, index, result, done](bool ok) {
+        runSteps(steps, index + 1, result && ok, done);
     };
-    std::string meterset = std::accumulate(meters.begin(), meters.end(), payload_str, comma_concat);
+    if (!(*steps)[index](next)) {
+        done(false);
+    }
+}
 
-    asio::ip::tcp::socket s(bl.get_io_service());
-    asio::ip::tcp::resolver::query q(apaddress, "4059");
-    asio::ip::tcp::resolver resolver(bl.get_io_service());
-    asio::connect(s, resolver.resolve(q));
-    asio::write(s, asio::buffer(meterset.data(), meterset.size()));
-    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+/// adapts a Get to a Step
+Step getStep(HESsim hes, unsigned class_id, unsigned attribute, std::string obis) {
+    return [hes, class_id, attribute, obis](HESsim::Completion next) mutable {
+        return hes.Get(class_id, attribute, obis,
+            [next](bool ok, const EPRI::COSEMClientEngine::GetResponse&) { next(ok); });
+    };
+}
 
-    return true;
+/// adapts a GetList to a Step, reading all the attributes in one round trip
+Step getListStep(HESsim hes, std::vector<HESsim::Attribute> attributes) {
+    return [hes, attributes](HESsim::Completion next) mutable {
+        return hes.GetList(attributes,
+            [next](bool ok, const EPRI::LinuxClientAssociation::GetResponseList&) { next(ok); });
+    };
 }
 
+/// Keeps the Access Point's list of meters in step with ours.  After the
+/// first snapshot, only the meters added or removed since the last
+/// acknowledged message are sent.  If the AP rejects a delta, because it
+/// restarted or missed a message, a full snapshot follows.
+class APRegistration {
+public:
+    APRegistration(EPRI::LinuxBaseLibrary& bl, const std::string& apaddress)
+        : bl(bl)
+        , apaddress_{apaddress}
+    {}
 
-bool runScript(EPRI::LinuxBaseLibrary& bl, const std::set<std::string>& meters, const HESConfig& cfg)
-{
-    bool result{true};
-    for (const auto& metername : meters) {
-        std::cout << "Trying to connect to meter at " << metername << "\n";
-        HESsim hes(bl, metername);
-        hes.open();
-        result &= hes.serviceConnect(true);
-        result &= hes.Get(8, 2, "0-0:1.0.0*255");
-        switch (cfg.get_payload_size()) {
+    bool sync(const std::set<std::string>& meters, HESConfig::payload size) {
+        uint8_t payload{0};
+        switch (size) {
             case HESConfig::payload::medium:
-                result &= hes.Get(1, 2, "0-0:96.1.4*255");
+                payload = 1;
                 break;
             case HESConfig::payload::large:
-                result &= hes.Get(1, 2, "0-0:96.1.9*255");
+                payload = 2;
                 break;
             default:
-                result &= hes.Get(1, 2, "0-0:96.1.0*255");
                 break;
         }
+        try {
+            asio::ip::tcp::socket s(bl.get_io_service());
+            asio::ip::tcp::resolver::query q(apaddress_, "4059");
+            asio::ip::tcp::resolver resolver(bl.get_io_service());
+            asio::connect(s, resolver.resolve(q));
+
+            EPRI::RegistrationMessage delta{EPRI::RegistrationMessage::DELTA, sequence_ + 1, payload};
+            std::vector<std::string> changed;
+            std::set_difference(meters.cbegin(), meters.cend(), sent_.cbegin(), sent_.cend(),
+                std::back_inserter(changed));
+            for (auto& meter : changed) {
+                delta.m_Changes.emplace_back(EPRI::RegistrationMessage::ADD, std::move(meter));
+            }
+            changed.clear();
+            std::set_difference(sent_.cbegin(), sent_.cend(), meters.cbegin(), meters.cend(),
+                std::back_inserter(changed));
+            for (auto& meter : changed) {
+                delta.m_Changes.emplace_back(EPRI::RegistrationMessage::REMOVE, std::move(meter));
+            }
+            if (!send(s, delta)) {
+                EPRI::RegistrationMessage snapshot{EPRI::RegistrationMessage::SNAPSHOT, sequence_ + 2, payload};
+                snapshot.m_Changes.reserve(meters.size());
+                for (const auto& meter : meters) {
+                    snapshot.m_Changes.emplace_back(EPRI::RegistrationMessage::ADD, meter);
+                }
+                if (!send(s, snapshot)) {
+                    return false;
+                }
+                sequence_ = snapshot.m_Sequence;
+            } else {
+                sequence_ = delta.m_Sequence;
+            }
+            sent_ = meters;
+        } catch (std::exception& err) {
+            std::cerr << err.what() << '\n';
+            return false;
+        }
+        return true;
+    }
+
+private:
+    /// sends one message and reports whether the AP applied it
+    bool send(asio::ip::tcp::socket& s, const EPRI::RegistrationMessage& msg) {
+        std::vector<uint8_t> frame;
+        msg.Encode(&frame);
+        asio::write(s, asio::buffer(frame));
+        std::array<uint8_t, EPRI::RegistrationMessage::ACK_LENGTH> ack;
+        asio::read(s, asio::buffer(ack));
+        return EPRI::RegistrationMessage::DecodeAck(ack.data()) == msg.m_Sequence;
+    }
+
+    EPRI::LinuxBaseLibrary& bl;
+    std::string apaddress_;
+    std::set<std::string> sent_;
+    uint32_t sequence_{0};
+};
+
+
+/// Hands out the client address for each association opened to a meter,
+/// so that no two associations with the same meter at once share one.  The
+/// wrapper carries the client address as the source wPort, which is what
+/// lets the AP's relay carry them over a single connection to the meter.
+class ClientAddresses {
+public:
+    /// the lowest address not in use with this meter
+    int acquire(const std::string& meter) {
+        auto& used{in_use_[meter]};
+        int address{1};
+        while (used.count(address)) {
+            ++address;
+        }
+        used.insert(address);
+        return address;
+    }
+
+    void release(const std::string& meter, int address) {
+        auto it{in_use_.find(meter)};
+        if (it != in_use_.end()) {
+            it->second.erase(address);
+            if (it->second.empty()) {
+                in_use_.erase(it);
+            }
+        }
+    }
+
+private:
+    std::map<std::string, std::set<int>> in_use_;
+};
+
+/// reads one meter directly: connect, operate the disconnect, read the
+/// clock and the data object, release; done is called exactly once
+void readMeter(EPRI::LinuxBaseLibrary& bl, const std::string& metername, HESConfig::payload size,
+        int client_address, HESsim::Completion done)
+{
+    std::cout << "Trying to connect to meter at " << metername << "\n";
+    HESsim hes(bl, metername, client_address);
+    std::string obis;
+    switch (size) {
+        case HESConfig::payload::medium:
+            obis = "0-0:96.1.4*255";
+            break;
+        case HESConfig::payload::large:
+            obis = "0-0:96.1.9*255";
+            break;
+        default:
+            obis = "0-0:96.1.0*255";
+            break;
+    }
+    auto steps = std::make_shared<std::vector<Step>>(std::vector<Step>{
+        [hes](HESsim::Completion next) mutable { return hes.serviceConnect(true, next); },
+        getListStep(hes, {{8, 2, "0-0:1.0.0*255"}, {1, 2, obis}}),
 #if 0
-        result &= hes.Set(1, 2, "0-0:96.1.0*255", {EPRI::COSEMDataType::VISIBLE_STRING, std::string{"zzzZZZZZzzz!!"}});
-        result &= hes.Get(1, 2, "0-0:96.1.0*255");
-        result &= hes.Get(70, 2, "0-0:96.3.10*255");
-        result &= hes.Get(70, 3, "0-0:96.3.10*255");
-        result &= hes.Get(70, 4, "0-0:96.3.10*255");
-        result &= hes.serviceConnect(false);
-        result &= hes.Get(70, 2, "0-0:96.3.10*255");
-        result &= hes.Get(70, 3, "0-0:96.3.10*255");
-        result &= hes.Get(70, 4, "0-0:96.3.10*255");
+        [hes](HESsim::Completion next) mutable {
+            return hes.Set(1, 2, "0-0:96.1.0*255", {EPRI::COSEMDataType::VISIBLE_STRING, std::string{"zzzZZZZZzzz!!"}}, next);
+        },
+        getStep(hes, 1, 2, "0-0:96.1.0*255"),
+        getStep(hes, 70, 2, "0-0:96.3.10*255"),
+        getStep(hes, 70, 3, "0-0:96.3.10*255"),
+        getStep(hes, 70, 4, "0-0:96.3.10*255"),
+        [hes](HESsim::Completion next) mutable { return hes.serviceConnect(false, next); },
+        getStep(hes, 70, 2, "0-0:96.3.10*255"),
+        getStep(hes, 70, 3, "0-0:96.3.10*255"),
+        getStep(hes, 70, 4, "0-0:96.3.10*255"),
 
         // now do a firmware download
         //  1. get image block size
-        result &= hes.Get(18, 2, "0-0:44.0.0*255");
+        getStep(hes, 18, 2, "0-0:44.0.0*255"),
 #endif
-        hes.close();
+    });
+    auto opened = hes.open([hes, steps, done](bool ok) mutable {
+        if (!ok) {
+            done(false);
+            return;
+        }
+        runSteps(steps, 0, true, [hes, done](bool ok) mutable {
+            if (!hes.close([ok, done](bool released) { done(ok && released); })) {
+                done(false);
+            }
+        });
+    });
+    if (!opened) {
+        done(false);
+    }
+}
+
+/// Serializes the scheduler's live figures into one compact JSON frame and
+/// publishes it through the configuration, whose websocket server pushes
+/// it to the subscribed dashboards.  Rates and latencies cover the period
+/// since the previous frame.  While the AP reads the meters itself, the
+/// scheduler is idle and the HES cannot see the AP's figures, so the frame
+/// says so and only carries what the HES knows: how many meters it handed
+/// to the AP and whether the AP accepted them.
+class MetricsPublisher {
+public:
+    explicit MetricsPublisher(HESConfig& cfg)
+        : cfg_(cfg)
+        , published_(ReadScheduler::Clock::now())
+    {}
+
+    /// the HES reads the meters itself, through the scheduler
+    void direct() { delegated_ = false; }
+
+    /// the AP reads the meters for the HES
+    void delegated(std::size_t meters, bool synced) {
+        delegated_ = true;
+        meters_ = meters;
+        synced_ = synced;
+    }
+
+    void publish(ReadScheduler& scheduler) {
+        const auto now{ReadScheduler::Clock::now()};
+        const std::chrono::duration<double> elapsed{now - published_};
+        const auto completed{scheduler.completed()};
+        const auto latency{scheduler.take_latency()};
+        std::ostringstream frame;
+        if (delegated_) {
+            frame << "{\"mode\":\"ap_multiread\",\"meters\":" << meters_
+                << ",\"synced\":" << (synced_ ? "true" : "false") << '}';
+            cfg_.publish_metrics(frame.str());
+            completed_ = completed;
+            published_ = now;
+            return;
+        }
+        frame << "{\"mode\":\"direct\",\"reads_per_sec\":" << std::fixed << std::setprecision(1)
+            << (elapsed.count() > 0 ? (completed - completed_) / elapsed.count() : 0.0)
+            << ",\"queue\":" << scheduler.queued()
+            << ",\"in_flight\":" << scheduler.in_flight()
+            << ",\"missed\":" << scheduler.missed()
+            << ",\"aps\":{";
+        const char* sep{""};
+        for (const auto& ap : scheduler.in_flight_by_ap()) {
+            frame << sep << '"' << ap.first << "\":" << ap.second;
+            sep = ",";
+        }
+        frame << "},\"latency_us\":{\"p50\":" << latency->Percentile(50)
+            << ",\"p90\":" << latency->Percentile(90)
+            << ",\"p99\":" << latency->Percentile(99)
+            << ",\"max\":" << latency->Max() << "}}";
+        cfg_.publish_metrics(frame.str());
+        completed_ = completed;
+        published_ = now;
+    }
+
+private:
+    HESConfig& cfg_;
+    uint64_t completed_{0};
+    ReadScheduler::Clock::time_point published_;
+    bool delegated_{false};
+    std::size_t meters_{0};
+    bool synced_{false};
+};
+
+/// rough number of bytes moved by one direct read of the given payload
+std::size_t readBytes(HESConfig::payload size) {
+    // the association, disconnect and release add up to about 500 bytes
+    switch (size) {
+        case HESConfig::payload::medium:
+            return 500 + 600;
+        case HESConfig::payload::large:
+            return 500 + 20 * 1024;
+        default:
+            return 500 + 40;
     }
-    return result;
 }
 
-std::set<std::string> meters{};
+
+/// what the HES knows about one registered meter
+struct MeterInfo {
+    std::chrono::system_clock::time_point first_seen;
+    std::chrono::system_clock::time_point last_seen;
+    /// the Access Point through which the meter is read
+    std::string ap;
+    unsigned registrations{0};
+};
+
+/// Thread-safe registry of the meters which have registered with the HES.
+/// Meters are spread over a fixed number of shards by address hash, each
+/// with its own lock, so concurrent registrations rarely contend with one
+/// another or with readers taking a snapshot.
+class MeterRegistry {
+public:
+    explicit MeterRegistry(std::string ap)
+        : ap_{std::move(ap)}
+    {}
+
+    /// records a registration; returns true if the meter is new
+    bool add(const std::string& meter) {
+        const auto now{std::chrono::system_clock::now()};
+        auto& shard{shard_for(meter)};
+        const std::lock_guard<std::mutex> lock(shard.mtx);
+        auto result{shard.meters.emplace(meter, MeterInfo{})};
+        auto& info{result.first->second};
+        if (result.second) {
+            info.first_seen = now;
+            info.ap = ap_;
+        }
+        info.last_seen = now;
+        ++info.registrations;
+        return result.second;
+    }
+
+    /// looks up one meter; returns false if it has not registered
+    bool find(const std::string& meter, MeterInfo& info) const {
+        auto& shard{shard_for(meter)};
+        const std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it{shard.meters.find(meter)};
+        if (it == shard.meters.end()) {
+            return false;
+        }
+        info = it->second;
+        return true;
+    }
+
+    /// the addresses of all registered meters, sorted
+    std::set<std::string> meters() const {
+        std::set<std::string> result;
+        for (const auto& shard : shards_) {
+            const std::lock_guard<std::mutex> lock(shard.mtx);
+            for (const auto& item : shard.meters) {
+                result.insert(result.end(), item.first);
+            }
+        }
+        return result;
+    }
+
+    std::size_t size() const {
+        std::size_t count{0};
+        for (const auto& shard : shards_) {
+            const std::lock_guard<std::mutex> lock(shard.mtx);
+            count += shard.meters.size();
+        }
+        return count;
+    }
+
+private:
+    static constexpr std::size_t shard_count{16};
+    struct Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, MeterInfo> meters;
+    };
+
+    Shard& shard_for(const std::string& meter) {
+        return shards_[std::hash<std::string>{}(meter) % shard_count];
+    }
+    const Shard& shard_for(const std::string& meter) const {
+        return shards_[std::hash<std::string>{}(meter) % shard_count];
+    }
+
+    std::string ap_;
+    std::array<Shard, shard_count> shards_;
+};
 
 using asio::ip::tcp;
 
+/// One registration: the meter sends "R" if it listens on the standard
+/// port, or "R<port>" if not, and then closes the connection.
 class tcp_connection : public std::enable_shared_from_this<tcp_connection>
 {
 public:
-    tcp_connection(tcp::socket socket) 
+    tcp_connection(tcp::socket socket, MeterRegistry& registry) 
         : socket_(std::move(socket))
+        , registry_(registry)
     {}
 
     void start() {
-        std::array<uint8_t, 1024> buffer;
-        std::string remote{socket_.remote_endpoint().address().to_string()};
-        std::cout << "Registered " << remote << '\n';
-        meters.insert(remote);
-        socket_.receive(asio::buffer(buffer, buffer.size()));
+        std::error_code ec;
+        const auto endpoint{socket_.remote_endpoint(ec)};
+        if (ec) {
+            return;
+        }
+        remote_ = endpoint.address().to_string();
+        auto self{shared_from_this()};
+        // read until the meter closes, however the request was split up
+        asio::async_read(socket_, asio::buffer(data_, max_length),
+            [this, self](const std::error_code& error, std::size_t len) {
+                if (error && error != asio::error::eof) {
+                    std::cout << "Registration from " << remote_ << " failed: " << error.message() << '\n';
+                    return;
+                }
+                const std::string request{data_, len};
+                if (request.size() > 1 && request[0] == 'R'
+                        && std::all_of(request.cbegin() + 1, request.cend(), isdigit)) {
+                    remote_ = "[" + remote_ + "]:" + request.substr(1);
+                }
+                if (registry_.add(remote_)) {
+                    std::cout << "Registered " << remote_ << '\n';
+                }
+            });
     }
 
 private:
     tcp::socket socket_;
+    MeterRegistry& registry_;
+    std::string remote_;
+    static constexpr unsigned max_length{16};
+    char data_[max_length];
 };
 
 class RegistrationServer {
 public:
-    RegistrationServer(asio::io_service& io_service)
+    RegistrationServer(asio::io_service& io_service, MeterRegistry& registry)
         : socket_(io_service)
         , acceptor_(io_service, tcp::endpoint(tcp::v6(), 4059))
+        , registry_(registry)
     {
         std::cout << "Listening on port 4059\n";
         do_accept();
@@ -506,7 +703,7 @@ private:
         acceptor_.async_accept(socket_,
             [this](std::error_code ec) {
                 if (!ec) {
-                    std::make_shared<tcp_connection>(std::move(socket_))->start();
+                    std::make_shared<tcp_connection>(std::move(socket_), registry_)->start();
                 }
                 do_accept();
             });
@@ -514,13 +711,22 @@ private:
 
     tcp::socket socket_;
     tcp::acceptor acceptor_;
+    MeterRegistry& registry_;
 };
 
-void regs() {
+/// runs the registration server on one thread per core
+void regs(MeterRegistry& registry) {
     try {
         asio::io_service io_service;
-        RegistrationServer regServer(io_service);
+        RegistrationServer regServer(io_service, registry);
+        std::vector<std::thread> workers;
+        for (auto n{std::max(std::thread::hardware_concurrency(), 1u)}; n > 1; --n) {
+            workers.emplace_back([&io_service]() { io_service.run(); });
+        }
         io_service.run();
+        for (auto& worker : workers) {
+            worker.join();
+        }
     } catch (std::exception& err) {
         std::cerr << err.what() << '\n';
     }
@@ -534,16 +740,82 @@ int main(int argc, char *argv[]) {
     std::string APaddress{argv[1]};
     HESConfig cfg;
     EPRI::LinuxBaseLibrary bl;
-    std::thread thr{regs};
+    APRegistration registration(bl, APaddress);
+    MeterRegistry registry(APaddress);
+    std::thread thr{regs, std::ref(registry)};
+    ReadScheduler scheduler(ReadScheduler::Budget{16, 256 * 1024});
+    MetricsPublisher metrics(cfg);
+    ClientAddresses addresses;
+    const auto read_interval{std::chrono::milliseconds{1500}};
+    const auto publish_interval{std::chrono::seconds{1}};
+    const auto tick{std::chrono::milliseconds{50}};
+    auto& io = bl.get_io_service();
+    asio::steady_timer timer(io);
+    auto next_sync{ReadScheduler::Clock::now()};
+    auto next_publish{next_sync + publish_interval};
+    // whether the AP has dropped its meter list since we went route-only
+    bool ap_released{false};
     while (1) {
-        std::cout << "There are " << meters.size() << " registered meters\n";
-        if (1) { //(meters.size()) {
-            if (cfg.get_route_only()) {
-                std::cout << "Processing\n" << ( runScript(bl, meters, cfg) ? "sucess!\n" : "Failed!\n");
+        if (ReadScheduler::Clock::now() >= next_sync) {
+            next_sync += read_interval;
+            const auto meters{registry.meters()};
+            std::cout << "There are " << meters.size() << " registered meters; "
+                << scheduler.completed() << " reads completed, " << scheduler.missed() << " missed\n";
+            // one snapshot for the whole cycle, so a reload never
+            // applies to only part of it
+            const auto config{cfg.get()};
+            const auto& ap_settings{config->for_ap(APaddress)};
+            if (ap_settings.route_only) {
+                // the AP keeps its meter list between cycles, so on entering
+                // this mode make sure it is not still reading meters on our
+                // behalf; the sync blocks, so it is only retried if it failed
+                if (!ap_released) {
+                    ap_released = registration.sync({}, ap_settings.payload_size);
+                }
+                for (const auto& meter : meters) {
+                    MeterInfo info;
+                    registry.find(meter, info);
+                    const auto size{config->for_meter(meter, info.ap).payload_size};
+                    const ReadScheduler::Work work{[&bl, &addresses, size](const std::string& meter,
+                            ReadScheduler::Done done) {
+                        const auto address{addresses.acquire(meter)};
+                        readMeter(bl, meter, size, address, [&addresses, meter, address, done](bool ok) {
+                            addresses.release(meter, address);
+                            done(ok);
+                        });
+                    }};
+                    // a meter we have just taken on is read straight away,
+                    // ahead of the interval reads, rather than at its slot
+                    if (scheduler.schedule(meter, info.ap, ReadScheduler::Priority::interval, read_interval,
+                            readBytes(size), work)) {
+                        scheduler.submit(meter, info.ap, ReadScheduler::Priority::on_demand,
+                            ReadScheduler::Clock::now() + read_interval, readBytes(size), work);
+                    }
+                }
+                scheduler.retain(meters);
+                metrics.direct();
             } else {
-                std::cout << "Multiread\n" << ( multiRead(bl, APaddress, meters, cfg) ? "sucess!\n" : "Failed!\n");
+                scheduler.retain({});
+                ap_released = false;
+                const bool synced{registration.sync(meters, ap_settings.payload_size)};
+                std::cout << "Multiread\n" << (synced ? "sucess!\n" : "Failed!\n");
+                metrics.delegated(meters.size(), synced);
+            }
+        }
+        scheduler.dispatch();
+        if (ReadScheduler::Clock::now() >= next_publish) {
+            next_publish += publish_interval;
+            metrics.publish(scheduler);
+        }
+        // serve the reads in flight until the next tick
+        bool expired{false};
+        timer.expires_from_now(tick);
+        timer.async_wait([&expired](const asio::error_code&) { expired = true; });
+        while (!expired) {
+            io.run_one();
+            if (io.stopped()) {
+                io.reset();
             }
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds{1500});
     }
-} 
+}
@@ -72,6 +72,7 @@
 
 #include "LinuxBaseLibrary.h"
 #include "LinuxCOSEMServer.h"
+#include "LinuxWrapperSocket.h"
 
 #include "HDLCLLC.h"
 #include "COSEM.h"
@@ -86,13 +87,18 @@
 #include <algorithm>
 #include <string>
 #include <chrono>
+#include <memory>
 #include <thread>
+#include <vector>
 
+/// Hosts one or more virtual meters.  Each meter has its own server engine,
+/// and therefore its own COSEM device state, and listens on its own port
+/// starting at FirstPort.
 class ServerApp
 {
 public:
-    ServerApp(EPRI::LinuxBaseLibrary& BL) :
-        m_Base(BL)
+    ServerApp(EPRI::LinuxBaseLibrary& BL, unsigned Meters = 1, int FirstPort = EPRI::DEFAULT_DLMS_PORT) :
+        m_Base(BL), m_Meters(Meters), m_FirstPort(FirstPort)
     {
         m_Base.get_io_service().post(std::bind(&ServerApp::Server_Handler, this));
     }
@@ -102,15 +108,20 @@ public:
         m_Base.Process();
     }
 
+    /// registers every meter; a meter not on the standard port appends its port to the "R"
     virtual bool Register(const char *HESaddress) {
         bool result{false};
         try {
-            static const std::string RegRequest{"R"};
-            asio::ip::tcp::socket s(m_Base.get_io_service());
             asio::ip::tcp::resolver::query q(HESaddress, "4059");
             asio::ip::tcp::resolver resolver(m_Base.get_io_service());
-            asio::connect(s, resolver.resolve(q));
-            asio::write(s, asio::buffer(RegRequest.data(), RegRequest.size()));
+            const auto endpoints{resolver.resolve(q)};
+            for (unsigned meter = 0; meter < m_Meters; ++meter) {
+                const int port{m_FirstPort + int(meter)};
+                const std::string RegRequest{EPRI::DEFAULT_DLMS_PORT == port ? "R" : "R" + std::to_string(port)};
+                asio::ip::tcp::socket s(m_Base.get_io_service());
+                asio::connect(s, endpoints);
+                asio::write(s, asio::buffer(RegRequest.data(), RegRequest.size()));
+            }
             result = true;
         } catch (std::exception& err)
         {
@@ -123,35 +134,63 @@ public:
 protected:
     void Server_Handler()
     {
-        EPRI::ISocket* pSocket{EPRI::Base()->GetCore()->GetIP()->CreateSocket(
-            EPRI::LinuxIP::Options(EPRI::LinuxIP::Options::MODE_SERVER, EPRI::LinuxIP::Options::VERSION6)
-        )};
-
-        std::cout << "Meter Listening on Port 4059\n";
-        m_pServerEngine = new EPRI::LinuxCOSEMServerEngine(EPRI::COSEMServerEngine::Options(),
-            new EPRI::TCPWrapper(pSocket));
-        if (EPRI::SUCCESSFUL != pSocket->Open())
+        for (unsigned meter = 0; meter < m_Meters; ++meter)
         {
-            std::cout << "Failed to initiate listen\n";
-            exit(0);
+            const int port{m_FirstPort + int(meter)};
+            EPRI::ISocket* pSocket{EPRI::Base()->GetCore()->GetIP()->CreateSocket(
+                EPRI::LinuxIP::Options(EPRI::LinuxIP::Options::MODE_SERVER, EPRI::LinuxIP::Options::VERSION6)
+            )};
+
+            std::cout << "Meter Listening on Port " << port << "\n";
+            // the wrapper socket answers GET-Request-With-List for the engine
+            m_Sockets.emplace_back(new EPRI::LinuxWrapperSocket(pSocket));
+            m_ServerEngines.push_back(new EPRI::LinuxCOSEMServerEngine(EPRI::COSEMServerEngine::Options(),
+                new EPRI::TCPWrapper(m_Sockets.back().get())));
+            if (EPRI::SUCCESSFUL != pSocket->Open(nullptr, port))
+            {
+                std::cout << "Failed to initiate listen\n";
+                exit(0);
+            }
         }
     }
 
-    EPRI::LinuxCOSEMServerEngine * m_pServerEngine = nullptr;
+    std::vector<std::unique_ptr<EPRI::LinuxWrapperSocket>> m_Sockets;
+    std::vector<EPRI::LinuxCOSEMServerEngine *> m_ServerEngines;
     EPRI::LinuxBaseLibrary&           m_Base;
+    unsigned                          m_Meters;
+    int                               m_FirstPort;
 };
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2) {
-        std::cerr << "Usage: Metersim HESaddress\n";
+    if (argc < 2 || argc > 4) {
+        std::cerr << "Usage: Metersim HESaddress [meters [firstport]]\n";
+        return 1;
+    }
+    unsigned meters{1};
+    int firstport{EPRI::DEFAULT_DLMS_PORT};
+    try {
+        if (argc > 2) {
+            meters = std::stoul(argv[2]);
+        }
+        if (argc > 3) {
+            firstport = std::stoi(argv[3]);
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid meter count or port\n";
+        return 1;
+    }
+    if (meters < 1 || firstport < 1 || firstport + int(meters) > 65536) {
+        std::cerr << "Meter ports must lie between 1 and 65535\n";
         return 1;
     }
     std::cout << "EPRI DLMS/COSEM meter simulator\n";
     bool reg = false;
     while (1) {
-        EPRI::LinuxBaseLibrary     bl;
-        ServerApp App(bl);
+        // a fleet of meters is spread across all cores
+        EPRI::LinuxBaseLibrary     bl(meters > 1 ? EPRI::LinuxBaseLibrary::HARDWARE_THREADS
+                                                 : EPRI::LinuxBaseLibrary::SINGLE_THREAD);
+        ServerApp App(bl, meters, firstport);
         // register with head end system
         if (reg) {
             App.Run();
@@ -0,0 +1,321 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include "LinuxMetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+/// Decides when each meter is read.  Every meter has a recurring read with
+/// its own interval, and further one-off jobs may be submitted.  A job is
+/// eligible once it is due.  Eligible jobs start in priority order
+/// (on-demand, then interval), then by earliest deadline.
+/// Each access point has a budget of concurrent jobs and of bytes per
+/// second, so reads are spread over time instead of arriving as a burst
+/// which saturates the backhaul.  A job which could not be started before
+/// its deadline is counted as missed; a recurring one moves on to its next
+/// slot.
+class ReadScheduler {
+public:
+    enum class Priority { on_demand, interval };
+    using Clock = std::chrono::steady_clock;
+    using Done = std::function<void(bool)>;
+    /// starts the work for one meter; must call its Done exactly once
+    using Work = std::function<void(const std::string&, Done)>;
+
+    struct Budget {
+        unsigned concurrency;
+        std::size_t bytes_per_second;
+    };
+
+    explicit ReadScheduler(const Budget& budget)
+        : budget_(budget)
+    {}
+
+    /// sets up (or updates) the recurring job for a meter; a new meter's
+    /// first slot is spread over the interval by a hash of its address.
+    /// Returns true if the meter is new.
+    bool schedule(const std::string& meter, const std::string& ap, Priority priority,
+            Clock::duration interval, std::size_t bytes, Work work) {
+        auto it{recurring_.find(meter)};
+        if (it != recurring_.end()) {
+            Job& job{jobs_.at(it->second)};
+            job.ap = ap;
+            job.priority = priority;
+            job.interval = interval;
+            job.bytes = bytes;
+            job.work = work;
+            return false;
+        }
+        const auto offset{interval * (std::hash<std::string>{}(meter) % 1000) / 1000};
+        const auto due{Clock::now() + offset};
+        recurring_[meter] = add(Job{meter, ap, priority, due, due + interval, interval, bytes, work});
+        return true;
+    }
+
+    /// drops the recurring job for every meter not in meters
+    void retain(const std::set<std::string>& meters) {
+        for (auto it{recurring_.begin()}; it != recurring_.end(); ) {
+            if (meters.count(it->first)) {
+                ++it;
+            } else {
+                remove(it->second);
+                it = recurring_.erase(it);
+            }
+        }
+    }
+
+    /// queues a one-off job which should start before deadline
+    void submit(const std::string& meter, const std::string& ap, Priority priority,
+            Clock::time_point deadline, std::size_t bytes, Work work) {
+        add(Job{meter, ap, priority, Clock::now(), deadline, Clock::duration::zero(), bytes, work});
+    }
+
+    /// starts every eligible job which fits within its access point's budget
+    void dispatch(Clock::time_point now = Clock::now()) {
+        while (!timeline_.empty() && timeline_.begin()->first <= now) {
+            const Job& job{jobs_.at(timeline_.begin()->second)};
+            ready_.insert(Ready{job.priority, job.deadline, timeline_.begin()->second});
+            timeline_.erase(timeline_.begin());
+        }
+        // once a job is held back, nothing of lower rank may overtake it
+        // on the same access point
+        std::set<std::string> blocked;
+        for (auto it{ready_.begin()}; it != ready_.end(); ) {
+            const uint64_t id{it->id};
+            Job& job{jobs_.at(id)};
+            if (job.deadline < now) {
+                ++missed_;
+                it = ready_.erase(it);
+                reschedule(id, now);
+                continue;
+            }
+            if (blocked.count(job.ap) || !admit(job, now)) {
+                blocked.insert(job.ap);
+                ++it;
+                continue;
+            }
+            it = ready_.erase(it);
+            start(id);
+        }
+    }
+
+    std::size_t in_flight() const { return in_flight_; }
+    uint64_t completed() const { return completed_; }
+    uint64_t missed() const { return missed_; }
+    /// jobs which are due but waiting for their access point's budget
+    std::size_t queued() const { return ready_.size(); }
+
+    /// jobs in flight through each access point which has any
+    std::map<std::string, unsigned> in_flight_by_ap() const {
+        std::map<std::string, unsigned> result;
+        for (const auto& ap : aps_) {
+            if (ap.second.in_flight) {
+                result.emplace(ap.first, ap.second.in_flight);
+            }
+        }
+        return result;
+    }
+
+    /// hands over the latencies of the reads completed since the last call
+    std::unique_ptr<EPRI::LinuxHistogram> take_latency() {
+        std::unique_ptr<EPRI::LinuxHistogram> taken{new EPRI::LinuxHistogram};
+        latency_.swap(taken);
+        return taken;
+    }
+
+private:
+    struct Job {
+        std::string meter;
+        std::string ap;
+        Priority priority;
+        Clock::time_point due;
+        Clock::time_point deadline;
+        /// zero for a one-off job
+        Clock::duration interval;
+        std::size_t bytes;
+        Work work;
+    };
+    struct Ready {
+        Priority priority;
+        Clock::time_point deadline;
+        uint64_t id;
+        bool operator<(const Ready& other) const {
+            return std::tie(priority, deadline, id) < std::tie(other.priority, other.deadline, other.id);
+        }
+    };
+    struct APState {
+        unsigned in_flight{0};
+        double tokens{0};
+        Clock::time_point refilled{};
+    };
+
+    uint64_t add(Job job) {
+        const uint64_t id{next_id_++};
+        timeline_.emplace(job.due, id);
+        jobs_.emplace(id, std::move(job));
+        return id;
+    }
+
+    void remove(uint64_t id) {
+        auto it{jobs_.find(id)};
+        if (it == jobs_.end()) {
+            return;
+        }
+        auto range{timeline_.equal_range(it->second.due)};
+        for (auto t{range.first}; t != range.second; ++t) {
+            if (t->second == id) {
+                timeline_.erase(t);
+                break;
+            }
+        }
+        ready_.erase(Ready{it->second.priority, it->second.deadline, id});
+        jobs_.erase(it);
+    }
+
+    /// checks the job against its access point's budgets and, if it fits,
+    /// charges it to them
+    bool admit(const Job& job, Clock::time_point now) {
+        APState& ap{aps_[job.ap]};
+        const double capacity{static_cast<double>(budget_.bytes_per_second)};
+        if (ap.refilled == Clock::time_point{}) {
+            ap.tokens = capacity;
+        } else {
+            const std::chrono::duration<double> elapsed{now - ap.refilled};
+            ap.tokens = std::min(capacity, ap.tokens + elapsed.count() * capacity);
+        }
+        ap.refilled = now;
+        // a job larger than the whole bucket goes once the bucket is full
+        const double cost{std::min(static_cast<double>(job.bytes), capacity)};
+        if (ap.in_flight >= budget_.concurrency || ap.tokens < cost) {
+            return false;
+        }
+        ++ap.in_flight;
+        ap.tokens -= cost;
+        return true;
+    }
+
+    void start(uint64_t id) {
+        Job& job{jobs_.at(id)};
+        ++in_flight_;
+        const std::string ap{job.ap};
+        const auto started{Clock::now()};
+        job.work(job.meter, [this, id, ap, started](bool) {
+            latency_->Record(Clock::now() - started);
+            --in_flight_;
+            --aps_[ap].in_flight;
+            ++completed_;
+            reschedule(id, Clock::now());
+        });
+    }
+
+    /// moves a recurring job on to its next slot, or forgets a one-off job
+    void reschedule(uint64_t id, Clock::time_point now) {
+        auto it{jobs_.find(id)};
+        if (it == jobs_.end()) {
+            return;
+        }
+        Job& job{it->second};
+        if (job.interval == Clock::duration::zero()) {
+            jobs_.erase(it);
+            return;
+        }
+        // keep the meter's phase, skipping any slots which have passed
+        do {
+            job.due += job.interval;
+        } while (job.due + job.interval <= now);
+        job.deadline = job.due + job.interval;
+        timeline_.emplace(job.due, id);
+    }
+
+    Budget budget_;
+    uint64_t next_id_{0};
+    std::unordered_map<uint64_t, Job> jobs_;
+    std::multimap<Clock::time_point, uint64_t> timeline_;
+    std::set<Ready> ready_;
+    std::map<std::string, uint64_t> recurring_;
+    std::unordered_map<std::string, APState> aps_;
+    std::size_t in_flight_{0};
+    uint64_t completed_{0};
+    uint64_t missed_{0};
+    std::unique_ptr<EPRI::LinuxHistogram> latency_{new EPRI::LinuxHistogram};
+};
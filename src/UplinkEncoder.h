@@ -0,0 +1,179 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/// very simple class representing a meter reading
+struct MeterReading {
+    std::string meterAddr;
+    std::string meterData;
+};
+
+/// Streams meter readings to the HES as each one completes rather than
+/// after the whole cycle.  Each reading is encoded into a reused, pre-reserved
+/// buffer and written straight out, so memory use does not grow with the
+/// number of meters.  A blocking write on the output is the backpressure.
+///
+/// In JSON framing a cycle is one document, {"meterdata":[...]}, with every
+/// string properly escaped.  In binary framing each reading is a record of
+/// a 16-bit meter length, a 32-bit data length (both big-endian) and the
+/// two strings; a record with a zero meter length ends the cycle.
+class UplinkEncoder {
+public:
+    enum class Framing { json, binary };
+
+    UplinkEncoder(std::ostream& out, Framing framing = Framing::json, std::size_t capacity = 64 * 1024)
+        : out_{out}
+        , framing_{framing}
+    {
+        buffer_.reserve(capacity);
+    }
+
+    void begin() {
+        count_ = 0;
+        if (framing_ == Framing::json) {
+            buffer_.append("{\"meterdata\":[");
+        }
+    }
+
+    void add(const MeterReading& reading) {
+        if (framing_ == Framing::json) {
+            buffer_.append(count_ ? ",\n{\"meter\":" : "\n{\"meter\":");
+            quote(reading.meterAddr);
+            buffer_.append(",\"data\":");
+            quote(reading.meterData);
+            buffer_.push_back('}');
+        } else {
+            put(reading.meterAddr.size(), 2);
+            put(reading.meterData.size(), 4);
+            buffer_.append(reading.meterAddr);
+            buffer_.append(reading.meterData);
+        }
+        ++count_;
+        flush();
+    }
+
+    void end() {
+        if (framing_ == Framing::json) {
+            buffer_.append("\n]}\n");
+        } else {
+            put(0, 2);
+        }
+        flush();
+    }
+
+private:
+    void flush() {
+        out_.write(buffer_.data(), buffer_.size());
+        out_.flush();
+        buffer_.clear();
+    }
+
+    void put(std::size_t value, unsigned bytes) {
+        while (bytes--) {
+            buffer_.push_back(static_cast<char>((value >> (8 * bytes)) & 0xff));
+        }
+    }
+
+    void quote(const std::string& str) {
+        static const char hex[]{"0123456789abcdef"};
+        buffer_.push_back('"');
+        for (const char ch : str) {
+            switch (ch) {
+                case '"':  buffer_.append("\\\""); break;
+                case '\\': buffer_.append("\\\\"); break;
+                case '\n': buffer_.append("\\n"); break;
+                case '\r': buffer_.append("\\r"); break;
+                case '\t': buffer_.append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20) {
+                        buffer_.append("\\u00");
+                        buffer_.push_back(hex[(ch >> 4) & 0xf]);
+                        buffer_.push_back(hex[ch & 0xf]);
+                    } else {
+                        buffer_.push_back(ch);
+                    }
+                    break;
+            }
+        }
+        buffer_.push_back('"');
+    }
+
+    std::ostream& out_;
+    Framing framing_;
+    std::string buffer_;
+    std::size_t count_{0};
+};
@@ -0,0 +1,236 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include "LinuxAssociationPool.h"
+#include "IBaseLibrary.h"
+
+namespace EPRI
+{
+    LinuxAssociationPool::LinuxAssociationPool(asio::io_service& IO,
+        const LinuxClientAssociation::Options& Opt /*= LinuxClientAssociation::Options()*/,
+        uint32_t IdleTimeOutInMS /*= 60000*/) :
+        m_IO(IO), m_Options(Opt), m_IdleTimeOut(IdleTimeOutInMS), m_SweepTimer(IO)
+    {
+    }
+
+    LinuxAssociationPool::~LinuxAssociationPool()
+    {
+        m_SweepTimer.cancel();
+    }
+
+    void LinuxAssociationPool::Acquire(const std::string& MeterURL, AcquireCallbackFunction Callback)
+    {
+        EntryMap::iterator it = m_Entries.find(MeterURL);
+        if (it != m_Entries.end())
+        {
+            Entry& Current = it->second;
+            if (!Current.m_InUse && Current.m_pAssociation->IsAssociated())
+            {
+                Current.m_InUse = true;
+                m_IO.post(std::bind(Callback, Current.m_pAssociation));
+                return;
+            }
+            if (!Current.m_InUse)
+            {
+                //
+                // Aborted or timed out since it was last used.
+                //
+                m_Entries.erase(it);
+            }
+        }
+
+        AssociationPtr pAssociation = std::make_shared<LinuxClientAssociation>(m_IO, m_Options);
+        pAssociation->Open(MeterURL,
+            [this, MeterURL, pAssociation, Callback](bool Success)
+            {
+                if (!Success)
+                {
+                    Callback(nullptr);
+                    return;
+                }
+                //
+                // A concurrent caller may have pooled its own association
+                // meanwhile; keep that one and let this one go unpooled.
+                //
+                if (m_Entries.find(MeterURL) == m_Entries.end())
+                {
+                    m_Entries[MeterURL] = Entry{ pAssociation, true, std::chrono::steady_clock::now() };
+                    StartSweep();
+                }
+                Callback(pAssociation);
+            });
+    }
+
+    void LinuxAssociationPool::Restore(const std::string& MeterURL, AssociationPtr pAssociation)
+    {
+        if (!pAssociation)
+        {
+            return;
+        }
+        EntryMap::iterator it = m_Entries.find(MeterURL);
+        if (it == m_Entries.end() || it->second.m_pAssociation != pAssociation)
+        {
+            Close(pAssociation);
+            return;
+        }
+        if (!pAssociation->IsAssociated())
+        {
+            m_Entries.erase(it);
+            return;
+        }
+        it->second.m_InUse = false;
+        it->second.m_LastUsed = std::chrono::steady_clock::now();
+    }
+
+    void LinuxAssociationPool::Evict(const std::string& MeterURL)
+    {
+        EntryMap::iterator it = m_Entries.find(MeterURL);
+        if (it != m_Entries.end())
+        {
+            if (!it->second.m_InUse)
+            {
+                Close(it->second.m_pAssociation);
+            }
+            m_Entries.erase(it);
+        }
+    }
+
+    void LinuxAssociationPool::Clear()
+    {
+        for (EntryMap::value_type& Current : m_Entries)
+        {
+            if (!Current.second.m_InUse)
+            {
+                Close(Current.second.m_pAssociation);
+            }
+        }
+        m_Entries.clear();
+    }
+
+    size_t LinuxAssociationPool::Size() const
+    {
+        return m_Entries.size();
+    }
+
+    void LinuxAssociationPool::Close(AssociationPtr pAssociation)
+    {
+        //
+        // Release politely if we still can; the callback keeps the association
+        // alive until the RLRE (or a timeout) arrives.
+        //
+        if (pAssociation->IsAssociated())
+        {
+            pAssociation->Release([pAssociation](bool) {});
+        }
+    }
+
+    void LinuxAssociationPool::StartSweep()
+    {
+        if (m_Sweeping)
+        {
+            return;
+        }
+        m_Sweeping = true;
+        m_SweepTimer.expires_from_now(m_IdleTimeOut / 2);
+        m_SweepTimer.async_wait(std::bind(&LinuxAssociationPool::ASIO_Sweep_Handler, this, std::placeholders::_1));
+    }
+
+    void LinuxAssociationPool::ASIO_Sweep_Handler(const asio::error_code& Error)
+    {
+        m_Sweeping = false;
+        if (asio::error::operation_aborted == Error)
+        {
+            return;
+        }
+        const std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+        for (EntryMap::iterator it = m_Entries.begin(); it != m_Entries.end(); )
+        {
+            Entry& Current = it->second;
+            if (!Current.m_InUse &&
+                (!Current.m_pAssociation->IsAssociated() || Now - Current.m_LastUsed >= m_IdleTimeOut))
+            {
+                Base()->GetDebug()->TRACE("Evicting idle association with %s\n", it->first.c_str());
+                Close(Current.m_pAssociation);
+                it = m_Entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if (!m_Entries.empty())
+        {
+            StartSweep();
+        }
+    }
+
+}
@@ -0,0 +1,185 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include "LinuxAttributeCache.h"
+
+#include <iterator>
+
+namespace EPRI
+{
+    LinuxAttributeCache::LinuxAttributeCache(size_t MaxEntries /*= 100000*/) :
+        m_MaxEntries(MaxEntries)
+    {
+    }
+
+    LinuxAttributeCache::~LinuxAttributeCache()
+    {
+    }
+
+    void LinuxAttributeCache::SetTTL(uint16_t ClassID, Clock::duration TTL)
+    {
+        m_TTLs[ClassID] = TTL;
+    }
+
+    bool LinuxAttributeCache::Find(const std::string& MeterURL, uint16_t ClientSAP, uint16_t ClassID,
+        const std::string& OBIS, uint8_t Attribute, std::string * pValue)
+    {
+        EntryMap::iterator It = m_Entries.find(Key(MeterURL, ClassID, OBIS, ClientSAP, Attribute));
+        if (It == m_Entries.end())
+        {
+            ++m_Misses;
+            return false;
+        }
+        if (It->second.m_Expires <= Clock::now())
+        {
+            Erase(It);
+            ++m_Misses;
+            return false;
+        }
+        m_LRU.splice(m_LRU.begin(), m_LRU, It->second.m_LRU);
+        *pValue = It->second.m_Value;
+        ++m_Hits;
+        return true;
+    }
+
+    void LinuxAttributeCache::Store(const std::string& MeterURL, uint16_t ClientSAP, uint16_t ClassID,
+        const std::string& OBIS, uint8_t Attribute, const std::string& Value)
+    {
+        std::map<uint16_t, Clock::duration>::const_iterator TTL = m_TTLs.find(ClassID);
+        if (TTL == m_TTLs.end() || m_MaxEntries == 0)
+        {
+            return;
+        }
+        Key K(MeterURL, ClassID, OBIS, ClientSAP, Attribute);
+        EntryMap::iterator It = m_Entries.find(K);
+        if (It == m_Entries.end())
+        {
+            if (m_Entries.size() >= m_MaxEntries)
+            {
+                Erase(m_Entries.find(m_LRU.back()));
+            }
+            m_LRU.push_front(K);
+            It = m_Entries.insert(std::make_pair(K, Entry())).first;
+            It->second.m_LRU = m_LRU.begin();
+        }
+        else
+        {
+            m_LRU.splice(m_LRU.begin(), m_LRU, It->second.m_LRU);
+        }
+        It->second.m_Value = Value;
+        It->second.m_Expires = Clock::now() + TTL->second;
+    }
+
+    void LinuxAttributeCache::Invalidate(const std::string& MeterURL, uint16_t ClassID, const std::string& OBIS)
+    {
+        //
+        // The attributes of one object, as read by every client, are
+        // adjacent in key order.
+        //
+        EntryMap::iterator It = m_Entries.lower_bound(Key(MeterURL, ClassID, OBIS, 0, 0));
+        while (It != m_Entries.end() && std::get<0>(It->first) == MeterURL &&
+            std::get<1>(It->first) == ClassID && std::get<2>(It->first) == OBIS)
+        {
+            EntryMap::iterator Next = std::next(It);
+            Erase(It);
+            It = Next;
+        }
+    }
+
+    void LinuxAttributeCache::Clear()
+    {
+        m_Entries.clear();
+        m_LRU.clear();
+    }
+
+    size_t LinuxAttributeCache::Size() const
+    {
+        return m_Entries.size();
+    }
+
+    uint64_t LinuxAttributeCache::GetHits() const
+    {
+        return m_Hits;
+    }
+
+    uint64_t LinuxAttributeCache::GetMisses() const
+    {
+        return m_Misses;
+    }
+
+    void LinuxAttributeCache::Erase(EntryMap::iterator It)
+    {
+        m_LRU.erase(It->second.m_LRU);
+        m_Entries.erase(It);
+    }
+
+}
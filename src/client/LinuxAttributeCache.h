@@ -0,0 +1,144 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace EPRI
+{
+    //
+    // Remembers attribute values read from meters, keyed by meter address,
+    // class, OBIS code, client SAP and attribute, so that a value which
+    // rarely changes can be answered without a round trip over the FAN.
+    // A value is only given back to the client SAP which read it, as what
+    // a meter lets a client see depends on the association.  Only classes
+    // given a time to live are cached.  Once the size limit is reached the
+    // least recently used entry makes way.  The caller invalidates an
+    // object whenever it sends it a SET or ACTION.  Not thread-safe; use it
+    // from the thread which runs the io_service, as for the pool.
+    //
+    class LinuxAttributeCache
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        LinuxAttributeCache(size_t MaxEntries = 100000);
+        virtual ~LinuxAttributeCache();
+
+        void SetTTL(uint16_t ClassID, Clock::duration TTL);
+        //
+        // Fills in *pValue and returns true if a live value is cached.
+        //
+        bool Find(const std::string& MeterURL, uint16_t ClientSAP, uint16_t ClassID, const std::string& OBIS,
+            uint8_t Attribute, std::string * pValue);
+        void Store(const std::string& MeterURL, uint16_t ClientSAP, uint16_t ClassID, const std::string& OBIS,
+            uint8_t Attribute, const std::string& Value);
+        //
+        // Drops every cached attribute of one object, whichever client
+        // read it.
+        //
+        void Invalidate(const std::string& MeterURL, uint16_t ClassID, const std::string& OBIS);
+        void Clear();
+        size_t Size() const;
+        uint64_t GetHits() const;
+        uint64_t GetMisses() const;
+
+    private:
+        typedef std::tuple<std::string, uint16_t, std::string, uint16_t, uint8_t> Key;
+        typedef std::list<Key> LRUList;
+        struct Entry
+        {
+            std::string        m_Value;
+            Clock::time_point  m_Expires;
+            LRUList::iterator  m_LRU;
+        };
+        typedef std::map<Key, Entry> EntryMap;
+
+        void Erase(EntryMap::iterator It);
+
+        size_t                              m_MaxEntries;
+        std::map<uint16_t, Clock::duration> m_TTLs;
+        EntryMap                            m_Entries;
+        // most recently used at the front
+        LRUList                             m_LRU;
+        uint64_t                            m_Hits = 0;
+        uint64_t                            m_Misses = 0;
+
+    };
+
+}
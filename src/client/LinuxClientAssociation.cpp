@@ -0,0 +1,631 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "LinuxClientAssociation.h"
+#include "LinuxCore.h"
+#include "LinuxSocket.h"
+#include "LinuxScheduler.h"
+#include "IBaseLibrary.h"
+#include "tcpwrapper/TCPWrapper.h"
+
+namespace EPRI
+{
+    LinuxClientAssociation::LinuxClientAssociation(asio::io_service& IO, const Options& Opt /*= Options()*/) :
+        m_IO(IO), m_Options(Opt), m_RetryTimer(IO), m_RequestTimer(IO),
+        m_pSocket(Base()->GetCore()->GetIP()->CreateSocket(
+            LinuxIP::Options(LinuxIP::Options::MODE_CLIENT, LinuxIP::Options::VERSION6))),
+        m_Strand(static_cast<LinuxTCPSocket *>(m_pSocket)->GetStrand()),
+        m_WrapperSocket(m_pSocket),
+        m_Engine(COSEMClientEngine::Options(Opt.m_ClientAddress), new TCPWrapper(&m_WrapperSocket))
+    {
+        //
+        // The TCPWrapper has registered its own socket handlers, so chain ours
+        // behind them.
+        //
+        m_PreviousConnect = m_pSocket->RegisterConnectHandler(
+            std::bind(&LinuxClientAssociation::Socket_Connect_Handler, this, std::placeholders::_1));
+        m_PreviousClose = m_pSocket->RegisterCloseHandler(
+            std::bind(&LinuxClientAssociation::Socket_Close_Handler, this, std::placeholders::_1));
+
+        m_Engine.RegisterOpenHandler(
+            std::bind(&LinuxClientAssociation::Engine_Open_Handler, this, std::placeholders::_1));
+        m_Engine.RegisterGetHandler(
+            std::bind(&LinuxClientAssociation::Engine_Get_Handler, this, std::placeholders::_1, std::placeholders::_2));
+        m_Engine.RegisterSetHandler(
+            std::bind(&LinuxClientAssociation::Engine_Set_Handler, this, std::placeholders::_1, std::placeholders::_2));
+        m_Engine.RegisterActionHandler(
+            std::bind(&LinuxClientAssociation::Engine_Action_Handler, this, std::placeholders::_1, std::placeholders::_2));
+        m_Engine.RegisterReleaseHandler(
+            std::bind(&LinuxClientAssociation::Engine_Release_Handler, this));
+        m_Engine.RegisterAbortHandler(
+            std::bind(&LinuxClientAssociation::Engine_Abort_Handler, this, std::placeholders::_1));
+    }
+
+    LinuxClientAssociation::~LinuxClientAssociation()
+    {
+        if (m_pTimer)
+        {
+            m_pTimer->Stop();
+        }
+        m_RetryTimer.cancel();
+        m_RequestTimer.cancel();
+        //
+        // Nothing registered on the socket may outlive us or the engine's
+        // transport; the socket itself is only removed after a post.
+        //
+        m_pSocket->RegisterConnectHandler(nullptr);
+        m_pSocket->RegisterWriteHandler(nullptr);
+        m_pSocket->RegisterReadHandler(nullptr);
+        m_pSocket->RegisterCloseHandler(nullptr);
+        Base()->GetCore()->GetIP()->ReleaseSocket(m_pSocket);
+    }
+
+    bool LinuxClientAssociation::Open(const std::string& MeterURL, CompletionFunction Callback)
+    {
+        if (IDLE != m_State)
+        {
+            return false;
+        }
+        //
+        // A meter on a non-standard port is addressed as "[address]:port".
+        //
+        std::string Address = MeterURL;
+        int         Port = DEFAULT_DLMS_PORT;
+        size_t      Bracket = Address.find(']');
+        if (!Address.empty() && '[' == Address[0] && std::string::npos != Bracket)
+        {
+            if (Bracket + 1 < Address.size() && ':' == Address[Bracket + 1])
+            {
+                Port = std::atoi(Address.c_str() + Bracket + 2);
+            }
+            Address = Address.substr(1, Bracket - 1);
+        }
+        m_State = CONNECTING;
+        m_Callback = Callback;
+        m_PhaseStarted = std::chrono::steady_clock::now();
+        StartTimer();
+        if (SUCCESSFUL != m_WrapperSocket.Open(Address.c_str(), Port))
+        {
+            Base()->GetDebug()->TRACE("Failed to initiate connect to %s\n", MeterURL.c_str());
+            Fail();
+        }
+        return true;
+    }
+
+    bool LinuxClientAssociation::Get(const Cosem_Attribute_Descriptor& Descriptor, GetCompletionFunction Callback,
+        uint32_t TimeOutInMS /*= 0*/)
+    {
+        COSEMClientEngine::RequestToken Token;
+        if (!CanSubmit() || !m_Engine.Get(Descriptor, &Token))
+        {
+            return false;
+        }
+        PendingRequest Request;
+        Request.m_GetCallback = Callback;
+        Request.m_Deadline = GetDeadline(TimeOutInMS);
+        Track(Token, std::move(Request));
+        return true;
+    }
+
+    bool LinuxClientAssociation::GetList(const std::vector<Cosem_Attribute_Descriptor>& Descriptors,
+        GetListCompletionFunction Callback, uint32_t TimeOutInMS /*= 0*/)
+    {
+        if (Descriptors.empty() || !CanSubmit(Descriptors.size()))
+        {
+            return false;
+        }
+        //
+        // The engine builds a GET-Request-Normal for each descriptor, which
+        // the wrapper socket bundles into one GET-Request-With-List.  Its
+        // response comes back split per request and is matched up again by
+        // token.
+        //
+        std::shared_ptr<PendingList> pList = std::make_shared<PendingList>();
+        pList->m_Callback = Callback;
+        pList->m_Responses.assign(Descriptors.size(), COSEMClientEngine::GetResponse());
+        std::vector<std::pair<COSEMClientEngine::RequestToken, size_t>> Sent;
+        m_WrapperSocket.BeginList();
+        for (size_t Index = 0; Index < Descriptors.size(); ++Index)
+        {
+            COSEMClientEngine::RequestToken Token;
+            if (m_Engine.Get(Descriptors[Index], &Token))
+            {
+                Sent.push_back(std::make_pair(Token, Index));
+            }
+            else
+            {
+                pList->m_Success = false;
+            }
+        }
+        m_WrapperSocket.EndList();
+        if (Sent.empty())
+        {
+            return false;
+        }
+        //
+        // Only track once everything is sent, so that the list can't
+        // complete part way through.
+        //
+        pList->m_Outstanding = Sent.size();
+        const Deadline Expiry = GetDeadline(TimeOutInMS);
+        for (const auto& Item : Sent)
+        {
+            PendingRequest Request;
+            Request.m_pList = pList;
+            Request.m_ListIndex = Item.second;
+            Request.m_Deadline = Expiry;
+            Track(Item.first, std::move(Request));
+        }
+        return true;
+    }
+
+    bool LinuxClientAssociation::Set(const Cosem_Attribute_Descriptor& Descriptor, const DLMSVector& Value,
+        CompletionFunction Callback, uint32_t TimeOutInMS /*= 0*/)
+    {
+        COSEMClientEngine::RequestToken Token;
+        if (!CanSubmit() || !m_Engine.Set(Descriptor, Value, &Token))
+        {
+            return false;
+        }
+        PendingRequest Request;
+        Request.m_Callback = Callback;
+        Request.m_Deadline = GetDeadline(TimeOutInMS);
+        Track(Token, std::move(Request));
+        return true;
+    }
+
+    bool LinuxClientAssociation::Action(const Cosem_Method_Descriptor& Descriptor,
+        const DLMSOptional<DLMSVector>& Parameters, CompletionFunction Callback, uint32_t TimeOutInMS /*= 0*/)
+    {
+        COSEMClientEngine::RequestToken Token;
+        if (!CanSubmit() || !m_Engine.Action(Descriptor, Parameters, &Token))
+        {
+            return false;
+        }
+        PendingRequest Request;
+        Request.m_Callback = Callback;
+        Request.m_Deadline = GetDeadline(TimeOutInMS);
+        Track(Token, std::move(Request));
+        return true;
+    }
+
+    bool LinuxClientAssociation::Release(CompletionFunction Callback)
+    {
+        if (!IsIdle())
+        {
+            return false;
+        }
+        m_State = RELEASING;
+        m_Callback = Callback;
+        m_PhaseStarted = std::chrono::steady_clock::now();
+        StartTimer();
+        if (!m_Engine.Release(xDLMS::InitiateRequest()))
+        {
+            Fail();
+        }
+        return true;
+    }
+
+    LinuxClientAssociation::AssociationState LinuxClientAssociation::GetState() const
+    {
+        return m_State;
+    }
+
+    bool LinuxClientAssociation::IsAssociated() const
+    {
+        return ASSOCIATED == m_State;
+    }
+
+    size_t LinuxClientAssociation::Outstanding() const
+    {
+        return m_Pending.size();
+    }
+
+    void LinuxClientAssociation::Socket_Connect_Handler(ERROR_TYPE Error)
+    {
+        if (m_PreviousConnect)
+        {
+            m_PreviousConnect(Error);
+        }
+        if (CONNECTING != m_State)
+        {
+            return;
+        }
+        if (SUCCESSFUL != Error)
+        {
+            Fail();
+            return;
+        }
+        RecordPhase(LinuxMetrics::PHASE_CONNECT);
+        LinuxScheduler::PostTo(m_Strand, std::bind(&LinuxClientAssociation::Associate, shared_from_this()));
+    }
+
+    void LinuxClientAssociation::Socket_Close_Handler(ERROR_TYPE Error)
+    {
+        if (m_PreviousClose)
+        {
+            m_PreviousClose(Error);
+        }
+        Fail();
+    }
+
+    void LinuxClientAssociation::Engine_Open_Handler(COSEMAddressType ServerAddress)
+    {
+        if (ASSOCIATING == m_State)
+        {
+            m_State = ASSOCIATED;
+            RecordPhase(LinuxMetrics::PHASE_ASSOCIATE);
+            Complete(true);
+        }
+    }
+
+    void LinuxClientAssociation::Engine_Get_Handler(COSEMClientEngine::RequestToken Token,
+        const COSEMClientEngine::GetResponse& Response)
+    {
+        CompleteRequest(Token, !(Response.ResultValid &&
+            Response.Result.which() == Get_Data_Result_Choice::data_access_result), Response);
+    }
+
+    void LinuxClientAssociation::Engine_Set_Handler(COSEMClientEngine::RequestToken Token,
+        const COSEMClientEngine::SetResponse& Response)
+    {
+        CompleteRequest(Token, Response.ResultValid && APDUConstants::Data_Access_Result::success == Response.Result);
+    }
+
+    void LinuxClientAssociation::Engine_Action_Handler(COSEMClientEngine::RequestToken Token,
+        const COSEMClientEngine::ActionResponse& Response)
+    {
+        CompleteRequest(Token, Response.ResultValid && APDUConstants::Action_Result::success == Response.Result);
+    }
+
+    void LinuxClientAssociation::Engine_Release_Handler()
+    {
+        if (RELEASING == m_State)
+        {
+            m_State = CLOSED;
+            RecordPhase(LinuxMetrics::PHASE_RELEASE);
+            Complete(true);
+        }
+    }
+
+    void LinuxClientAssociation::Engine_Abort_Handler(COSEMAddressType ServerAddress)
+    {
+        CountOutcome(LinuxMetrics::OUTCOME_ABORT);
+        Fail();
+    }
+
+    void LinuxClientAssociation::Phase_Timeout_Handler()
+    {
+        //
+        // The wheel may have queued the expiry before the timer was stopped
+        // or started again.
+        //
+        if (m_pTimer->IsExpired())
+        {
+            Base()->GetDebug()->TRACE("Association timed out in state %d\n", m_State);
+            CountOutcome(LinuxMetrics::OUTCOME_TIMEOUT);
+            Fail();
+        }
+    }
+
+    void LinuxClientAssociation::ASIO_Request_Timeout_Handler(const asio::error_code& Error)
+    {
+        if (asio::error::operation_aborted == Error)
+        {
+            return;
+        }
+        //
+        // Fail every request whose deadline has passed, then wait for the
+        // next one.  A late response for one of them is simply ignored.
+        //
+        const Deadline Now = std::chrono::steady_clock::now();
+        PendingTable::iterator it = m_Pending.begin();
+        while (it != m_Pending.end())
+        {
+            if (it->second.m_Deadline <= Now)
+            {
+                Base()->GetDebug()->TRACE("Request %u timed out\n", unsigned(it->first));
+                CountOutcome(LinuxMetrics::OUTCOME_TIMEOUT);
+                PendingRequest Request = std::move(it->second);
+                it = m_Pending.erase(it);
+                Dispatch(Request, false, COSEMClientEngine::GetResponse());
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        StartRequestTimer();
+    }
+
+    void LinuxClientAssociation::Associate()
+    {
+        if (CONNECTING != m_State)
+        {
+            return;
+        }
+        //
+        // The transport may still be settling the connection; try again shortly.
+        //
+        if (!m_Engine.IsTransportConnected())
+        {
+            std::weak_ptr<LinuxClientAssociation> Self = shared_from_this();
+            m_RetryTimer.expires_from_now(std::chrono::milliseconds(1));
+            m_RetryTimer.async_wait(LinuxScheduler::Wrap(m_Strand, 
+                [Self](const asio::error_code& Error)
+                {
+                    std::shared_ptr<LinuxClientAssociation> pThis = Self.lock();
+                    if (pThis && !Error)
+                    {
+                        pThis->Associate();
+                    }
+                }));
+            return;
+        }
+        COSEMSecurityOptions SecurityOptions;
+        SecurityOptions.ApplicationContextName = SecurityOptions.ContextLNRNoCipher;
+        m_State = ASSOCIATING;
+        m_PhaseStarted = std::chrono::steady_clock::now();
+        if (!m_Engine.Open(m_Options.m_ServerAddress,
+                           SecurityOptions,
+                           xDLMS::InitiateRequest(m_Options.m_APDUSize)))
+        {
+            Fail();
+        }
+    }
+
+    bool LinuxClientAssociation::IsIdle() const
+    {
+        return ASSOCIATED == m_State && !m_Callback && m_Pending.empty();
+    }
+
+    bool LinuxClientAssociation::CanSubmit(size_t Requests /*= 1*/) const
+    {
+        return ASSOCIATED == m_State && !m_Callback &&
+            m_Pending.size() + Requests <= m_Options.m_PipelineDepth;
+    }
+
+    void LinuxClientAssociation::StartTimer()
+    {
+        if (!m_pTimer)
+        {
+            //
+            // The wheel calls back on whichever strand started the timer,
+            // which need not be ours.
+            //
+            std::weak_ptr<LinuxClientAssociation> Self = shared_from_this();
+            m_pTimer = static_cast<LinuxCore *>(Base()->GetCore())->CreateSimpleTimer(
+                [Self]()
+                {
+                    std::shared_ptr<LinuxClientAssociation> pThis = Self.lock();
+                    if (pThis)
+                    {
+                        LinuxScheduler::PostTo(pThis->m_Strand,
+                            [Self]()
+                            {
+                                std::shared_ptr<LinuxClientAssociation> pThis = Self.lock();
+                                if (pThis)
+                                {
+                                    pThis->Phase_Timeout_Handler();
+                                }
+                            });
+                    }
+                });
+        }
+        m_pTimer->Initialize(m_Options.m_TimeOutInMS);
+        m_pTimer->Start();
+    }
+
+    LinuxClientAssociation::Deadline LinuxClientAssociation::GetDeadline(uint32_t TimeOutInMS) const
+    {
+        return std::chrono::steady_clock::now() + 
+            std::chrono::milliseconds(TimeOutInMS ? TimeOutInMS : m_Options.m_TimeOutInMS);
+    }
+
+    void LinuxClientAssociation::Track(COSEMClientEngine::RequestToken Token, PendingRequest Request)
+    {
+        //
+        // The request timer always runs to the earliest deadline, so it only
+        // needs moving if the new request expires before everything else.
+        //
+        const bool Earliest = m_Pending.empty() || Request.m_Deadline < m_RequestTimer.expires_at();
+        Request.m_Started = std::chrono::steady_clock::now();
+        m_Pending[Token] = std::move(Request);
+        if (Earliest)
+        {
+            StartRequestTimer();
+        }
+    }
+
+    void LinuxClientAssociation::StartRequestTimer()
+    {
+        if (m_Pending.empty())
+        {
+            m_RequestTimer.cancel();
+            return;
+        }
+        Deadline Expiry = m_Pending.begin()->second.m_Deadline;
+        for (const auto& Item : m_Pending)
+        {
+            Expiry = std::min(Expiry, Item.second.m_Deadline);
+        }
+        std::weak_ptr<LinuxClientAssociation> Self = shared_from_this();
+        m_RequestTimer.expires_at(Expiry);
+        m_RequestTimer.async_wait(LinuxScheduler::Wrap(m_Strand, 
+            [Self](const asio::error_code& Error)
+            {
+                std::shared_ptr<LinuxClientAssociation> pThis = Self.lock();
+                if (pThis)
+                {
+                    pThis->ASIO_Request_Timeout_Handler(Error);
+                }
+            }));
+    }
+
+    void LinuxClientAssociation::Complete(bool Success)
+    {
+        CompletionFunction Callback;
+        if (m_pTimer)
+        {
+            m_pTimer->Stop();
+        }
+        std::swap(Callback, m_Callback);
+        if (Callback)
+        {
+            LinuxScheduler::PostTo(m_Strand, std::bind(Callback, Success));
+        }
+    }
+
+    void LinuxClientAssociation::CompleteRequest(COSEMClientEngine::RequestToken Token, bool Success,
+        const COSEMClientEngine::GetResponse& Response /*= COSEMClientEngine::GetResponse()*/)
+    {
+        PendingTable::iterator it = m_Pending.find(Token);
+        if (ASSOCIATED != m_State || it == m_Pending.end())
+        {
+            return;
+        }
+        PendingRequest Request = std::move(it->second);
+        m_Pending.erase(it);
+        if (m_Pending.empty())
+        {
+            m_RequestTimer.cancel();
+        }
+        if (m_Options.m_pMetrics)
+        {
+            m_Options.m_pMetrics->Record(LinuxMetrics::PHASE_REQUEST, 
+                std::chrono::steady_clock::now() - Request.m_Started);
+        }
+        CountOutcome(Success ? LinuxMetrics::OUTCOME_SUCCESS : LinuxMetrics::OUTCOME_FAILURE);
+        Dispatch(Request, Success, Response);
+    }
+
+    void LinuxClientAssociation::Dispatch(PendingRequest& Request, bool Success,
+        const COSEMClientEngine::GetResponse& Response)
+    {
+        if (Request.m_pList)
+        {
+            PendingList& List = *Request.m_pList;
+            List.m_Responses[Request.m_ListIndex] = Response;
+            List.m_Success = List.m_Success && Success;
+            if (0 == --List.m_Outstanding && List.m_Callback)
+            {
+                LinuxScheduler::PostTo(m_Strand, std::bind(List.m_Callback, List.m_Success, std::move(List.m_Responses)));
+            }
+        }
+        else if (Request.m_GetCallback)
+        {
+            LinuxScheduler::PostTo(m_Strand, std::bind(Request.m_GetCallback, Success, Response));
+        }
+        else if (Request.m_Callback)
+        {
+            LinuxScheduler::PostTo(m_Strand, std::bind(Request.m_Callback, Success));
+        }
+    }
+
+    void LinuxClientAssociation::Fail()
+    {
+        if (CLOSED == m_State && !m_Callback && m_Pending.empty())
+        {
+            return;
+        }
+        m_State = CLOSED;
+        m_RetryTimer.cancel();
+        m_RequestTimer.cancel();
+        PendingTable Pending;
+        std::swap(Pending, m_Pending);
+        for (auto& Item : Pending)
+        {
+            Dispatch(Item.second, false, COSEMClientEngine::GetResponse());
+        }
+        Complete(false);
+    }
+
+    void LinuxClientAssociation::RecordPhase(LinuxMetrics::Phase Which)
+    {
+        if (m_Options.m_pMetrics)
+        {
+            m_Options.m_pMetrics->Record(Which, std::chrono::steady_clock::now() - m_PhaseStarted);
+        }
+    }
+
+    void LinuxClientAssociation::CountOutcome(LinuxMetrics::Outcome Which)
+    {
+        if (m_Options.m_pMetrics)
+        {
+            m_Options.m_pMetrics->Count(Which);
+        }
+    }
+
+}
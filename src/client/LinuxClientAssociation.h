@@ -0,0 +1,257 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "COSEM.h"
+#include "ISocket.h"
+#include "LinuxClientEngine.h"
+#include "LinuxMetrics.h"
+#include "LinuxSimpleTimer.h"
+#include "LinuxWrapperSocket.h"
+
+namespace EPRI
+{
+    //
+    // A client association with a single meter, driven entirely by transport
+    // and engine callbacks: connect -> AARQ -> requests -> RLRQ.  Each
+    // operation reports its outcome through a completion callback which is
+    // posted to the io_service, never invoked from inside the engine.
+    // Everything runs on the socket's strand, so an association may be
+    // driven from an io_service running on several threads.
+    //
+    // Once associated, GET, SET and ACTION requests may be pipelined: up to
+    // m_PipelineDepth of them can be outstanding at once, each tracked by its
+    // engine token and with its own timeout.  A request which times out fails
+    // on its own; the association stays open.
+    //
+    // Instances must be owned by a std::shared_ptr.
+    //
+    class LinuxClientAssociation : public std::enable_shared_from_this<LinuxClientAssociation>
+    {
+    public:
+        enum AssociationState
+        {
+            IDLE,
+            CONNECTING,
+            ASSOCIATING,
+            ASSOCIATED,
+            RELEASING,
+            CLOSED
+        };
+
+        struct Options
+        {
+            Options(COSEMAddressType ClientAddress = 1,
+                COSEMAddressType ServerAddress = 1,
+                size_t APDUSize = 640,
+                uint32_t TimeOutInMS = 40000,
+                size_t PipelineDepth = 16,
+                LinuxMetrics * pMetrics = nullptr) :
+                m_ClientAddress(ClientAddress),
+                m_ServerAddress(ServerAddress),
+                m_APDUSize(APDUSize),
+                m_TimeOutInMS(TimeOutInMS),
+                m_PipelineDepth(PipelineDepth),
+                m_pMetrics(pMetrics)
+            {
+            }
+            COSEMAddressType m_ClientAddress;
+            COSEMAddressType m_ServerAddress;
+            size_t           m_APDUSize;
+            uint32_t         m_TimeOutInMS;
+            //
+            // The invoke-id is four bits wide, so no more than 16 requests
+            // can be told apart on the wire.
+            //
+            size_t           m_PipelineDepth;
+            //
+            // If set, the time taken by each phase and the outcome of each
+            // request are recorded here.  It must outlive the association.
+            //
+            LinuxMetrics *   m_pMetrics;
+        };
+
+        typedef std::function<void(bool)> CompletionFunction;
+        typedef std::function<void(bool, const COSEMClientEngine::GetResponse&)> GetCompletionFunction;
+        typedef std::vector<COSEMClientEngine::GetResponse> GetResponseList;
+        typedef std::function<void(bool, const GetResponseList&)> GetListCompletionFunction;
+
+        LinuxClientAssociation() = delete;
+        LinuxClientAssociation(asio::io_service& IO, const Options& Opt = Options());
+        virtual ~LinuxClientAssociation();
+
+        bool Open(const std::string& MeterURL, CompletionFunction Callback);
+        //
+        // A TimeOutInMS of zero means Options::m_TimeOutInMS.
+        //
+        bool Get(const Cosem_Attribute_Descriptor& Descriptor, GetCompletionFunction Callback,
+            uint32_t TimeOutInMS = 0);
+        //
+        // Reads several attributes with one GET-Request-With-List.  The
+        // responses come back in the order of the descriptors; the flag is
+        // only true if every one of them succeeded.
+        //
+        bool GetList(const std::vector<Cosem_Attribute_Descriptor>& Descriptors, GetListCompletionFunction Callback,
+            uint32_t TimeOutInMS = 0);
+        bool Set(const Cosem_Attribute_Descriptor& Descriptor, const DLMSVector& Value,
+            CompletionFunction Callback, uint32_t TimeOutInMS = 0);
+        bool Action(const Cosem_Method_Descriptor& Descriptor, const DLMSOptional<DLMSVector>& Parameters,
+            CompletionFunction Callback, uint32_t TimeOutInMS = 0);
+        bool Release(CompletionFunction Callback);
+
+        AssociationState GetState() const;
+        bool IsAssociated() const;
+        size_t Outstanding() const;
+
+    private:
+        typedef std::chrono::steady_clock::time_point Deadline;
+
+        struct PendingList
+        {
+            GetListCompletionFunction m_Callback;
+            GetResponseList           m_Responses;
+            size_t                    m_Outstanding = 0;
+            bool                      m_Success = true;
+        };
+        //
+        // One outstanding request.  Exactly one of the callbacks (or the list)
+        // is set, depending on the kind of request.
+        //
+        struct PendingRequest
+        {
+            GetCompletionFunction        m_GetCallback;
+            CompletionFunction           m_Callback;
+            std::shared_ptr<PendingList> m_pList;
+            size_t                       m_ListIndex = 0;
+            Deadline                     m_Deadline;
+            Deadline                     m_Started;
+        };
+        typedef std::map<COSEMClientEngine::RequestToken, PendingRequest> PendingTable;
+
+        void Socket_Connect_Handler(ERROR_TYPE Error);
+        void Socket_Close_Handler(ERROR_TYPE Error);
+        void Engine_Open_Handler(COSEMAddressType ServerAddress);
+        void Engine_Get_Handler(COSEMClientEngine::RequestToken Token, const COSEMClientEngine::GetResponse& Response);
+        void Engine_Set_Handler(COSEMClientEngine::RequestToken Token, const COSEMClientEngine::SetResponse& Response);
+        void Engine_Action_Handler(COSEMClientEngine::RequestToken Token, const COSEMClientEngine::ActionResponse& Response);
+        void Engine_Release_Handler();
+        void Engine_Abort_Handler(COSEMAddressType ServerAddress);
+        void Phase_Timeout_Handler();
+        void ASIO_Request_Timeout_Handler(const asio::error_code& Error);
+
+        void Associate();
+        bool IsIdle() const;
+        bool CanSubmit(size_t Requests = 1) const;
+        void StartTimer();
+        Deadline GetDeadline(uint32_t TimeOutInMS) const;
+        void Track(COSEMClientEngine::RequestToken Token, PendingRequest Request);
+        void StartRequestTimer();
+        void Complete(bool Success);
+        void CompleteRequest(COSEMClientEngine::RequestToken Token, bool Success,
+            const COSEMClientEngine::GetResponse& Response = COSEMClientEngine::GetResponse());
+        void Dispatch(PendingRequest& Request, bool Success, const COSEMClientEngine::GetResponse& Response);
+        void Fail();
+        void RecordPhase(LinuxMetrics::Phase Which);
+        void CountOutcome(LinuxMetrics::Outcome Which);
+
+        asio::io_service&               m_IO;
+        Options                         m_Options;
+        //
+        // Bounds the connect, AARQ and RLRQ phases; on the core's timer
+        // wheel, as it is restarted for every association.
+        //
+        std::shared_ptr<LinuxSimpleTimer> m_pTimer;
+        asio::steady_timer              m_RetryTimer;
+        asio::steady_timer              m_RequestTimer;
+        ISocket *                       m_pSocket;
+        asio::io_service::strand&       m_Strand;
+        LinuxWrapperSocket              m_WrapperSocket;
+        LinuxClientEngine               m_Engine;
+        AssociationState                m_State = IDLE;
+        Deadline                        m_PhaseStarted;
+        CompletionFunction              m_Callback;
+        PendingTable                    m_Pending;
+        ISocket::ConnectCallbackFunction m_PreviousConnect;
+        ISocket::CloseCallbackFunction  m_PreviousClose;
+
+    };
+
+}
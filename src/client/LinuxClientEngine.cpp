@@ -0,0 +1,266 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include "LinuxClientEngine.h"
+
+namespace EPRI
+{
+    LinuxClientEngine::LinuxClientEngine(const Options& Opt, Transport * pXPort) :
+        COSEMClientEngine(Opt, pXPort), m_pXPort(pXPort)
+    {
+    }
+
+    LinuxClientEngine::~LinuxClientEngine()
+    {
+        delete m_pXPort;
+    }
+
+    LinuxClientEngine::OpenCallbackFunction LinuxClientEngine::RegisterOpenHandler(OpenCallbackFunction Callback)
+    {
+        OpenCallbackFunction RetVal = m_Open;
+        m_Open = Callback;
+        return RetVal;
+    }
+
+    LinuxClientEngine::GetCallbackFunction LinuxClientEngine::RegisterGetHandler(GetCallbackFunction Callback)
+    {
+        GetCallbackFunction RetVal = m_Get;
+        m_Get = Callback;
+        return RetVal;
+    }
+
+    LinuxClientEngine::SetCallbackFunction LinuxClientEngine::RegisterSetHandler(SetCallbackFunction Callback)
+    {
+        SetCallbackFunction RetVal = m_Set;
+        m_Set = Callback;
+        return RetVal;
+    }
+
+    LinuxClientEngine::ActionCallbackFunction LinuxClientEngine::RegisterActionHandler(ActionCallbackFunction Callback)
+    {
+        ActionCallbackFunction RetVal = m_Action;
+        m_Action = Callback;
+        return RetVal;
+    }
+
+    LinuxClientEngine::ReleaseCallbackFunction LinuxClientEngine::RegisterReleaseHandler(ReleaseCallbackFunction Callback)
+    {
+        ReleaseCallbackFunction RetVal = m_Release;
+        m_Release = Callback;
+        return RetVal;
+    }
+
+    LinuxClientEngine::AbortCallbackFunction LinuxClientEngine::RegisterAbortHandler(AbortCallbackFunction Callback)
+    {
+        AbortCallbackFunction RetVal = m_Abort;
+        m_Abort = Callback;
+        return RetVal;
+    }
+
+    bool LinuxClientEngine::OnOpenConfirmation(COSEMAddressType ServerAddress)
+    {
+        Base()->GetDebug()->TRACE("Associated with Server %d...\n",
+            ServerAddress);
+        if (m_Open)
+        {
+            m_Open(ServerAddress);
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnGetConfirmation(RequestToken Token, const GetResponse& Response)
+    {
+        Base()->GetDebug()->TRACE("Get Confirmation for Token %d...\n", Token);
+        if (m_Get)
+        {
+            m_Get(Token, Response);
+        }
+        if (Response.ResultValid && Response.Result.which() == Get_Data_Result_Choice::data_access_result)
+        {
+            Base()->GetDebug()->TRACE("\tReturned Error Code %d...\n",
+                Response.Result.get<APDUConstants::Data_Access_Result>());
+            return false;
+        }
+
+        switch (Response.Descriptor.class_id)
+        {
+        case CLSID_IData:
+            {
+                IData     SerialNumbers;
+                DLMSValue Value;
+
+                SerialNumbers.value = Response.Result.get<DLMSVector>();
+                if (COSEMType::VALUE_RETRIEVED == SerialNumbers.value.GetNextValue(&Value))
+                {
+                    Base()->GetDebug()->TRACE("%s\n", DLMSValueGet<VISIBLE_STRING_CType>(Value).c_str());
+                }
+            }
+            break;
+        case CLSID_IAssociationLN:
+            {
+                IAssociationLN CurrentAssociation;
+                DLMSValue      Value;
+
+                switch (Response.Descriptor.attribute_id)
+                {
+                case IAssociationLN::ATTR_PARTNERS_ID:
+                    {
+                        CurrentAssociation.associated_partners_id = Response.Result.get<DLMSVector>();
+                        if (COSEMType::VALUE_RETRIEVED == CurrentAssociation.associated_partners_id.GetNextValue(&Value) &&
+                            IsSequence(Value))
+                        {
+                            DLMSSequence& Element = DLMSValueGetSequence(Value);
+                            Base()->GetDebug()->TRACE("ClientSAP %d; ServerSAP %d\n",
+                                DLMSValueGet<INTEGER_CType>(Element[0]),
+                                DLMSValueGet<LONG_UNSIGNED_CType>(Element[1]));
+                        }
+                    }
+                    break;
+
+                default:
+                    Base()->GetDebug()->TRACE("Attribute %d not supported for parsing.", Response.Descriptor.attribute_id);
+                    break;
+                }
+            }
+            break;
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnSetConfirmation(RequestToken Token, const SetResponse& Response)
+    {
+        Base()->GetDebug()->TRACE("Set Confirmation for Token %d...\n", Token);
+        if (Response.ResultValid)
+        {
+            Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
+                Response.Result);
+        }
+        if (m_Set)
+        {
+            m_Set(Token, Response);
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnActionConfirmation(RequestToken Token, const ActionResponse& Response)
+    {
+        Base()->GetDebug()->TRACE("Action Confirmation for Token %d...\n", Token);
+        if (Response.ResultValid)
+        {
+            Base()->GetDebug()->TRACE("\tResponse Code %d...\n",
+                Response.Result);
+        }
+        if (m_Action)
+        {
+            m_Action(Token, Response);
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnReleaseConfirmation()
+    {
+        Base()->GetDebug()->TRACE("Release Confirmation from Server\n");
+        if (m_Release)
+        {
+            m_Release();
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnReleaseConfirmation(COSEMAddressType ServerAddress)
+    {
+        Base()->GetDebug()->TRACE("Release Confirmation from Server %d\n", ServerAddress);
+        if (m_Release)
+        {
+            m_Release();
+        }
+        return true;
+    }
+
+    bool LinuxClientEngine::OnAbortIndication(COSEMAddressType ServerAddress)
+    {
+        if (INVALID_ADDRESS == ServerAddress)
+        {
+            Base()->GetDebug()->TRACE("Abort Indication.  Not Associated.\n");
+        }
+        else
+        {
+            Base()->GetDebug()->TRACE("Abort Indication from Server %d\n", ServerAddress);
+        }
+        if (m_Abort)
+        {
+            m_Abort(ServerAddress);
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,122 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <functional>
+
+#include "COSEM.h"
+
+namespace EPRI
+{
+    class LinuxClientEngine : public COSEMClientEngine
+    {
+    public:
+        typedef std::function<void(COSEMAddressType)>                   OpenCallbackFunction;
+        typedef std::function<void(RequestToken, const GetResponse&)>    GetCallbackFunction;
+        typedef std::function<void(RequestToken, const SetResponse&)>    SetCallbackFunction;
+        typedef std::function<void(RequestToken, const ActionResponse&)> ActionCallbackFunction;
+        typedef std::function<void()>                                    ReleaseCallbackFunction;
+        typedef std::function<void(COSEMAddressType)>                   AbortCallbackFunction;
+
+        LinuxClientEngine() = delete;
+        LinuxClientEngine(const Options& Opt, Transport * pXPort);
+        virtual ~LinuxClientEngine();
+
+        OpenCallbackFunction RegisterOpenHandler(OpenCallbackFunction Callback);
+        GetCallbackFunction RegisterGetHandler(GetCallbackFunction Callback);
+        SetCallbackFunction RegisterSetHandler(SetCallbackFunction Callback);
+        ActionCallbackFunction RegisterActionHandler(ActionCallbackFunction Callback);
+        ReleaseCallbackFunction RegisterReleaseHandler(ReleaseCallbackFunction Callback);
+        AbortCallbackFunction RegisterAbortHandler(AbortCallbackFunction Callback);
+        //
+        // COSEMClientEngine
+        //
+        virtual bool OnOpenConfirmation(COSEMAddressType ServerAddress);
+        virtual bool OnGetConfirmation(RequestToken Token, const GetResponse& Response);
+        virtual bool OnSetConfirmation(RequestToken Token, const SetResponse& Response);
+        virtual bool OnActionConfirmation(RequestToken Token, const ActionResponse& Response);
+        virtual bool OnReleaseConfirmation();
+        virtual bool OnReleaseConfirmation(COSEMAddressType ServerAddress);
+        virtual bool OnAbortIndication(COSEMAddressType ServerAddress);
+
+    private:
+        Transport *             m_pXPort = nullptr;
+        OpenCallbackFunction    m_Open;
+        GetCallbackFunction     m_Get;
+        SetCallbackFunction     m_Set;
+        ActionCallbackFunction  m_Action;
+        ReleaseCallbackFunction m_Release;
+        AbortCallbackFunction   m_Abort;
+    };
+
+}
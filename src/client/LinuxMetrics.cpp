@@ -0,0 +1,339 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "LinuxMetrics.h"
+
+namespace EPRI
+{
+    namespace
+    {
+        uint64_t Micros(LinuxHistogram::Duration Value)
+        {
+            const int64_t Count = std::chrono::duration_cast<std::chrono::microseconds>(Value).count();
+            return Count > 0 ? uint64_t(Count) : 0;
+        }
+
+        unsigned Log2(uint64_t Value)
+        {
+            unsigned Result = 0;
+            while (Value >>= 1)
+            {
+                ++Result;
+            }
+            return Result;
+        }
+
+        const char * PhaseName(LinuxMetrics::Phase Which)
+        {
+            static const char * Names[LinuxMetrics::PHASE_COUNT] = 
+                { "connect", "associate", "request", "release", "total" };
+            return Names[Which];
+        }
+
+        const char * OutcomeName(LinuxMetrics::Outcome Which)
+        {
+            static const char * Names[LinuxMetrics::OUTCOME_COUNT] = 
+                { "success", "failure", "timeout", "abort" };
+            return Names[Which];
+        }
+
+        void Quote(std::ostream& Out, const std::string& Value)
+        {
+            Out << '"';
+            for (char Ch : Value)
+            {
+                if ('"' == Ch || '\\' == Ch)
+                {
+                    Out << '\\';
+                }
+                if (static_cast<unsigned char>(Ch) >= 0x20)
+                {
+                    Out << Ch;
+                }
+            }
+            Out << '"';
+        }
+    }
+    //
+    // LinuxHistogram
+    //
+    LinuxHistogram::LinuxHistogram() :
+        m_Count(0), m_Sum(0), m_Max(0)
+    {
+        for (std::atomic<uint64_t>& Bucket : m_Buckets)
+        {
+            Bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    unsigned LinuxHistogram::BucketOf(uint64_t Value)
+    {
+        if (Value < LINEAR_BUCKETS)
+        {
+            return unsigned(Value);
+        }
+        const unsigned Exponent = Log2(Value);
+        const unsigned SubBucket = unsigned(Value >> (Exponent - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+        return LINEAR_BUCKETS + ((Exponent - 4) << SUB_BUCKET_BITS) + SubBucket;
+    }
+
+    uint64_t LinuxHistogram::UpperBoundOf(unsigned Bucket)
+    {
+        if (Bucket < LINEAR_BUCKETS)
+        {
+            return Bucket;
+        }
+        const unsigned Exponent = ((Bucket - LINEAR_BUCKETS) >> SUB_BUCKET_BITS) + 4;
+        const uint64_t SubBucket = (Bucket - LINEAR_BUCKETS) & ((1 << SUB_BUCKET_BITS) - 1);
+        const uint64_t Width = uint64_t(1) << (Exponent - SUB_BUCKET_BITS);
+        return (uint64_t(1) << Exponent) + (SubBucket + 1) * Width - 1;
+    }
+
+    void LinuxHistogram::Record(Duration Value)
+    {
+        const uint64_t Value_us = Micros(Value);
+        m_Buckets[BucketOf(Value_us)].fetch_add(1, std::memory_order_relaxed);
+        m_Count.fetch_add(1, std::memory_order_relaxed);
+        m_Sum.fetch_add(Value_us, std::memory_order_relaxed);
+        uint64_t Current = m_Max.load(std::memory_order_relaxed);
+        while (Current < Value_us && 
+               !m_Max.compare_exchange_weak(Current, Value_us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t LinuxHistogram::Count() const
+    {
+        return m_Count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LinuxHistogram::Max() const
+    {
+        return m_Max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LinuxHistogram::Mean() const
+    {
+        const uint64_t Samples = Count();
+        return Samples ? m_Sum.load(std::memory_order_relaxed) / Samples : 0;
+    }
+
+    uint64_t LinuxHistogram::Percentile(double Percentile) const
+    {
+        //
+        // The buckets are read one at a time while others may be recording,
+        // so count them up first rather than trusting m_Count.
+        //
+        uint64_t Counts[BUCKETS];
+        uint64_t Total = 0;
+        for (unsigned Bucket = 0; Bucket < BUCKETS; ++Bucket)
+        {
+            Counts[Bucket] = m_Buckets[Bucket].load(std::memory_order_relaxed);
+            Total += Counts[Bucket];
+        }
+        if (!Total)
+        {
+            return 0;
+        }
+        const double Target = std::max(1.0, Percentile / 100.0 * Total);
+        uint64_t Seen = 0;
+        for (unsigned Bucket = 0; Bucket < BUCKETS; ++Bucket)
+        {
+            Seen += Counts[Bucket];
+            if (Seen >= Target)
+            {
+                return std::min(UpperBoundOf(Bucket), Max());
+            }
+        }
+        return Max();
+    }
+    //
+    // LinuxMetrics
+    //
+    LinuxMetrics::LinuxMetrics()
+    {
+        for (std::atomic<uint64_t>& Outcome : m_Outcomes)
+        {
+            Outcome.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void LinuxMetrics::Record(Phase Which, Duration Elapsed)
+    {
+        m_Histograms[Which].Record(Elapsed);
+    }
+
+    void LinuxMetrics::Count(Outcome Which)
+    {
+        m_Outcomes[Which].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void LinuxMetrics::RecordMeter(const std::string& MeterURL, Duration Elapsed, bool Success)
+    {
+        const uint64_t Elapsed_us = Micros(Elapsed);
+        Record(PHASE_TOTAL, Elapsed);
+        std::lock_guard<std::mutex> Lock(m_MeterMutex);
+        MeterSummary& Summary = m_Meters[MeterURL];
+        ++Summary.m_Transactions;
+        if (!Success)
+        {
+            ++Summary.m_Failures;
+        }
+        Summary.m_TotalMicros += Elapsed_us;
+        Summary.m_LastMicros = Elapsed_us;
+        Summary.m_MaxMicros = std::max(Summary.m_MaxMicros, Elapsed_us);
+    }
+
+    void LinuxMetrics::SetGauge(const std::string& Name, uint64_t Value)
+    {
+        std::lock_guard<std::mutex> Lock(m_GaugeMutex);
+        m_Gauges[Name] = Value;
+    }
+
+    const LinuxHistogram& LinuxMetrics::GetHistogram(Phase Which) const
+    {
+        return m_Histograms[Which];
+    }
+
+    uint64_t LinuxMetrics::GetCount(Outcome Which) const
+    {
+        return m_Outcomes[Which].load(std::memory_order_relaxed);
+    }
+
+    std::string LinuxMetrics::ToJSON(size_t SlowestMeters /*= 10*/) const
+    {
+        std::ostringstream Out;
+        Out << "{\"latency_us\":{";
+        for (int Which = 0; Which < PHASE_COUNT; ++Which)
+        {
+            const LinuxHistogram& Histogram = m_Histograms[Which];
+            Out << (Which ? "," : "") << '"' << PhaseName(Phase(Which)) << "\":{"
+                << "\"count\":" << Histogram.Count()
+                << ",\"mean\":" << Histogram.Mean()
+                << ",\"p50\":" << Histogram.Percentile(50)
+                << ",\"p90\":" << Histogram.Percentile(90)
+                << ",\"p99\":" << Histogram.Percentile(99)
+                << ",\"max\":" << Histogram.Max() << '}';
+        }
+        Out << "},\"outcomes\":{";
+        for (int Which = 0; Which < OUTCOME_COUNT; ++Which)
+        {
+            Out << (Which ? "," : "") << '"' << OutcomeName(Outcome(Which)) << "\":" << GetCount(Outcome(Which));
+        }
+        Out << "},\"slowest_meters\":[";
+        {
+            std::lock_guard<std::mutex> Lock(m_MeterMutex);
+            std::vector<std::pair<uint64_t, const std::string *>> Means;
+            Means.reserve(m_Meters.size());
+            for (const auto& Meter : m_Meters)
+            {
+                Means.emplace_back(Meter.second.m_TotalMicros / Meter.second.m_Transactions, &Meter.first);
+            }
+            const size_t Shown = std::min(SlowestMeters, Means.size());
+            std::partial_sort(Means.begin(), Means.begin() + Shown, Means.end(),
+                [](const std::pair<uint64_t, const std::string *>& A, const std::pair<uint64_t, const std::string *>& B)
+                {
+                    return A.first > B.first;
+                });
+            for (size_t Index = 0; Index < Shown; ++Index)
+            {
+                const MeterSummary& Summary = m_Meters.at(*Means[Index].second);
+                Out << (Index ? "," : "") << "{\"meter\":";
+                Quote(Out, *Means[Index].second);
+                Out << ",\"transactions\":" << Summary.m_Transactions
+                    << ",\"failures\":" << Summary.m_Failures
+                    << ",\"mean_us\":" << Means[Index].first
+                    << ",\"last_us\":" << Summary.m_LastMicros
+                    << ",\"max_us\":" << Summary.m_MaxMicros << '}';
+            }
+        }
+        Out << "],\"process\":{";
+        {
+            std::lock_guard<std::mutex> Lock(m_GaugeMutex);
+            const char * Separator = "";
+            for (const auto& Gauge : m_Gauges)
+            {
+                Out << Separator;
+                Quote(Out, Gauge.first);
+                Out << ':' << Gauge.second;
+                Separator = ",";
+            }
+        }
+        Out << "}}";
+        return Out.str();
+    }
+
+}
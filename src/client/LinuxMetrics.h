@@ -0,0 +1,190 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace EPRI
+{
+    //
+    // A latency histogram in the style of HdrHistogram: buckets are linear
+    // up to 16us and then split each power of two into 8, so any recorded
+    // value is known to within 12.5%.  Recording is a couple of relaxed
+    // atomic increments, so any thread may record without a lock.
+    //
+    class LinuxHistogram
+    {
+    public:
+        typedef std::chrono::steady_clock::duration Duration;
+
+        LinuxHistogram();
+
+        void Record(Duration Value);
+        uint64_t Count() const;
+        uint64_t Max() const;
+        uint64_t Mean() const;
+        //
+        // All values in microseconds.  Percentile is in the range 0..100.
+        //
+        uint64_t Percentile(double Percentile) const;
+
+    private:
+        static const unsigned LINEAR_BUCKETS = 16;
+        static const unsigned SUB_BUCKET_BITS = 3;
+        static const unsigned BUCKETS = LINEAR_BUCKETS + (64 - 4) * (1 << SUB_BUCKET_BITS);
+
+        static unsigned BucketOf(uint64_t Value);
+        static uint64_t UpperBoundOf(unsigned Bucket);
+
+        std::atomic<uint64_t> m_Buckets[BUCKETS];
+        std::atomic<uint64_t> m_Count;
+        std::atomic<uint64_t> m_Sum;
+        std::atomic<uint64_t> m_Max;
+
+    };
+    //
+    // Timing and outcome counters for meter transactions: one histogram per
+    // phase, counts of each outcome, and a summary per meter so that slow
+    // meters stand out.
+    //
+    class LinuxMetrics
+    {
+    public:
+        enum Phase
+        {
+            PHASE_CONNECT,
+            PHASE_ASSOCIATE,
+            PHASE_REQUEST,
+            PHASE_RELEASE,
+            PHASE_TOTAL,
+            PHASE_COUNT
+        };
+        enum Outcome
+        {
+            OUTCOME_SUCCESS,
+            OUTCOME_FAILURE,
+            OUTCOME_TIMEOUT,
+            OUTCOME_ABORT,
+            OUTCOME_COUNT
+        };
+        typedef LinuxHistogram::Duration Duration;
+
+        LinuxMetrics();
+
+        void Record(Phase Which, Duration Elapsed);
+        void Count(Outcome Which);
+        //
+        // Records one complete transaction with a meter, which also goes
+        // into the PHASE_TOTAL histogram.
+        //
+        void RecordMeter(const std::string& MeterURL, Duration Elapsed, bool Success);
+
+        //
+        // Sets a figure about the process as a whole rather than any one
+        // transaction, such as the bytes its allocator has live.
+        //
+        void SetGauge(const std::string& Name, uint64_t Value);
+
+        const LinuxHistogram& GetHistogram(Phase Which) const;
+        uint64_t GetCount(Outcome Which) const;
+        //
+        // Everything as a JSON object, including the SlowestMeters meters
+        // with the highest mean transaction time and the gauges.
+        //
+        std::string ToJSON(size_t SlowestMeters = 10) const;
+
+    private:
+        struct MeterSummary
+        {
+            uint64_t m_Transactions = 0;
+            uint64_t m_Failures = 0;
+            uint64_t m_TotalMicros = 0;
+            uint64_t m_LastMicros = 0;
+            uint64_t m_MaxMicros = 0;
+        };
+
+        LinuxHistogram        m_Histograms[PHASE_COUNT];
+        std::atomic<uint64_t> m_Outcomes[OUTCOME_COUNT];
+        mutable std::mutex    m_MeterMutex;
+        std::map<std::string, MeterSummary> m_Meters;
+        mutable std::mutex    m_GaugeMutex;
+        std::map<std::string, uint64_t> m_Gauges;
+
+    };
+
+}
@@ -0,0 +1,219 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include "LinuxRegistration.h"
+
+namespace EPRI
+{
+    namespace
+    {
+        void Put(std::vector<uint8_t> * pBuffer, uint32_t Value, size_t Bytes)
+        {
+            while (Bytes--)
+            {
+                pBuffer->push_back(uint8_t(Value >> (8 * Bytes)));
+            }
+        }
+
+        uint32_t Get(const uint8_t * pData, size_t Bytes)
+        {
+            uint32_t Value = 0;
+            while (Bytes--)
+            {
+                Value = (Value << 8) | *pData++;
+            }
+            return Value;
+        }
+    }
+
+    RegistrationMessage::RegistrationMessage(MessageType Type /*= SNAPSHOT*/, uint32_t Sequence /*= 0*/,
+        uint8_t Payload /*= 0*/) :
+        m_Type(Type), m_Sequence(Sequence), m_Payload(Payload)
+    {
+    }
+
+    void RegistrationMessage::Encode(std::vector<uint8_t> * pBuffer) const
+    {
+        const size_t Start = pBuffer->size();
+        Put(pBuffer, 0, 4);
+        pBuffer->push_back(m_Type);
+        Put(pBuffer, m_Sequence, 4);
+        pBuffer->push_back(m_Payload);
+        Put(pBuffer, uint32_t(m_Changes.size()), 4);
+        for (const Change& Item : m_Changes)
+        {
+            pBuffer->push_back(Item.first);
+            Put(pBuffer, uint32_t(Item.second.size()), 2);
+            pBuffer->insert(pBuffer->end(), Item.second.begin(), Item.second.end());
+        }
+        //
+        // Now that the length is known, fill it in.
+        //
+        const uint32_t Length = uint32_t(pBuffer->size() - Start - 4);
+        for (size_t Index = 0; Index < 4; ++Index)
+        {
+            (*pBuffer)[Start + Index] = uint8_t(Length >> (8 * (3 - Index)));
+        }
+    }
+
+    void RegistrationMessage::EncodeAck(uint32_t Sequence, std::vector<uint8_t> * pBuffer)
+    {
+        Put(pBuffer, Sequence, ACK_LENGTH);
+    }
+
+    uint32_t RegistrationMessage::DecodeAck(const uint8_t * pData)
+    {
+        return Get(pData, ACK_LENGTH);
+    }
+
+    RegistrationParser::RegistrationParser(MessageCallbackFunction Callback) :
+        m_Callback(Callback)
+    {
+    }
+
+    bool RegistrationParser::Parse(const uint8_t * pData, size_t Length)
+    {
+        m_Buffer.insert(m_Buffer.end(), pData, pData + Length);
+        size_t Consumed = 0;
+        while (m_Buffer.size() - Consumed >= 4)
+        {
+            const size_t FrameLength = Get(&m_Buffer[Consumed], 4);
+            if (FrameLength > RegistrationMessage::MAX_FRAME_LENGTH)
+            {
+                return false;
+            }
+            if (m_Buffer.size() - Consumed - 4 < FrameLength)
+            {
+                //
+                // Make room for the rest of the frame up front rather than
+                // growing the buffer piece by piece.
+                //
+                m_Buffer.reserve(Consumed + 4 + FrameLength);
+                break;
+            }
+            if (!Decode(&m_Buffer[Consumed + 4], FrameLength))
+            {
+                return false;
+            }
+            Consumed += 4 + FrameLength;
+        }
+        m_Buffer.erase(m_Buffer.begin(), m_Buffer.begin() + Consumed);
+        return true;
+    }
+
+    bool RegistrationParser::Decode(const uint8_t * pData, size_t Length)
+    {
+        const size_t HEADER_LENGTH = 1 + 4 + 1 + 4;
+        if (Length < HEADER_LENGTH || 
+            (RegistrationMessage::SNAPSHOT != pData[0] && RegistrationMessage::DELTA != pData[0]))
+        {
+            return false;
+        }
+        RegistrationMessage Message(RegistrationMessage::MessageType(pData[0]), Get(pData + 1, 4), pData[5]);
+        const uint32_t Count = Get(pData + 6, 4);
+        const uint8_t * pEnd = pData + Length;
+        pData += HEADER_LENGTH;
+        //
+        // Every change takes at least three bytes, which bounds the count
+        // before anything is reserved for it.
+        //
+        if (Count > size_t(pEnd - pData) / 3)
+        {
+            return false;
+        }
+        Message.m_Changes.reserve(Count);
+        for (uint32_t Index = 0; Index < Count; ++Index)
+        {
+            if (pEnd - pData < 3 ||
+                (RegistrationMessage::ADD != pData[0] && RegistrationMessage::REMOVE != pData[0]))
+            {
+                return false;
+            }
+            const RegistrationMessage::Operation Op = RegistrationMessage::Operation(pData[0]);
+            const size_t AddressLength = Get(pData + 1, 2);
+            pData += 3;
+            if (size_t(pEnd - pData) < AddressLength)
+            {
+                return false;
+            }
+            Message.m_Changes.emplace_back(Op, std::string(reinterpret_cast<const char *>(pData), AddressLength));
+            pData += AddressLength;
+        }
+        if (pData != pEnd)
+        {
+            return false;
+        }
+        m_Callback(Message);
+        return true;
+    }
+
+}
@@ -0,0 +1,158 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EPRI
+{
+    //
+    // The registration protocol the HES uses to tell an Access Point which
+    // meters to read.  Every message is a length-prefixed frame:
+    //
+    //   uint32 length of the rest of the frame
+    //   uint8  type (SNAPSHOT or DELTA)
+    //   uint32 sequence number
+    //   uint8  payload size to read (0 small, 1 medium, 2 large)
+    //   uint32 number of changes, then for each change:
+    //     uint8  operation (ADD or REMOVE)
+    //     uint16 length of the meter address, then the address itself
+    //
+    // All integers are big-endian.  A SNAPSHOT replaces the whole meter list
+    // and only contains ADDs.  A DELTA is only applied on top of the message
+    // with the previous sequence number.  After each frame the Access Point
+    // answers with its uint32 sequence number if it was applied, or with 0
+    // if it was not, so the HES can tell when it has to fall back to a
+    // snapshot.  Sequence number 0 is therefore never used for a message.
+    //
+    class RegistrationMessage
+    {
+    public:
+        enum MessageType : uint8_t
+        {
+            SNAPSHOT = 'S',
+            DELTA = 'D'
+        };
+        enum Operation : uint8_t
+        {
+            ADD = '+',
+            REMOVE = '-'
+        };
+        typedef std::pair<Operation, std::string> Change;
+
+        static const size_t MAX_FRAME_LENGTH = 16 * 1024 * 1024;
+        static const size_t ACK_LENGTH = 4;
+
+        RegistrationMessage(MessageType Type = SNAPSHOT, uint32_t Sequence = 0, uint8_t Payload = 0);
+        //
+        // Appends the framed message to the buffer.
+        //
+        void Encode(std::vector<uint8_t> * pBuffer) const;
+        static void EncodeAck(uint32_t Sequence, std::vector<uint8_t> * pBuffer);
+        static uint32_t DecodeAck(const uint8_t * pData);
+
+        MessageType         m_Type;
+        uint32_t            m_Sequence;
+        uint8_t             m_Payload;
+        std::vector<Change> m_Changes;
+
+    };
+    //
+    // Incremental decoder: bytes may be fed in pieces of any size, and each
+    // message is handed over as soon as its frame is complete.
+    //
+    class RegistrationParser
+    {
+    public:
+        typedef std::function<void(const RegistrationMessage&)> MessageCallbackFunction;
+
+        RegistrationParser(MessageCallbackFunction Callback);
+        //
+        // Returns false if the stream is malformed; nothing further should
+        // be fed once that has happened.
+        //
+        bool Parse(const uint8_t * pData, size_t Length);
+
+    private:
+        bool Decode(const uint8_t * pData, size_t Length);
+
+        MessageCallbackFunction m_Callback;
+        std::vector<uint8_t>    m_Buffer;
+
+    };
+
+}
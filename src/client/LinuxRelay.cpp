@@ -0,0 +1,929 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include "LinuxRelay.h"
+#include "IBaseLibrary.h"
+
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace EPRI
+{
+    //
+    // IP6T_SO_ORIGINAL_DST, from <linux/netfilter_ipv6/ip6_tables.h>
+    //
+    static const int RELAY_ORIGINAL_DST = 80;
+
+    const size_t   RelayFrame::HEADER_SIZE;
+    const uint8_t  RelayFrame::AARE;
+    const uint8_t  RelayFrame::RLRE;
+    const uint8_t  RelayFrame::GET_REQUEST;
+    const uint8_t  RelayFrame::SET_REQUEST;
+    const uint8_t  RelayFrame::ACTION_REQUEST;
+    const uint8_t  RelayFrame::GET_RESPONSE;
+    const uint8_t  RelayFrame::SET_RESPONSE;
+    const uint8_t  RelayFrame::ACTION_RESPONSE;
+    const uint8_t  RelayFrame::NORMAL;
+    const uint16_t LinuxRelay::DEFAULT_PORT;
+
+    static uint16_t GetField(const std::vector<uint8_t>& Frame, size_t Offset)
+    {
+        return uint16_t((Frame[Offset] << 8) | Frame[Offset + 1]);
+    }
+
+    //
+    // Reads a BER length at *pPos and moves past it.
+    //
+    static bool GetLength(const std::vector<uint8_t>& Frame, size_t * pPos, size_t * pLength)
+    {
+        if (*pPos >= Frame.size())
+        {
+            return false;
+        }
+        size_t Length = Frame[(*pPos)++];
+        if (Length & 0x80)
+        {
+            size_t Bytes = Length & 0x7F;
+            if (Bytes > sizeof(size_t) || *pPos + Bytes > Frame.size())
+            {
+                return false;
+            }
+            for (Length = 0; Bytes > 0; --Bytes)
+            {
+                Length = (Length << 8) | Frame[(*pPos)++];
+            }
+        }
+        *pLength = Length;
+        return true;
+    }
+
+    uint16_t RelayFrame::Source(const std::vector<uint8_t>& Frame)
+    {
+        return GetField(Frame, 2);
+    }
+
+    uint16_t RelayFrame::Destination(const std::vector<uint8_t>& Frame)
+    {
+        return GetField(Frame, 4);
+    }
+
+    uint16_t RelayFrame::Length(const std::vector<uint8_t>& Frame)
+    {
+        return GetField(Frame, 6);
+    }
+
+    uint8_t RelayFrame::Tag(const std::vector<uint8_t>& Frame)
+    {
+        return Frame.size() > HEADER_SIZE ? Frame[HEADER_SIZE] : 0;
+    }
+
+    bool RelayFrame::IsAccepted(const std::vector<uint8_t>& Frame)
+    {
+        size_t Pos = HEADER_SIZE + 1;
+        size_t Length;
+        if (Tag(Frame) != AARE || !GetLength(Frame, &Pos, &Length))
+        {
+            return false;
+        }
+        //
+        // The components are BER encoded; the result is an INTEGER in the
+        // context-specific [2] component, 0 for accepted.
+        //
+        while (Pos < Frame.size())
+        {
+            const uint8_t Component = Frame[Pos++];
+            if (!GetLength(Frame, &Pos, &Length) || Pos + Length > Frame.size())
+            {
+                return false;
+            }
+            if (Component == 0xA2)
+            {
+                return Length == 3 && Frame[Pos] == 0x02 && Frame[Pos + 1] == 0x01 && Frame[Pos + 2] == 0x00;
+            }
+            Pos += Length;
+        }
+        return false;
+    }
+
+    uint8_t RelayFrame::Choice(const std::vector<uint8_t>& Frame)
+    {
+        return Frame.size() > HEADER_SIZE + 2 ? Frame[HEADER_SIZE + 1] : 0;
+    }
+
+    uint8_t RelayFrame::InvokeID(const std::vector<uint8_t>& Frame)
+    {
+        return Frame.size() > HEADER_SIZE + 2 ? Frame[HEADER_SIZE + 2] & 0x0F : 0;
+    }
+
+    bool RelayFrame::GetDescriptor(const std::vector<uint8_t>& Frame, Descriptor * pDescriptor)
+    {
+        //
+        // tag, choice, invoke-id, class-id (2), instance-id (6), attribute
+        // or method id
+        //
+        const size_t Start = HEADER_SIZE + 3;
+        if (Frame.size() < Start + 9)
+        {
+            return false;
+        }
+        char OBIS[32];
+        std::snprintf(OBIS, sizeof(OBIS), "%u-%u:%u.%u.%u*%u",
+            unsigned(Frame[Start + 2]), unsigned(Frame[Start + 3]), unsigned(Frame[Start + 4]),
+            unsigned(Frame[Start + 5]), unsigned(Frame[Start + 6]), unsigned(Frame[Start + 7]));
+        pDescriptor->m_ClassID = GetField(Frame, Start);
+        pDescriptor->m_OBIS = OBIS;
+        pDescriptor->m_ID = Frame[Start + 8];
+        return true;
+    }
+
+    RelayFrame::Buffer RelayFrame::Reply(const std::vector<uint8_t>& Request, const std::vector<uint8_t>& APDU)
+    {
+        Buffer pFrame = std::make_shared<std::vector<uint8_t>>(Request.begin(), Request.begin() + 2);
+        pFrame->push_back(Request[4]);
+        pFrame->push_back(Request[5]);
+        pFrame->push_back(Request[2]);
+        pFrame->push_back(Request[3]);
+        pFrame->push_back(uint8_t(APDU.size() >> 8));
+        pFrame->push_back(uint8_t(APDU.size()));
+        pFrame->insert(pFrame->end(), APDU.begin(), APDU.end());
+        return pFrame;
+    }
+
+    LinuxRelayStream::LinuxRelayStream(asio::ip::tcp::socket Socket) :
+        m_Socket(std::move(Socket))
+    {
+    }
+
+    LinuxRelayStream::~LinuxRelayStream()
+    {
+    }
+
+    asio::ip::tcp::socket& LinuxRelayStream::Socket()
+    {
+        return m_Socket;
+    }
+
+    void LinuxRelayStream::Start(ReceivedFunction Received, ClosedFunction Closed)
+    {
+        m_Received = Received;
+        m_Closed = Closed;
+        ReadHeader();
+    }
+
+    void LinuxRelayStream::Send(RelayFrame::Buffer pFrame)
+    {
+        m_Outbox.push_back(pFrame);
+        if (m_Outbox.size() == 1)
+        {
+            Write();
+        }
+    }
+
+    void LinuxRelayStream::Close()
+    {
+        asio::error_code Ignored;
+        m_Received = nullptr;
+        m_Closed = nullptr;
+        m_Socket.shutdown(asio::ip::tcp::socket::shutdown_both, Ignored);
+        m_Socket.close(Ignored);
+    }
+
+    void LinuxRelayStream::ReadHeader()
+    {
+        std::shared_ptr<LinuxRelayStream> Self = shared_from_this();
+        RelayFrame::Buffer pFrame = std::make_shared<std::vector<uint8_t>>(RelayFrame::HEADER_SIZE);
+        asio::async_read(m_Socket, asio::buffer(*pFrame),
+            [this, Self, pFrame](const asio::error_code& Error, size_t)
+            {
+                if (Error)
+                {
+                    Fail();
+                    return;
+                }
+                pFrame->resize(RelayFrame::HEADER_SIZE + RelayFrame::Length(*pFrame));
+                asio::async_read(m_Socket,
+                    asio::buffer(pFrame->data() + RelayFrame::HEADER_SIZE, pFrame->size() - RelayFrame::HEADER_SIZE),
+                    [this, Self, pFrame](const asio::error_code& Error, size_t)
+                    {
+                        if (Error)
+                        {
+                            Fail();
+                            return;
+                        }
+                        //
+                        // The handler may close this stream.
+                        //
+                        ReceivedFunction Received = m_Received;
+                        if (Received)
+                        {
+                            Received(pFrame);
+                        }
+                        if (m_Received)
+                        {
+                            ReadHeader();
+                        }
+                    });
+            });
+    }
+
+    void LinuxRelayStream::Write()
+    {
+        std::shared_ptr<LinuxRelayStream> Self = shared_from_this();
+        asio::async_write(m_Socket, asio::buffer(*m_Outbox.front()),
+            [this, Self](const asio::error_code& Error, size_t)
+            {
+                if (Error)
+                {
+                    Fail();
+                    return;
+                }
+                m_Outbox.pop_front();
+                if (!m_Outbox.empty())
+                {
+                    Write();
+                }
+            });
+    }
+
+    void LinuxRelayStream::Fail()
+    {
+        ClosedFunction Closed = m_Closed;
+        m_Outbox.clear();
+        Close();
+        if (Closed)
+        {
+            Closed();
+        }
+    }
+
+    LinuxMeterLink::LinuxMeterLink(asio::io_service& IO, const asio::ip::tcp::endpoint& Meter) :
+        m_Meter(Meter),
+        m_pStream(std::make_shared<LinuxRelayStream>(asio::ip::tcp::socket(IO))),
+        m_LastUsed(Clock::now())
+    {
+    }
+
+    LinuxMeterLink::~LinuxMeterLink()
+    {
+    }
+
+    void LinuxMeterLink::Connect()
+    {
+        std::shared_ptr<LinuxMeterLink> Self = shared_from_this();
+        m_pStream->Socket().async_connect(m_Meter,
+            [this, Self](const asio::error_code& Error)
+            {
+                if (!m_Open)
+                {
+                    return;
+                }
+                if (Error)
+                {
+                    Base()->GetDebug()->TRACE("Relay connect to %s failed: %s\n",
+                        m_Meter.address().to_string().c_str(), Error.message().c_str());
+                    Close();
+                    return;
+                }
+                m_Connected = true;
+                m_pStream->Start(
+                    [this, Self](RelayFrame::Buffer pFrame)
+                    {
+                        Deliver(pFrame);
+                    },
+                    [this, Self]()
+                    {
+                        Close();
+                    });
+                for (RelayFrame::Buffer& pFrame : m_Waiting)
+                {
+                    m_pStream->Send(pFrame);
+                }
+                m_Waiting.clear();
+            });
+    }
+
+    const asio::ip::tcp::endpoint& LinuxMeterLink::Meter() const
+    {
+        return m_Meter;
+    }
+
+    bool LinuxMeterLink::Accepts(uint16_t WPort) const
+    {
+        return m_Open && !m_Retired && m_Sessions.find(WPort) == m_Sessions.end();
+    }
+
+    void LinuxMeterLink::Attach(uint16_t WPort, const std::shared_ptr<LinuxRelaySession>& pSession)
+    {
+        m_Sessions[WPort] = pSession;
+    }
+
+    void LinuxMeterLink::Detach(uint16_t WPort, bool Associated)
+    {
+        m_Sessions.erase(WPort);
+        m_LastUsed = Clock::now();
+        m_Retired = m_Retired || Associated;
+        if (m_Retired && m_Sessions.empty())
+        {
+            Close();
+        }
+    }
+
+    bool LinuxMeterLink::Send(RelayFrame::Buffer pFrame)
+    {
+        if (!m_Open)
+        {
+            return false;
+        }
+        m_LastUsed = Clock::now();
+        if (m_Connected)
+        {
+            m_pStream->Send(pFrame);
+        }
+        else
+        {
+            m_Waiting.push_back(pFrame);
+        }
+        return true;
+    }
+
+    bool LinuxMeterLink::IsOpen() const
+    {
+        return m_Open;
+    }
+
+    bool LinuxMeterLink::IsIdleSince(Clock::time_point When) const
+    {
+        return m_Sessions.empty() && m_LastUsed < When;
+    }
+
+    void LinuxMeterLink::Close()
+    {
+        if (!m_Open)
+        {
+            return;
+        }
+        m_Open = false;
+        m_pStream->Close();
+        m_Waiting.clear();
+        std::map<uint16_t, std::weak_ptr<LinuxRelaySession>> Sessions;
+        Sessions.swap(m_Sessions);
+        for (std::map<uint16_t, std::weak_ptr<LinuxRelaySession>>::value_type& Current : Sessions)
+        {
+            std::shared_ptr<LinuxRelaySession> pSession = Current.second.lock();
+            if (pSession)
+            {
+                pSession->Close();
+            }
+        }
+    }
+
+    void LinuxMeterLink::Deliver(RelayFrame::Buffer pFrame)
+    {
+        m_LastUsed = Clock::now();
+        std::map<uint16_t, std::weak_ptr<LinuxRelaySession>>::iterator it =
+            m_Sessions.find(RelayFrame::Destination(*pFrame));
+        if (it != m_Sessions.end())
+        {
+            std::shared_ptr<LinuxRelaySession> pSession = it->second.lock();
+            if (pSession)
+            {
+                pSession->Deliver(pFrame);
+            }
+        }
+    }
+
+    LinuxRelaySession::LinuxRelaySession(asio::ip::tcp::socket Socket, const asio::ip::tcp::endpoint& Meter,
+        LinuxRelay& Relay) :
+        m_pStream(std::make_shared<LinuxRelayStream>(std::move(Socket))),
+        m_Meter(Meter),
+        m_Relay(Relay),
+        m_pCache(Relay.GetCache()),
+        m_MeterURL(Meter.address().to_string())
+    {
+    }
+
+    LinuxRelaySession::~LinuxRelaySession()
+    {
+    }
+
+    void LinuxRelaySession::Start()
+    {
+        std::shared_ptr<LinuxRelaySession> Self = shared_from_this();
+        m_pStream->Start(
+            [this, Self](RelayFrame::Buffer pFrame)
+            {
+                Forward(pFrame);
+            },
+            [this, Self]()
+            {
+                Close();
+            });
+    }
+
+    void LinuxRelaySession::Deliver(RelayFrame::Buffer pFrame)
+    {
+        Observe(pFrame);
+        switch (RelayFrame::Tag(*pFrame))
+        {
+        case RelayFrame::AARE:
+            m_Associated = RelayFrame::IsAccepted(*pFrame);
+            break;
+        case RelayFrame::RLRE:
+            m_Associated = false;
+            break;
+        }
+        m_pStream->Send(pFrame);
+    }
+
+    void LinuxRelaySession::Close()
+    {
+        if (m_Closed)
+        {
+            return;
+        }
+        m_Closed = true;
+        m_pStream->Close();
+        if (m_pLink)
+        {
+            m_pLink->Detach(m_WPort, m_Associated);
+            m_pLink.reset();
+        }
+        //
+        // Whoever waits on a read of ours has to make its own.
+        //
+        std::map<uint8_t, RelayFrame::Descriptor> Gets;
+        Gets.swap(m_Gets);
+        for (std::map<uint8_t, RelayFrame::Descriptor>::value_type& Current : Gets)
+        {
+            Complete(Current.second, nullptr);
+        }
+    }
+
+    void LinuxRelaySession::Forward(RelayFrame::Buffer pFrame)
+    {
+        if (Intercept(pFrame))
+        {
+            return;
+        }
+        if (!m_pLink)
+        {
+            m_WPort = RelayFrame::Source(*pFrame);
+            m_pLink = m_Relay.Acquire(m_Meter, m_WPort);
+            m_pLink->Attach(m_WPort, shared_from_this());
+        }
+        if (!m_pLink->Send(pFrame))
+        {
+            //
+            // The meter connection went away, and with it whatever the HES
+            // had going on it; let the HES see that rather than wait for a
+            // reply which will never come.
+            //
+            Close();
+        }
+    }
+
+    bool LinuxRelaySession::Intercept(const RelayFrame::Buffer& pFrame)
+    {
+        const uint8_t          Tag = RelayFrame::Tag(*pFrame);
+        const uint8_t          Choice = RelayFrame::Choice(*pFrame);
+        RelayFrame::Descriptor Object;
+        switch (Tag)
+        {
+        case RelayFrame::GET_REQUEST:
+            //
+            // Only a plain read of the whole attribute, without selective
+            // access.
+            //
+            if (Choice == RelayFrame::NORMAL && RelayFrame::GetDescriptor(*pFrame, &Object) &&
+                pFrame->size() == RelayFrame::HEADER_SIZE + 13 && pFrame->back() == 0)
+            {
+                //
+                // Only for a client the meter has let in, and only what
+                // was read under the same client SAP, as what a client may
+                // read depends on its association.
+                //
+                std::string Value;
+                if (m_pCache && m_Associated &&
+                    m_pCache->Find(m_MeterURL, m_WPort, Object.m_ClassID, Object.m_OBIS, Object.m_ID, &Value))
+                {
+                    std::vector<uint8_t> APDU;
+                    APDU.push_back(RelayFrame::GET_RESPONSE);
+                    APDU.push_back(RelayFrame::NORMAL);
+                    APDU.push_back((*pFrame)[RelayFrame::HEADER_SIZE + 2]);
+                    APDU.insert(APDU.end(), Value.begin(), Value.end());
+                    m_pStream->Send(RelayFrame::Reply(*pFrame, APDU));
+                    return true;
+                }
+                //
+                // A read under an invoke-id which is still in flight means
+                // the HES gave up on the earlier one, whose response may
+                // yet arrive.  As the two cannot be told apart, neither is
+                // tracked any further, and whoever waits on the earlier
+                // read makes its own.
+                //
+                std::map<uint8_t, RelayFrame::Descriptor>::iterator it =
+                    m_Gets.find(RelayFrame::InvokeID(*pFrame));
+                if (it != m_Gets.end())
+                {
+                    RelayFrame::Descriptor Earlier = it->second;
+                    m_Gets.erase(it);
+                    Complete(Earlier, nullptr);
+                    break;
+                }
+                //
+                // Reads are only shared between associations the meter
+                // accepted for the same client SAP.
+                //
+                if (!m_Associated)
+                {
+                    break;
+                }
+                if (m_Relay.Join(
+                    LinuxRelay::ReadKey(m_MeterURL, m_WPort, Object.m_ClassID, Object.m_OBIS, Object.m_ID),
+                    shared_from_this(), pFrame))
+                {
+                    return true;
+                }
+                m_Gets[RelayFrame::InvokeID(*pFrame)] = Object;
+            }
+            break;
+        case RelayFrame::SET_REQUEST:
+        case RelayFrame::ACTION_REQUEST:
+            if (!m_pCache)
+            {
+                break;
+            }
+            //
+            // SET choices 1 and 2 and ACTION choices 1 and 4 name a single
+            // object, while SET choices 4 and 5 and ACTION choices 3 and 5
+            // carry a list.  The rest continue a request already seen.
+            //
+            if (Tag == RelayFrame::SET_REQUEST ? (Choice == 1 || Choice == 2) : (Choice == 1 || Choice == 4))
+            {
+                if (!RelayFrame::GetDescriptor(*pFrame, &Object))
+                {
+                    break;
+                }
+            }
+            else if (Tag == RelayFrame::SET_REQUEST ? (Choice == 4 || Choice == 5) : (Choice == 3 || Choice == 5))
+            {
+                Object.m_ClassID = 0;
+                Object.m_ID = 0;
+            }
+            else
+            {
+                break;
+            }
+            Invalidate(Object);
+            m_Updates[RelayFrame::InvokeID(*pFrame)] = Object;
+            break;
+        }
+        return false;
+    }
+
+    void LinuxRelaySession::Observe(const RelayFrame::Buffer& pFrame)
+    {
+        const uint8_t Tag = RelayFrame::Tag(*pFrame);
+        const uint8_t Choice = RelayFrame::Choice(*pFrame);
+        std::map<uint8_t, RelayFrame::Descriptor>::iterator it;
+        switch (Tag)
+        {
+        case RelayFrame::GET_RESPONSE:
+            it = m_Gets.find(RelayFrame::InvokeID(*pFrame));
+            if (it == m_Gets.end())
+            {
+                break;
+            }
+            //
+            // Only data, not a data-access-result or the first of several
+            // blocks.
+            //
+            if (m_pCache && m_Associated && Choice == RelayFrame::NORMAL &&
+                pFrame->size() > RelayFrame::HEADER_SIZE + 4 && (*pFrame)[RelayFrame::HEADER_SIZE + 3] == 0)
+            {
+                m_pCache->Store(m_MeterURL, m_WPort, it->second.m_ClassID, it->second.m_OBIS, it->second.m_ID,
+                    std::string(pFrame->begin() + RelayFrame::HEADER_SIZE + 3, pFrame->end()));
+            }
+            {
+                //
+                // The others can share a complete response, but not the
+                // first block of a long one.
+                //
+                RelayFrame::Descriptor Attribute = it->second;
+                m_Gets.erase(it);
+                Complete(Attribute, Choice == RelayFrame::NORMAL ? pFrame : nullptr);
+            }
+            break;
+        case RelayFrame::SET_RESPONSE:
+        case RelayFrame::ACTION_RESPONSE:
+            if (!m_pCache)
+            {
+                break;
+            }
+            it = m_Updates.find(RelayFrame::InvokeID(*pFrame));
+            if (it == m_Updates.end())
+            {
+                break;
+            }
+            Invalidate(it->second);
+            //
+            // The meter acknowledges each block of a long request (SET
+            // choice 2, ACTION choice 4); the request is only done with
+            // its final response.
+            //
+            if (Choice != (Tag == RelayFrame::SET_RESPONSE ? 2 : 4))
+            {
+                m_Updates.erase(it);
+            }
+            break;
+        }
+    }
+
+    void LinuxRelaySession::Release(const RelayFrame::Buffer& pRequest, const RelayFrame::Buffer& pResponse)
+    {
+        if (m_Closed)
+        {
+            return;
+        }
+        if (!pResponse)
+        {
+            Forward(pRequest);
+            return;
+        }
+        std::vector<uint8_t> APDU(pResponse->begin() + RelayFrame::HEADER_SIZE, pResponse->end());
+        APDU[2] = (*pRequest)[RelayFrame::HEADER_SIZE + 2];
+        m_pStream->Send(RelayFrame::Reply(*pRequest, APDU));
+    }
+
+    void LinuxRelaySession::Complete(const RelayFrame::Descriptor& Attribute, const RelayFrame::Buffer& pResponse)
+    {
+        std::vector<LinuxRelay::Waiter> Waiters =
+            m_Relay.Finish(LinuxRelay::ReadKey(m_MeterURL, m_WPort, Attribute.m_ClassID, Attribute.m_OBIS,
+                Attribute.m_ID));
+        for (LinuxRelay::Waiter& Current : Waiters)
+        {
+            std::shared_ptr<LinuxRelaySession> pSession = Current.m_pSession.lock();
+            if (pSession)
+            {
+                pSession->Release(Current.m_pRequest, pResponse);
+            }
+        }
+    }
+
+    void LinuxRelaySession::Invalidate(const RelayFrame::Descriptor& Object)
+    {
+        if (Object.m_OBIS.empty())
+        {
+            m_pCache->Clear();
+        }
+        else
+        {
+            m_pCache->Invalidate(m_MeterURL, Object.m_ClassID, Object.m_OBIS);
+        }
+    }
+
+    LinuxRelay::LinuxRelay(asio::io_service& IO, const Options& Opt /*= Options()*/) :
+        m_IO(IO),
+        m_Acceptor(IO, asio::ip::tcp::endpoint(asio::ip::tcp::v6(), Opt.m_Port)),
+        m_Socket(IO),
+        m_SweepTimer(IO),
+        m_Options(Opt)
+    {
+        Accept();
+        Sweep();
+    }
+
+    LinuxRelay::~LinuxRelay()
+    {
+        asio::error_code Ignored;
+        m_Acceptor.close(Ignored);
+        m_SweepTimer.cancel(Ignored);
+        //
+        // Nobody is left to wait on a read, so closing the sessions below
+        // does not send any more requests.
+        //
+        m_Reads.clear();
+        for (LinkMap::value_type& Current : m_Links)
+        {
+            Current.second->Close();
+        }
+    }
+
+    uint16_t LinuxRelay::GetPort() const
+    {
+        return m_Acceptor.local_endpoint().port();
+    }
+
+    LinuxAttributeCache * LinuxRelay::GetCache() const
+    {
+        return m_Options.m_pCache;
+    }
+
+    std::shared_ptr<LinuxMeterLink> LinuxRelay::Acquire(const asio::ip::tcp::endpoint& Meter, uint16_t WPort)
+    {
+        std::pair<LinkMap::iterator, LinkMap::iterator> Range = m_Links.equal_range(Meter);
+        for (LinkMap::iterator it = Range.first; it != Range.second; ++it)
+        {
+            if (it->second->Accepts(WPort))
+            {
+                return it->second;
+            }
+        }
+        std::shared_ptr<LinuxMeterLink> pLink = std::make_shared<LinuxMeterLink>(m_IO, Meter);
+        m_Links.insert(std::make_pair(Meter, pLink));
+        pLink->Connect();
+        return pLink;
+    }
+
+    bool LinuxRelay::Join(const ReadKey& Key, const std::shared_ptr<LinuxRelaySession>& pSession,
+        const RelayFrame::Buffer& pRequest)
+    {
+        std::map<ReadKey, std::vector<Waiter>>::iterator it = m_Reads.find(Key);
+        if (it == m_Reads.end())
+        {
+            m_Reads[Key];
+            return false;
+        }
+        Waiter Current;
+        Current.m_pSession = pSession;
+        Current.m_pRequest = pRequest;
+        it->second.push_back(Current);
+        ++m_Coalesced;
+        return true;
+    }
+
+    std::vector<LinuxRelay::Waiter> LinuxRelay::Finish(const ReadKey& Key)
+    {
+        std::vector<Waiter> Waiters;
+        std::map<ReadKey, std::vector<Waiter>>::iterator it = m_Reads.find(Key);
+        if (it != m_Reads.end())
+        {
+            Waiters.swap(it->second);
+            m_Reads.erase(it);
+        }
+        return Waiters;
+    }
+
+    uint64_t LinuxRelay::GetCoalesced() const
+    {
+        return m_Coalesced;
+    }
+
+    bool LinuxRelay::Destination(asio::ip::tcp::socket& Socket, asio::ip::tcp::endpoint * pMeter) const
+    {
+        sockaddr_in6 Address;
+        socklen_t    Length = sizeof(Address);
+        std::memset(&Address, 0, sizeof(Address));
+        if (getsockopt(Socket.native_handle(), SOL_IPV6, RELAY_ORIGINAL_DST, &Address, &Length) == 0)
+        {
+            std::memcpy(pMeter->data(), &Address, sizeof(Address));
+            asio::error_code Ignored;
+            //
+            // A connection made straight to the relay was not redirected.
+            //
+            if (*pMeter != Socket.local_endpoint(Ignored))
+            {
+                return true;
+            }
+        }
+        if (m_Options.m_Meter.port() != 0)
+        {
+            *pMeter = m_Options.m_Meter;
+            return true;
+        }
+        return false;
+    }
+
+    void LinuxRelay::Accept()
+    {
+        m_Acceptor.async_accept(m_Socket,
+            std::bind(&LinuxRelay::ASIO_Accept_Handler, this, std::placeholders::_1));
+    }
+
+    void LinuxRelay::ASIO_Accept_Handler(const asio::error_code& Error)
+    {
+        if (Error == asio::error::operation_aborted)
+        {
+            return;
+        }
+        if (!Error)
+        {
+            asio::ip::tcp::endpoint Meter;
+            if (Destination(m_Socket, &Meter))
+            {
+                std::make_shared<LinuxRelaySession>(std::move(m_Socket), Meter, *this)->Start();
+            }
+            else
+            {
+                Base()->GetDebug()->TRACE("Relay connection without a destination\n");
+                asio::error_code Ignored;
+                m_Socket.close(Ignored);
+            }
+        }
+        Accept();
+    }
+
+    void LinuxRelay::Sweep()
+    {
+        m_SweepTimer.expires_from_now(std::chrono::milliseconds(m_Options.m_IdleTimeOutInMS / 2));
+        m_SweepTimer.async_wait(std::bind(&LinuxRelay::ASIO_Sweep_Handler, this, std::placeholders::_1));
+    }
+
+    void LinuxRelay::ASIO_Sweep_Handler(const asio::error_code& Error)
+    {
+        if (Error)
+        {
+            return;
+        }
+        const LinuxMeterLink::Clock::time_point Cutoff = LinuxMeterLink::Clock::now() -
+            std::chrono::milliseconds(m_Options.m_IdleTimeOutInMS);
+        for (LinkMap::iterator it = m_Links.begin(); it != m_Links.end(); )
+        {
+            if (it->second->IsIdleSince(Cutoff))
+            {
+                it->second->Close();
+            }
+            if (it->second->IsOpen())
+            {
+                ++it;
+            }
+            else
+            {
+                it = m_Links.erase(it);
+            }
+        }
+        Sweep();
+    }
+
+}
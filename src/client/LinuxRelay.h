@@ -0,0 +1,420 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "LinuxAttributeCache.h"
+
+namespace EPRI
+{
+    //
+    // One DLMS/COSEM wrapper frame (IEC 62056-47): version, source wPort,
+    // destination wPort and APDU length, each 16 bits big-endian, and then
+    // the APDU.  The relay never re-encodes a frame it passes on; the
+    // buffer read from one side is the buffer written to the other.  It
+    // only looks far enough into GET, SET and ACTION APDUs to find the
+    // attribute or object they are for.
+    //
+    class RelayFrame
+    {
+    public:
+        typedef std::shared_ptr<std::vector<uint8_t>> Buffer;
+
+        static const size_t  HEADER_SIZE = 8;
+        static const uint8_t AARE = 0x61;
+        static const uint8_t RLRE = 0x63;
+        static const uint8_t GET_REQUEST = 0xC0;
+        static const uint8_t SET_REQUEST = 0xC1;
+        static const uint8_t ACTION_REQUEST = 0xC3;
+        static const uint8_t GET_RESPONSE = 0xC4;
+        static const uint8_t SET_RESPONSE = 0xC5;
+        static const uint8_t ACTION_RESPONSE = 0xC7;
+        static const uint8_t NORMAL = 0x01;
+
+        struct Descriptor
+        {
+            uint16_t    m_ClassID;
+            std::string m_OBIS;
+            uint8_t     m_ID;
+        };
+
+        static uint16_t Source(const std::vector<uint8_t>& Frame);
+        static uint16_t Destination(const std::vector<uint8_t>& Frame);
+        static uint16_t Length(const std::vector<uint8_t>& Frame);
+        //
+        // The first byte of the APDU, or 0 for an empty one.
+        //
+        static uint8_t Tag(const std::vector<uint8_t>& Frame);
+        //
+        // Whether an AARE accepts the association.
+        //
+        static bool IsAccepted(const std::vector<uint8_t>& Frame);
+        //
+        // The choice and the invoke-id of an xDLMS request or response,
+        // or 0 for an APDU too short to carry one.
+        //
+        static uint8_t Choice(const std::vector<uint8_t>& Frame);
+        static uint8_t InvokeID(const std::vector<uint8_t>& Frame);
+        //
+        // Fills in *pDescriptor from the descriptor following the
+        // invoke-id, with the OBIS code in the a-b:c.d.e*f form.
+        //
+        static bool GetDescriptor(const std::vector<uint8_t>& Frame, Descriptor * pDescriptor);
+        //
+        // A frame in answer to Request, from its destination back to its
+        // source, carrying APDU.
+        //
+        static Buffer Reply(const std::vector<uint8_t>& Request, const std::vector<uint8_t>& APDU);
+
+    };
+    //
+    // Reads wrapper frames from a socket one at a time and writes queued
+    // frames to it in order.  Shared by both sides of the relay.  Every
+    // pending operation holds the stream, so it outlives its handlers even
+    // after its owner lets go of it.
+    //
+    // Instances must be owned by a std::shared_ptr.
+    //
+    class LinuxRelayStream : public std::enable_shared_from_this<LinuxRelayStream>
+    {
+    public:
+        typedef std::function<void(RelayFrame::Buffer)> ReceivedFunction;
+        typedef std::function<void()>                   ClosedFunction;
+
+        LinuxRelayStream(asio::ip::tcp::socket Socket);
+        virtual ~LinuxRelayStream();
+
+        asio::ip::tcp::socket& Socket();
+        //
+        // Reads frames until the socket fails or is closed.  Closed is
+        // called exactly once, and not after Close().
+        //
+        void Start(ReceivedFunction Received, ClosedFunction Closed);
+        void Send(RelayFrame::Buffer pFrame);
+        void Close();
+
+    private:
+        void ReadHeader();
+        void Write();
+        //
+        // Drops the callbacks, and with them the owner they keep alive.
+        //
+        void Fail();
+
+        asio::ip::tcp::socket          m_Socket;
+        ReceivedFunction               m_Received;
+        ClosedFunction                 m_Closed;
+        std::deque<RelayFrame::Buffer> m_Outbox;
+
+    };
+
+    class LinuxRelaySession;
+    //
+    // One pooled TCP connection from the AP to a meter.  Several HES
+    // associations may share it as long as each uses its own client wPort,
+    // which is how the wrapper tells associations apart; the meter's
+    // replies go back by their destination wPort.
+    //
+    // Instances must be owned by a std::shared_ptr.
+    //
+    class LinuxMeterLink : public std::enable_shared_from_this<LinuxMeterLink>
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        LinuxMeterLink(asio::io_service& IO, const asio::ip::tcp::endpoint& Meter);
+        virtual ~LinuxMeterLink();
+
+        void Connect();
+        const asio::ip::tcp::endpoint& Meter() const;
+        //
+        // Whether another association with this client wPort may join.
+        //
+        bool Accepts(uint16_t WPort) const;
+        void Attach(uint16_t WPort, const std::shared_ptr<LinuxRelaySession>& pSession);
+        //
+        // A session which leaves while still associated leaves a dangling
+        // association on the meter, so no one else joins this link and it
+        // is closed once its other sessions are done.
+        //
+        void Detach(uint16_t WPort, bool Associated);
+        //
+        // Queues the frame for the meter.  Returns false if the link is
+        // closed, in which case the sender's association is gone with it.
+        //
+        bool Send(RelayFrame::Buffer pFrame);
+        bool IsOpen() const;
+        bool IsIdleSince(Clock::time_point When) const;
+        //
+        // Closes every session still attached.
+        //
+        void Close();
+
+    private:
+        void Deliver(RelayFrame::Buffer pFrame);
+
+        asio::ip::tcp::endpoint                                 m_Meter;
+        std::shared_ptr<LinuxRelayStream>                       m_pStream;
+        bool                                                    m_Connected = false;
+        bool                                                    m_Open = true;
+        bool                                                    m_Retired = false;
+        Clock::time_point                                       m_LastUsed;
+        std::vector<RelayFrame::Buffer>                         m_Waiting;
+        std::map<uint16_t, std::weak_ptr<LinuxRelaySession>>    m_Sessions;
+
+    };
+
+    class LinuxRelay;
+    //
+    // One association from the HES.  Its first frame names the client
+    // wPort, which picks the meter link it is multiplexed onto; from then
+    // on frames pass through unchanged in both directions.  Once either
+    // side goes away the session closes for good.
+    //
+    // Given the relay's attribute cache, a GET-Request-Normal for a value
+    // the cache holds for the session's client SAP is answered without
+    // going to the meter, once the meter has accepted the association,
+    // and the value in each successful GET-Response-Normal is stored.  A SET or
+    // ACTION drops the object's cached attributes when it is sent and
+    // again when the meter answers, in case a read of the old value
+    // completed in between.  A GET-Request-Normal on an accepted
+    // association for an attribute which another such session with the
+    // same client SAP is already reading from the same meter is not
+    // sent; it is answered with the response to that read.
+    //
+    // Instances must be owned by a std::shared_ptr.
+    //
+    class LinuxRelaySession : public std::enable_shared_from_this<LinuxRelaySession>
+    {
+    public:
+        LinuxRelaySession(asio::ip::tcp::socket Socket, const asio::ip::tcp::endpoint& Meter,
+            LinuxRelay& Relay);
+        virtual ~LinuxRelaySession();
+
+        void Start();
+        //
+        // A frame from the meter.
+        //
+        void Deliver(RelayFrame::Buffer pFrame);
+        //
+        // Completes a GET which waited on another session's read of the
+        // same attribute: answers it from that read's GET-Response-Normal,
+        // or, if there is none, sends it to the meter after all.
+        //
+        void Release(const RelayFrame::Buffer& pRequest, const RelayFrame::Buffer& pResponse);
+        void Close();
+
+    private:
+        void Forward(RelayFrame::Buffer pFrame);
+        //
+        // Returns true if the request was answered from the cache.
+        //
+        bool Intercept(const RelayFrame::Buffer& pFrame);
+        void Observe(const RelayFrame::Buffer& pFrame);
+        void Invalidate(const RelayFrame::Descriptor& Object);
+        //
+        // Hands the response to one of this session's reads, or nothing,
+        // to the sessions waiting on it.
+        //
+        void Complete(const RelayFrame::Descriptor& Attribute, const RelayFrame::Buffer& pResponse);
+
+        std::shared_ptr<LinuxRelayStream> m_pStream;
+        asio::ip::tcp::endpoint           m_Meter;
+        LinuxRelay&                       m_Relay;
+        std::shared_ptr<LinuxMeterLink>   m_pLink;
+        uint16_t                          m_WPort = 0;
+        bool                              m_Associated = false;
+        bool                              m_Closed = false;
+        LinuxAttributeCache *             m_pCache;
+        std::string                       m_MeterURL;
+        //
+        // Requests sent to the meter and awaiting their responses, by
+        // invoke-id.  A SET or ACTION with a list of descriptors is kept
+        // with an empty OBIS code and clears the whole cache.
+        //
+        std::map<uint8_t, RelayFrame::Descriptor> m_Gets;
+        std::map<uint8_t, RelayFrame::Descriptor> m_Updates;
+
+    };
+    //
+    // Relays DLMS/COSEM associations from the HES to the meters.  With an
+    // ip6tables REDIRECT rule on the AP, connections which the HES makes to
+    // port 4059 of a meter arrive here instead, and the relay forwards them
+    // to their original destination over pooled meter links.  Without such
+    // a rule, a relay given a meter address forwards every connection made
+    // to it there.  A link which has had no association for the idle time
+    // is closed.
+    //
+    class LinuxRelay
+    {
+    public:
+        static const uint16_t DEFAULT_PORT = 4061;
+
+        struct Options
+        {
+            Options(uint16_t Port = DEFAULT_PORT,
+                uint32_t IdleTimeOutInMS = 60000,
+                LinuxAttributeCache * pCache = nullptr,
+                const asio::ip::tcp::endpoint& Meter = asio::ip::tcp::endpoint()) :
+                m_Port(Port),
+                m_IdleTimeOutInMS(IdleTimeOutInMS),
+                m_pCache(pCache),
+                m_Meter(Meter)
+            {
+            }
+            uint16_t                m_Port;
+            uint32_t                m_IdleTimeOutInMS;
+            //
+            // Used only from the thread running the io_service, so it
+            // cannot be shared with a reader on another thread.
+            //
+            LinuxAttributeCache *   m_pCache;
+            //
+            // Where connections which were not redirected go, if anywhere.
+            //
+            asio::ip::tcp::endpoint m_Meter;
+        };
+
+        LinuxRelay() = delete;
+        LinuxRelay(asio::io_service& IO, const Options& Opt = Options());
+        virtual ~LinuxRelay();
+
+        uint16_t GetPort() const;
+        LinuxAttributeCache * GetCache() const;
+
+        //
+        // The meter, client SAP, class, OBIS code and attribute of a read.
+        //
+        typedef std::tuple<std::string, uint16_t, uint16_t, std::string, uint8_t> ReadKey;
+        struct Waiter
+        {
+            std::weak_ptr<LinuxRelaySession> m_pSession;
+            RelayFrame::Buffer               m_pRequest;
+        };
+        //
+        // Returns true if a read of the same attribute of the same meter
+        // under the same client SAP is in flight, in which case the request waits for it.  Otherwise
+        // the caller's read is the one in flight from now on, and the
+        // caller must Finish() it.
+        //
+        bool Join(const ReadKey& Key, const std::shared_ptr<LinuxRelaySession>& pSession,
+            const RelayFrame::Buffer& pRequest);
+        std::vector<Waiter> Finish(const ReadKey& Key);
+        //
+        // The number of reads which waited on another instead of going to
+        // the meter.
+        //
+        uint64_t GetCoalesced() const;
+        //
+        // A link to the meter on which WPort is free, opening one if need
+        // be.
+        //
+        std::shared_ptr<LinuxMeterLink> Acquire(const asio::ip::tcp::endpoint& Meter, uint16_t WPort);
+
+    private:
+        typedef std::multimap<asio::ip::tcp::endpoint, std::shared_ptr<LinuxMeterLink>> LinkMap;
+        //
+        // Where the HES meant to connect before the connection was
+        // redirected, or the configured meter.
+        //
+        bool Destination(asio::ip::tcp::socket& Socket, asio::ip::tcp::endpoint * pMeter) const;
+        void Accept();
+        void ASIO_Accept_Handler(const asio::error_code& Error);
+        void Sweep();
+        void ASIO_Sweep_Handler(const asio::error_code& Error);
+
+        asio::io_service&                  m_IO;
+        asio::ip::tcp::acceptor            m_Acceptor;
+        asio::ip::tcp::socket              m_Socket;
+        asio::steady_timer                 m_SweepTimer;
+        Options                            m_Options;
+        LinkMap                            m_Links;
+        //
+        // The reads in flight and the requests waiting on each.
+        //
+        std::map<ReadKey, std::vector<Waiter>> m_Reads;
+        uint64_t                               m_Coalesced = 0;
+
+    };
+
+}
@@ -109,14 +109,22 @@
 // implied warranties, including, but not limited to, the implied warranties of merchantability
 // and fitness for a particular purpose are disclaimed.
 //
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include "LinuxBaseLibrary.h"
 #include "DLMS-COSEM.h"
 
 namespace EPRI
 {
-	LinuxBaseLibrary::LinuxBaseLibrary() :
-        m_Core(m_IO), m_Debug(m_IO), m_Scheduler(m_IO)
+	LinuxBaseLibrary::LinuxBaseLibrary(unsigned Threads /*= SINGLE_THREAD*/) :
+        m_Threads(Threads), m_Core(m_IO), m_Debug(m_IO), m_Scheduler(m_IO)
 	{
+        if (HARDWARE_THREADS == m_Threads)
+        {
+            m_Threads = std::max(std::thread::hardware_concurrency(), 1U);
+        }
 		SetBase(this);
 	}
 	
@@ -127,7 +135,7 @@ namespace EPRI
 	//
 	// IBaseLibrary
 	//
-	IMemory * LinuxBaseLibrary::GetMemory()
+	LinuxMemory * LinuxBaseLibrary::GetMemory()
 	{
 		return &m_Memory;
 	}
@@ -147,14 +155,31 @@ namespace EPRI
 		return &m_Synchronization;
 	}
 
-	IDebug * LinuxBaseLibrary::GetDebug()
+	LinuxDebug * LinuxBaseLibrary::GetDebug()
 	{
 		return &m_Debug;
 	}
     
     bool LinuxBaseLibrary::Process()
     {
-        return m_IO.run();
+        if (m_Threads <= SINGLE_THREAD)
+        {
+            return m_IO.run();
+        }
+        //
+        // The calling thread is one of the workers.
+        //
+        std::vector<std::thread> Workers;
+        for (unsigned Index = 1; Index < m_Threads; ++Index)
+        {
+            Workers.emplace_back([this]() { m_IO.run(); });
+        }
+        bool RetVal = m_IO.run();
+        for (std::thread& Worker : Workers)
+        {
+            Worker.join();
+        }
+        return RetVal;
     }
 	
 }
@@ -86,16 +86,23 @@ namespace EPRI
 	class LinuxBaseLibrary : public IBaseLibrary
 	{
 	public:
-		LinuxBaseLibrary();
+		//
+		// Number of threads Process() runs the io_service on.  Handlers
+		// belonging to one socket are serialized by that socket's strand.
+		//
+		static const unsigned SINGLE_THREAD = 1;
+		static const unsigned HARDWARE_THREADS = 0;
+
+		LinuxBaseLibrary(unsigned Threads = SINGLE_THREAD);
 		virtual ~LinuxBaseLibrary();
 		//
 		// IBaseLibrary
 		//
-		IMemory * GetMemory();
+		LinuxMemory * GetMemory();
 		ICore * GetCore();
 		IScheduler * GetScheduler();
 		ISynchronization * GetSynchronization();		
-		IDebug * GetDebug();
+		LinuxDebug * GetDebug();
     	bool Process();    	
     	//
     	//
@@ -106,6 +113,7 @@ namespace EPRI
     	}
 		
 	private:
+    	unsigned             m_Threads;
     	asio::io_service     m_IO;
 		LinuxMemory	         m_Memory;
 		LinuxCore            m_Core;
@@ -76,7 +76,7 @@
 namespace EPRI
 {
     LinuxCore::LinuxCore(asio::io_service& IO) :
-        m_IP(IO), m_Serial(IO)
+        m_IP(IO), m_Serial(IO), m_Timers(IO)
 	{
 	}
 	
@@ -98,7 +98,12 @@ namespace EPRI
 	{
 		// TODO - Embedded memory management
 		
-		return std::shared_ptr<ISimpleTimer>(new LinuxSimpleTimer);
+		return std::shared_ptr<ISimpleTimer>(new LinuxSimpleTimer(&m_Timers));
+	}
+
+	std::shared_ptr<LinuxSimpleTimer> LinuxCore::CreateSimpleTimer(LinuxSimpleTimer::ExpiryFunction Handler)
+	{
+		return std::make_shared<LinuxSimpleTimer>(&m_Timers, Handler);
 	}
 
 }
@@ -77,6 +77,8 @@
 #include "ICore.h"
 #include "LinuxSerial.h"
 #include "LinuxSocket.h"
+#include "LinuxSimpleTimer.h"
+#include "LinuxTimerWheel.h"
 
 namespace EPRI
 {
@@ -92,10 +94,15 @@ namespace EPRI
 		ISerial * GetSerial();
     	IIP * GetIP();
     	std::shared_ptr<ISimpleTimer> CreateSimpleTimer(bool bUseHeap = true);
+    	//
+    	// A timer on the shared wheel which calls Handler when it expires.
+    	//
+    	std::shared_ptr<LinuxSimpleTimer> CreateSimpleTimer(LinuxSimpleTimer::ExpiryFunction Handler);
 
 	private:
 		LinuxSerial			m_Serial;
     	LinuxIP             m_IP;
+    	LinuxTimerWheel     m_Timers;
 		
 	};
 	
@@ -70,47 +70,160 @@
 // DEALINGS IN THE SOFTWARE.
 // 
 
+#include <algorithm>
 #include <cstdio>
-#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
 
 #include "LinuxDebug.h"
 #include "dlms-access-pointConfig.h"
 
 namespace EPRI
 {
+    //
+    // LinuxTraceBuffer
+    //
+    LinuxTraceBuffer::LinuxTraceBuffer() :
+        m_Slots(new Slot[SLOT_COUNT]), m_Head(0), m_Dropped(0)
+    {
+        for (size_t Index = 0; Index < SLOT_COUNT; ++Index)
+        {
+            m_Slots[Index].m_Sequence.store(Index, std::memory_order_relaxed);
+        }
+    }
+
+    bool LinuxTraceBuffer::Push(const char * Format, va_list Args)
+    {
+        size_t Position = m_Head.load(std::memory_order_relaxed);
+        Slot * pSlot;
+        while (true)
+        {
+            pSlot = &m_Slots[Position % SLOT_COUNT];
+            size_t Sequence = pSlot->m_Sequence.load(std::memory_order_acquire);
+            if (Sequence == Position)
+            {
+                if (m_Head.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (Sequence < Position)
+            {
+                //
+                // The drain thread has not caught up; never wait for it.
+                //
+                m_Dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                Position = m_Head.load(std::memory_order_relaxed);
+            }
+        }
+        int Length = vsnprintf(pSlot->m_Line, LINE_SIZE, Format, Args);
+        pSlot->m_Length = Length < 0 ? 0 : std::min(size_t(Length), LINE_SIZE - 1);
+        pSlot->m_Sequence.store(Position + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t LinuxTraceBuffer::Pop(char * pLine)
+    {
+        Slot * pSlot = &m_Slots[m_Tail % SLOT_COUNT];
+        if (pSlot->m_Sequence.load(std::memory_order_acquire) != m_Tail + 1)
+        {
+            return 0;
+        }
+        size_t Length = pSlot->m_Length;
+        std::memcpy(pLine, pSlot->m_Line, Length);
+        pSlot->m_Sequence.store(m_Tail + SLOT_COUNT, std::memory_order_release);
+        ++m_Tail;
+        //
+        // An empty line still consumed a slot.
+        //
+        return Length ? Length : size_t(-1);
+    }
+
+    bool LinuxTraceBuffer::Empty() const
+    {
+        return m_Slots[m_Tail % SLOT_COUNT].m_Sequence.load(std::memory_order_acquire) != m_Tail + 1;
+    }
+
+    uint64_t LinuxTraceBuffer::Dropped() const
+    {
+        return m_Dropped.load(std::memory_order_relaxed);
+    }
+    //
+    // LinuxDebug
+    //
     LinuxDebug::LinuxDebug(asio::io_service& IO) :
-        m_Output(IO, ::dup(STDOUT_FILENO)), m_IO(IO)
+        m_Output(IO, ::dup(STDOUT_FILENO)), m_IO(IO), m_Threshold(SEVERITY_INFO), m_Running(true),
+        m_Sleeping(false)
     {
+        const char * pLevel = std::getenv("DLMS_TRACE_LEVEL");
+        if (pLevel)
+        {
+            const char * LEVELS[] = { "debug", "info", "warning", "error", "none" };
+            for (int Level = SEVERITY_DEBUG; Level <= SEVERITY_NONE; ++Level)
+            {
+                if (0 == std::strcmp(pLevel, LEVELS[Level]))
+                {
+                    m_Threshold = Level;
+                }
+            }
+        }
+        m_Drain = std::thread(&LinuxDebug::Drain, this);
     }
     
     LinuxDebug::~LinuxDebug() 
     {
+        m_Running = false;
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_Sleeping = false;
+        }
+        m_Wakeup.notify_one();
+        m_Drain.join();
     }
     
     void LinuxDebug::TRACE(const char * Format, ...)
     {
-        char Buffer[256];
         va_list Args;
         va_start(Args, Format);
-        vsnprintf(Buffer, sizeof(Buffer), Format, Args);
-        asio::write(m_Output, asio::buffer(Buffer, std::strlen(Buffer)));
+        VLog(SEVERITY_INFO, Format, Args);
         va_end(Args);
     }
     
     void LinuxDebug::TRACE_BUFFER(const char * Marker, const uint8_t * Buffer, size_t BufferSize, uint8_t BytesPerLine /*= 16*/)
     {
 #ifdef HEX_TRACE
-        TRACE("\n%s: ", Marker);
-        const uint8_t * p = Buffer;
-        while (p != (Buffer + BufferSize))
+        if (m_Threshold > SEVERITY_DEBUG)
         {
-            TRACE("%02X ", uint16_t(*p++));
-            if (0 == (size_t(p - Buffer) % BytesPerLine))
+            return;
+        }
+        //
+        // One queued line per row of bytes.
+        //
+        char   Row[LinuxTraceBuffer::LINE_SIZE];
+        size_t Length = 0;
+        for (size_t Index = 0; Index < BufferSize; ++Index)
+        {
+            if (0 == (Index % BytesPerLine))
+            {
+                if (Index)
+                {
+                    Log(SEVERITY_DEBUG, "%s\n", Row);
+                }
+                Length = snprintf(Row, sizeof(Row), "%s: ", Marker);
+            }
+            if (Length + 4 < sizeof(Row))
             {
-                TRACE("\n%s: ", Marker);
+                Length += snprintf(Row + Length, sizeof(Row) - Length, "%02X ", uint16_t(Buffer[Index]));
             }
         }
-        TRACE("\n");
+        if (BufferSize)
+        {
+            Log(SEVERITY_DEBUG, "%s\n", Row);
+        }
 #endif // HEX_TRACE
     }
     
@@ -121,5 +234,90 @@ namespace EPRI
 #endif // HEX_TRACE
     }
 
-    
+    void LinuxDebug::Log(Severity Level, const char * Format, ...)
+    {
+        va_list Args;
+        va_start(Args, Format);
+        VLog(Level, Format, Args);
+        va_end(Args);
+    }
+
+    uint64_t LinuxDebug::Dropped() const
+    {
+        return m_Buffer.Dropped();
+    }
+
+    void LinuxDebug::VLog(Severity Level, const char * Format, va_list Args)
+    {
+        if (Level >= m_Threshold.load(std::memory_order_relaxed) && SEVERITY_NONE != Level)
+        {
+            if (m_Buffer.Push(Format, Args))
+            {
+                Wake();
+            }
+        }
+    }
+
+    void LinuxDebug::Wake()
+    {
+        //
+        // Pairs with the fence in Drain(): either the drain thread sees the
+        // new line before it sleeps, or this sees it sleeping.
+        //
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_Sleeping.load(std::memory_order_relaxed) && m_Sleeping.exchange(false))
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_Wakeup.notify_one();
+        }
+    }
+
+    void LinuxDebug::Drain()
+    {
+        const size_t     BATCH_SIZE = 16 * LinuxTraceBuffer::LINE_SIZE;
+        std::unique_ptr<char[]> Batch(new char[BATCH_SIZE]);
+        uint64_t         Reported = 0;
+        bool             Running = true;
+        while (Running)
+        {
+            //
+            // Read the flag before draining so nothing queued before shutdown
+            // is left behind.
+            //
+            Running = m_Running;
+            size_t Length = 0;
+            size_t LineLength;
+            while (Length + LinuxTraceBuffer::LINE_SIZE <= BATCH_SIZE &&
+                   (LineLength = m_Buffer.Pop(&Batch[Length])))
+            {
+                Length += (size_t(-1) == LineLength) ? 0 : LineLength;
+            }
+            uint64_t Dropped = m_Buffer.Dropped();
+            if (Dropped != Reported &&
+                Length + LinuxTraceBuffer::LINE_SIZE <= BATCH_SIZE)
+            {
+                Length += snprintf(&Batch[Length], LinuxTraceBuffer::LINE_SIZE,
+                    "[%llu trace lines dropped]\n", (unsigned long long)(Dropped - Reported));
+                Reported = Dropped;
+            }
+            if (Length)
+            {
+                asio::error_code Error;
+                asio::write(m_Output, asio::buffer(Batch.get(), Length), Error);
+                Running = true;
+            }
+            else if (Running)
+            {
+                std::unique_lock<std::mutex> Lock(m_Mutex);
+                m_Sleeping = true;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (m_Buffer.Empty() && m_Running)
+                {
+                    m_Wakeup.wait(Lock, [this]() { return !m_Sleeping; });
+                }
+                m_Sleeping = false;
+            }
+        }
+    }
+
 }
@@ -73,26 +73,101 @@
 #pragma once
 
 #include <asio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "IDebug.h"
 
 namespace EPRI
 {
+    //
+    // Bounded multi-producer queue of formatted trace lines.  Producers never
+    // block or lock; if every slot is taken the line is dropped and counted.
+    //
+    class LinuxTraceBuffer
+    {
+    public:
+        static const size_t SLOT_COUNT = 1024;
+        static const size_t LINE_SIZE = 256;
+
+        LinuxTraceBuffer();
+
+        bool Push(const char * Format, va_list Args);
+        //
+        // Consumer side, for a single thread only.
+        //
+        size_t Pop(char * pLine);
+        bool Empty() const;
+        uint64_t Dropped() const;
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> m_Sequence;
+            size_t              m_Length;
+            char                m_Line[LINE_SIZE];
+        };
+
+        std::unique_ptr<Slot[]> m_Slots;
+        std::atomic<size_t>     m_Head;
+        size_t                  m_Tail = 0;
+        std::atomic<uint64_t>   m_Dropped;
+
+    };
+
     class LinuxDebug : public IDebug
     {
     public:
+        enum Severity
+        {
+            SEVERITY_DEBUG,
+            SEVERITY_INFO,
+            SEVERITY_WARNING,
+            SEVERITY_ERROR,
+            SEVERITY_NONE
+        };
+
         LinuxDebug() = delete;
         LinuxDebug(asio::io_service& IO);
         virtual ~LinuxDebug();
-        
+        //
+        // IDebug.  TRACE logs at SEVERITY_INFO, the hex dumps at SEVERITY_DEBUG.
+        // Lines below the threshold set with DLMS_TRACE_LEVEL (debug, info,
+        // warning, error or none; info by default) are discarded before
+        // formatting.
+        //
         virtual void TRACE(const char * Format, ...);
         virtual void TRACE_BUFFER(const char * Marker, const uint8_t * Buffer, size_t BufferSize, uint8_t BytesPerLine = 16);
         virtual void TRACE_VECTOR(const char * Marker, const DLMSVector& Data, uint8_t BytesPerLine = 16);
-        
+        //
+        // The number of lines lost because the queue was full.
+        //
+        uint64_t Dropped() const;
+
     protected:
+        void Log(Severity Level, const char * Format, ...);
+        void VLog(Severity Level, const char * Format, va_list Args);
+        void Drain();
+        void Wake();
+
         asio::posix::stream_descriptor    m_Output;
         asio::io_service&                 m_IO;
-        
+        std::atomic<int>                  m_Threshold;
+        LinuxTraceBuffer                  m_Buffer;
+        std::atomic<bool>                 m_Running;
+        //
+        // The drain thread sleeps on m_Wakeup once the buffer is empty; the
+        // first producer to find m_Sleeping set wakes it.
+        //
+        std::atomic<bool>                 m_Sleeping;
+        std::mutex                        m_Mutex;
+        std::condition_variable           m_Wakeup;
+        std::thread                       m_Drain;
+
     };
     
 }
@@ -70,29 +70,301 @@
 // DEALINGS IN THE SOFTWARE.
 // 
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <map>
 #include <memory>
 #include "LinuxMemory.h"
 
 namespace EPRI
 {
-	LinuxMemory::LinuxMemory()
+	namespace
 	{
+		const size_t SIZE_CLASSES[LinuxMemory::CLASS_COUNT] =
+		{
+			16, 32, 64, 128, 256, 512, 1024, 2048, 4096
+		};
+		const uint32_t CLASS_LARGE = 0xFF;
+		//
+		// Every block starts with a header saying where it came from.
+		//
+		struct alignas(std::max_align_t) BlockHeader
+		{
+			uint32_t m_Class;
+			uint32_t m_Size;
+		};
+		const size_t HEADER_SIZE = sizeof(BlockHeader);
+
+		std::atomic<uint64_t>           g_NextID(1);
+		//
+		// Live instances by ID, so a thread cache never hands blocks back to
+		// an instance which has already freed its slabs.
+		//
+		std::mutex& InstanceMutex()
+		{
+			static std::mutex Mutex;
+			return Mutex;
+		}
+
+		std::map<uint64_t, LinuxMemory *>& Instances()
+		{
+			static std::map<uint64_t, LinuxMemory *> Map;
+			return Map;
+		}
+
+		inline BlockHeader * HeaderOf(void * p)
+		{
+			return reinterpret_cast<BlockHeader *>(static_cast<uint8_t *>(p) - HEADER_SIZE);
+		}
+
+		inline void * PayloadOf(void * pHeader)
+		{
+			return static_cast<uint8_t *>(pHeader) + HEADER_SIZE;
+		}
+
+		inline size_t ClassOf(size_t Size)
+		{
+			return std::lower_bound(SIZE_CLASSES, SIZE_CLASSES + LinuxMemory::CLASS_COUNT, Size) - SIZE_CLASSES;
+		}
+	}
+	//
+	// LinuxMemory::ThreadCache
+	//
+	struct LinuxMemory::ThreadCache
+	{
+		uint64_t m_Owner = 0;
+		void *   m_pFree[CLASS_COUNT] = {};
+		size_t   m_Count[CLASS_COUNT] = {};
+
+		~ThreadCache()
+		{
+			Detach();
+		}
+		//
+		// Hands every cached block back to the instance it came from, if
+		// that is still alive.
+		//
+		void Detach()
+		{
+			if (m_Owner)
+			{
+				std::lock_guard<std::mutex> Lock(InstanceMutex());
+				std::map<uint64_t, LinuxMemory *>::iterator it = Instances().find(m_Owner);
+				if (it != Instances().end())
+				{
+					it->second->Reclaim(*this);
+				}
+			}
+			m_Owner = 0;
+			std::fill(m_pFree, m_pFree + CLASS_COUNT, nullptr);
+			std::fill(m_Count, m_Count + CLASS_COUNT, 0);
+		}
+
+
+		void Attach(uint64_t Owner)
+		{
+			if (m_Owner != Owner)
+			{
+				Detach();
+				m_Owner = Owner;
+			}
+		}
+	};
+
+	thread_local LinuxMemory::ThreadCache LinuxMemory::t_Cache;
+	//
+	// LinuxMemory
+	//
+	LinuxMemory::LinuxMemory() :
+		m_ID(g_NextID++), m_BytesLive(0), m_HighWaterMark(0), m_Allocations(0),
+		m_LastSample(std::chrono::steady_clock::now())
+	{
+		std::lock_guard<std::mutex> Lock(InstanceMutex());
+		Instances()[m_ID] = this;
 	}
 	
 	LinuxMemory::~LinuxMemory()
 	{
+		{
+			std::lock_guard<std::mutex> Lock(InstanceMutex());
+			Instances().erase(m_ID);
+		}
+		for (void * pSlab : m_Slabs)
+		{
+			std::free(pSlab);
+		}
 	}
 
 	void * LinuxMemory::Alloc(size_t Size)
 	{
-		return std::calloc(Size, 1);
+		size_t Class = ClassOf(Size);
+		if (Class < CLASS_COUNT)
+		{
+			void * p = AllocBlock(Class);
+			if (p)
+			{
+				//
+				// Callers have always been handed zeroed memory.
+				//
+				std::memset(p, 0, Size);
+				HeaderOf(p)->m_Size = uint32_t(Size);
+				Account(SIZE_CLASSES[Class]);
+			}
+			return p;
+		}
+		BlockHeader * pHeader = static_cast<BlockHeader *>(std::calloc(HEADER_SIZE + Size, 1));
+		if (!pHeader)
+		{
+			return nullptr;
+		}
+		pHeader->m_Class = CLASS_LARGE;
+		pHeader->m_Size = uint32_t(Size);
+		Account(Size);
+		return PayloadOf(pHeader);
 	}
 
 	ERROR_TYPE LinuxMemory::Free(void* p)
 	{
-        std::free(p);
-        p = nullptr;
+		if (!p)
+		{
+			return SRC_DONT_CARE;
+		}
+		BlockHeader * pHeader = HeaderOf(p);
+		switch (pHeader->m_Class)
+		{
+		case CLASS_LARGE:
+			m_BytesLive.fetch_sub(pHeader->m_Size, std::memory_order_relaxed);
+			std::free(pHeader);
+			break;
+		default:
+			{
+				size_t Class = pHeader->m_Class;
+				m_BytesLive.fetch_sub(SIZE_CLASSES[Class], std::memory_order_relaxed);
+				FreeToCache(reinterpret_cast<FreeBlock *>(pHeader), Class);
+			}
+			break;
+		}
         return SRC_DONT_CARE;
 	}
+
+	LinuxMemory::Statistics LinuxMemory::GetStatistics()
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		Statistics RetVal;
+		std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+		std::chrono::duration<double> Elapsed = Now - m_LastSample;
+
+		RetVal.BytesLive = m_BytesLive;
+		RetVal.HighWaterMark = m_HighWaterMark;
+		RetVal.Allocations = m_Allocations;
+		RetVal.AllocationsPerSecond = Elapsed.count() > 0.0 ?
+			(RetVal.Allocations - m_LastAllocations) / Elapsed.count() : 0.0;
+		m_LastAllocations = RetVal.Allocations;
+		m_LastSample = Now;
+		return RetVal;
+	}
+
+	void * LinuxMemory::AllocBlock(size_t Class)
+	{
+		t_Cache.Attach(m_ID);
+		if (!t_Cache.m_pFree[Class])
+		{
+			Refill(Class);
+			if (!t_Cache.m_pFree[Class])
+			{
+				return nullptr;
+			}
+		}
+		FreeBlock * pBlock = static_cast<FreeBlock *>(t_Cache.m_pFree[Class]);
+		t_Cache.m_pFree[Class] = pBlock->m_pNext;
+		--t_Cache.m_Count[Class];
+
+		BlockHeader * pHeader = reinterpret_cast<BlockHeader *>(pBlock);
+		pHeader->m_Class = uint32_t(Class);
+		return PayloadOf(pHeader);
+	}
+
+	void LinuxMemory::FreeToCache(FreeBlock * pBlock, size_t Class)
+	{
+		t_Cache.Attach(m_ID);
+		pBlock->m_pNext = static_cast<FreeBlock *>(t_Cache.m_pFree[Class]);
+		t_Cache.m_pFree[Class] = pBlock;
+		if (++t_Cache.m_Count[Class] > CACHE_LIMIT)
+		{
+			Spill(Class);
+		}
+	}
+
+	void LinuxMemory::Refill(size_t Class)
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		if (!m_pFree[Class])
+		{
+			const size_t BlockSize = HEADER_SIZE + SIZE_CLASSES[Class];
+			uint8_t *    pSlab = static_cast<uint8_t *>(std::malloc(SLAB_SIZE));
+			if (!pSlab)
+			{
+				return;
+			}
+			m_Slabs.push_back(pSlab);
+			for (size_t Offset = 0; Offset + BlockSize <= SLAB_SIZE; Offset += BlockSize)
+			{
+				FreeBlock * pBlock = reinterpret_cast<FreeBlock *>(pSlab + Offset);
+				pBlock->m_pNext = m_pFree[Class];
+				m_pFree[Class] = pBlock;
+			}
+		}
+		//
+		// Take half a cache's worth so the lock is not taken again soon.
+		//
+		while (m_pFree[Class] && t_Cache.m_Count[Class] < CACHE_LIMIT / 2)
+		{
+			FreeBlock * pBlock = m_pFree[Class];
+			m_pFree[Class] = pBlock->m_pNext;
+			pBlock->m_pNext = static_cast<FreeBlock *>(t_Cache.m_pFree[Class]);
+			t_Cache.m_pFree[Class] = pBlock;
+			++t_Cache.m_Count[Class];
+		}
+	}
+
+	void LinuxMemory::Spill(size_t Class)
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		while (t_Cache.m_Count[Class] > CACHE_LIMIT / 2)
+		{
+			FreeBlock * pBlock = static_cast<FreeBlock *>(t_Cache.m_pFree[Class]);
+			t_Cache.m_pFree[Class] = pBlock->m_pNext;
+			--t_Cache.m_Count[Class];
+			pBlock->m_pNext = m_pFree[Class];
+			m_pFree[Class] = pBlock;
+		}
+	}
+
+	void LinuxMemory::Reclaim(ThreadCache& Cache)
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		for (size_t Class = 0; Class < CLASS_COUNT; ++Class)
+		{
+			while (Cache.m_pFree[Class])
+			{
+				FreeBlock * pBlock = static_cast<FreeBlock *>(Cache.m_pFree[Class]);
+				Cache.m_pFree[Class] = pBlock->m_pNext;
+				pBlock->m_pNext = m_pFree[Class];
+				m_pFree[Class] = pBlock;
+			}
+			Cache.m_Count[Class] = 0;
+		}
+	}
+
+	void LinuxMemory::Account(size_t Bytes)
+	{
+		m_Allocations.fetch_add(1, std::memory_order_relaxed);
+		size_t Live = m_BytesLive.fetch_add(Bytes, std::memory_order_relaxed) + Bytes;
+		size_t HighWater = m_HighWaterMark.load(std::memory_order_relaxed);
+		while (Live > HighWater &&
+			!m_HighWaterMark.compare_exchange_weak(HighWater, Live, std::memory_order_relaxed))
+		{
+		}
+	}
 }
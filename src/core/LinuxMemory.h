@@ -72,18 +72,72 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
 #include "IMemory.h"
 
 namespace EPRI
 {
+	//
+	// Size-class allocator.  Small requests are served from slabs through a
+	// per-thread cache of free blocks and only take the lock to refill or
+	// spill that cache; larger ones fall through to the heap.  A thread's
+	// cache is handed back to the shared free lists when the thread exits.
+	//
 	class LinuxMemory : public IMemory
 	{
 	public:
+		struct Statistics
+		{
+			size_t   BytesLive;
+			size_t   HighWaterMark;
+			uint64_t Allocations;
+			double   AllocationsPerSecond;
+		};
+
+		static const size_t CLASS_COUNT = 9;
+		static const size_t SLAB_SIZE = 65536;
+		static const size_t CACHE_LIMIT = 64;
+
 		LinuxMemory();
 		virtual ~LinuxMemory();
 		
 		virtual void * Alloc(size_t Size);
 		virtual ERROR_TYPE Free(void* p);
+		//
+		// AllocationsPerSecond is measured since the previous call.
+		//
+		Statistics GetStatistics();
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock * m_pNext;
+		};
+		struct ThreadCache;
+
+		void * AllocBlock(size_t Class);
+		void FreeToCache(FreeBlock * pBlock, size_t Class);
+		void Refill(size_t Class);
+		void Spill(size_t Class);
+		void Reclaim(ThreadCache& Cache);
+		void Account(size_t Bytes);
+
+		static thread_local ThreadCache t_Cache;
+
+		uint64_t                   m_ID;
+		std::mutex                 m_Mutex;
+		FreeBlock *                m_pFree[CLASS_COUNT] = {};
+		std::vector<void *>        m_Slabs;
+		std::atomic<size_t>        m_BytesLive;
+		std::atomic<size_t>        m_HighWaterMark;
+		std::atomic<uint64_t>      m_Allocations;
+		uint64_t                   m_LastAllocations = 0;
+		std::chrono::steady_clock::time_point m_LastSample;
 		
 	};
 	
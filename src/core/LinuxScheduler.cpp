@@ -76,6 +76,22 @@
 
 namespace EPRI
 {
+    namespace
+    {
+        thread_local LinuxScheduler::Strand * t_pStrand = nullptr;
+    }
+
+    LinuxScheduler::StrandScope::StrandScope(Strand& Current) :
+        m_pPrevious(t_pStrand)
+    {
+        t_pStrand = &Current;
+    }
+
+    LinuxScheduler::StrandScope::~StrandScope()
+    {
+        t_pStrand = m_pPrevious;
+    }
+
     LinuxScheduler::LinuxScheduler(asio::io_service& IO) :
         m_IO(IO)
     {
@@ -87,7 +103,19 @@ namespace EPRI
         
     void LinuxScheduler::Post(PostFunction Handler)
     {
-        m_IO.post(Handler);
+        if (t_pStrand)
+        {
+            PostTo(*t_pStrand, Handler);
+        }
+        else
+        {
+            m_IO.post(Handler);
+        }
+    }
+
+    LinuxScheduler::Strand * LinuxScheduler::CurrentStrand()
+    {
+        return t_pStrand;
     }
     
     void LinuxScheduler::Sleep(uint32_t MSToSleep)
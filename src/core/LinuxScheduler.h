@@ -73,20 +73,86 @@
 #pragma once
 
 #include <asio.hpp>
+#include <utility>
 
 #include "IScheduler.h"
 
 namespace EPRI
 {
+    //
+    // Work posted from a handler that runs through a connection's strand
+    // stays on that strand, so with the io_service on several threads it
+    // never races the connection's own handlers.  Work posted from
+    // anywhere else goes to the io_service.
+    //
     class LinuxScheduler : public IScheduler
     {
     public:
+        typedef asio::io_service::strand Strand;
+        //
+        // Marks Strand as the current one for the handler running on this
+        // thread, for as long as the scope lives.
+        //
+        class StrandScope
+        {
+        public:
+            StrandScope(Strand& Current);
+            ~StrandScope();
+
+        private:
+            Strand * m_pPrevious;
+        };
+        //
+        // A handler which runs inside a StrandScope.
+        //
+        template <typename Handler>
+        class StrandHandler
+        {
+        public:
+            StrandHandler(Strand& Current, Handler H) :
+                m_pStrand(&Current), m_Handler(std::move(H))
+            {
+            }
+
+            template <typename... Args>
+            void operator()(Args&&... Arguments)
+            {
+                StrandScope Scope(*m_pStrand);
+                m_Handler(std::forward<Args>(Arguments)...);
+            }
+
+        private:
+            Strand * m_pStrand;
+            Handler  m_Handler;
+        };
+
         LinuxScheduler() = delete;
         LinuxScheduler(asio::io_service& IO);
         virtual ~LinuxScheduler();
         
         virtual void Post(PostFunction Handler);
         virtual void Sleep(uint32_t MSToSleep);
+        //
+        // The strand of the handler running on this thread, if any.
+        //
+        static Strand * CurrentStrand();
+        //
+        // Strand.wrap(), recording the strand for whatever the handler posts.
+        //
+        template <typename Handler>
+        static auto Wrap(Strand& Current, Handler H)
+            -> decltype(Current.wrap(StrandHandler<Handler>(Current, std::move(H))))
+        {
+            return Current.wrap(StrandHandler<Handler>(Current, std::move(H)));
+        }
+        //
+        // Strand.post(), likewise.
+        //
+        template <typename Handler>
+        static void PostTo(Strand& Current, Handler H)
+        {
+            Current.post(StrandHandler<Handler>(Current, std::move(H)));
+        }
        
     protected:
         asio::io_service& m_IO;
@@ -77,6 +77,7 @@
 
 #include "optional.h"
 #include "LinuxSerial.h"
+#include "LinuxScheduler.h"
 #include "IBaseLibrary.h"
 #include "IDebug.h"
 
@@ -96,6 +97,7 @@ namespace EPRI
         
     ISerialSocket * LinuxSerial::CreateSocket(const ISerial::Options& Opt)
     {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
         return &(*m_Sockets.emplace(m_Sockets.begin(), Opt, m_IO));
     }
     
@@ -103,9 +105,11 @@ namespace EPRI
     {
         pSocket->Close();
         //
-        // Post to allow socket cleanup befor removal.
+        // Post to allow socket cleanup befor removal.  Going through the
+        // socket's strand keeps removal from overlapping its last handler.
         //
-        m_IO.post(std::bind(&LinuxSerial::RemoveSocket, this, pSocket));
+        static_cast<LinuxSerialSocket *>(pSocket)->GetStrand().post(
+            std::bind(&LinuxSerial::RemoveSocket, this, pSocket));
     }
     
     bool LinuxSerial::Process()
@@ -115,6 +119,7 @@ namespace EPRI
 
     void LinuxSerial::RemoveSocket(ISerialSocket * pSocket)
     {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
         m_Sockets.remove_if(
             [pSocket](const LinuxSerialSocket& Socket)
         {
@@ -127,6 +132,7 @@ namespace EPRI
     LinuxSerialSocket::LinuxSerialSocket(const ISerial::Options& Opt, asio::io_service& IO)
         : m_Options(Opt)
         , m_Port(IO)
+        , m_Strand(IO)
         , m_ReadTimer(IO)
     {
     }
@@ -228,6 +234,11 @@ namespace EPRI
     {
         return m_Options;
     }
+
+    asio::io_service::strand& LinuxSerialSocket::GetStrand()
+    {
+        return m_Strand;
+    }
     
     ERROR_TYPE LinuxSerialSocket::Write(const DLMSVector& Data, bool Asynchronous /*= false*/)
     {
@@ -242,7 +253,7 @@ namespace EPRI
             {
                 asio::async_write(m_Port,
                     asio::buffer(Data.GetBytes()), 
-                    std::bind(&LinuxSerialSocket::ASIO_Write_Handler, this, std::placeholders::_1, std::placeholders::_2));
+                    LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxSerialSocket::ASIO_Write_Handler, this, std::placeholders::_1, std::placeholders::_2)));
             }
         }
         else
@@ -275,13 +286,13 @@ namespace EPRI
             asio::async_read(m_Port,
                 m_ReadBuffer,
                 asio::transfer_exactly(ReadAtLeast ? ReadAtLeast : 1), 
-                std::bind(&LinuxSerialSocket::ASIO_Read_Handler, this, std::placeholders::_1, std::placeholders::_2));
+                LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxSerialSocket::ASIO_Read_Handler, this, std::placeholders::_1, std::placeholders::_2)));
             if (TimeOutInMS)
             {
                 m_ReadTimer.expires_from_now(std::chrono::milliseconds(TimeOutInMS));
-                m_ReadTimer.async_wait(std::bind(&LinuxSerialSocket::ASIO_Read_Timeout,
+                m_ReadTimer.async_wait(LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxSerialSocket::ASIO_Read_Timeout,
                     this, 
-                    std::placeholders::_1));
+                    std::placeholders::_1)));
             }
             else
             {
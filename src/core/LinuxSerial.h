@@ -75,6 +75,7 @@
 #include <asio.hpp>
 #include <memory>
 #include <list>
+#include <mutex>
 
 #include "ISerial.h"
 
@@ -93,6 +94,10 @@ namespace EPRI
         
         ISerial::Options GetOptions();
         //
+        // All handlers for this port run through this strand.
+        //
+        asio::io_service::strand& GetStrand();
+        //
         // ISocket
         //
         virtual ERROR_TYPE Open(const char * DestinationAddress = nullptr, int Port = DEFAULT_DLMS_PORT);
@@ -123,6 +128,7 @@ namespace EPRI
         void OnClose(ERROR_TYPE Error);
 
         asio::serial_port               m_Port;
+        asio::io_service::strand        m_Strand;
         asio::steady_timer              m_ReadTimer;
         asio::streambuf                 m_ReadBuffer;
         ISerial::Options                m_Options;
@@ -150,6 +156,7 @@ namespace EPRI
         
         using             SerialSocketList = std::list<LinuxSerialSocket>;        
         SerialSocketList  m_Sockets;
+        std::mutex        m_Mutex;
         asio::io_service& m_IO;
     };    
 
@@ -70,22 +70,22 @@
 // DEALINGS IN THE SOFTWARE.
 // 
 
-#include <memory>
-#include <time.h>
-
 #include "LinuxSimpleTimer.h"
 
 namespace EPRI
 {
-	LinuxSimpleTimer::LinuxSimpleTimer()
-		: m_State(IDLE),
-		m_End(0),
-		m_DurationInMilliseconds(0)
+	LinuxSimpleTimer::LinuxSimpleTimer(LinuxTimerWheel * pWheel /*= nullptr*/, ExpiryFunction Handler /*= nullptr*/)
+		: m_pWheel(pWheel),
+		m_State(IDLE),
+		m_DurationInMilliseconds(0),
+		m_End(0)
 	{
+		m_Entry.m_Handler = Handler;
 	}
 	
 	LinuxSimpleTimer::~LinuxSimpleTimer()
 	{
+		Stop();
 	}
 	
 	void LinuxSimpleTimer::Initialize(uint32_t DurationInMilliseconds)
@@ -96,17 +96,26 @@ namespace EPRI
 	void LinuxSimpleTimer::Start()
 	{
 		m_State = ISimpleTimer::RUNNING;
-		m_End = GetTickCount() + m_DurationInMilliseconds;
+		m_End = LinuxTimerWheel::Now() + m_DurationInMilliseconds;
+		if (m_pWheel)
+		{
+			m_pWheel->Schedule(&m_Entry, m_End);
+		}
 	}
 
 	void LinuxSimpleTimer::Stop()
 	{
+		if (m_pWheel)
+		{
+			m_pWheel->Cancel(&m_Entry);
+		}
 		m_State = IDLE;
 	}
 
 	bool LinuxSimpleTimer::IsExpired()
 	{
-		if ((RUNNING == m_State) && (GetTickCount() >= m_End))
+		if ((RUNNING == m_State) && 
+			(m_Entry.m_Fired || LinuxTimerWheel::Now() >= m_End))
 		{
 			m_State = EXPIRED;
 			return true;
@@ -116,24 +125,21 @@ namespace EPRI
 
 	uint32_t LinuxSimpleTimer::RemainingTime()
 	{
-		if (RUNNING == m_State)
+		uint64_t Now = LinuxTimerWheel::Now();
+		if ((RUNNING == m_State) && (Now < m_End))
 		{
-			return GetTickCount() - m_End;
+			return uint32_t(m_End - Now);
 		}
 		return 0;
 	}
 
 	ISimpleTimer::TimerState LinuxSimpleTimer::State()
 	{
+		if ((RUNNING == m_State) && m_Entry.m_Fired)
+		{
+			m_State = EXPIRED;
+		}
 		return m_State;
 	}
 
-	uint32_t LinuxSimpleTimer::GetTickCount() const
-	{
-		struct timespec ts;
-		::clock_gettime(CLOCK_MONOTONIC, &ts);
-		return (ts.tv_sec * 1000L + (ts.tv_nsec / 1000000));
-	}
-
 }
-
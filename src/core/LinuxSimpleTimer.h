@@ -72,14 +72,23 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "ISimpleTimer.h"
+#include "LinuxTimerWheel.h"
 
 namespace EPRI
 {
+	//
+	// Without a wheel the timer can only be polled with IsExpired().  With
+	// one, it also calls back on expiry.
+	//
 	class LinuxSimpleTimer : public ISimpleTimer
 	{
 	public:
-		LinuxSimpleTimer();
+		typedef LinuxTimerWheel::ExpiryFunction ExpiryFunction;
+
+		LinuxSimpleTimer(LinuxTimerWheel * pWheel = nullptr, ExpiryFunction Handler = nullptr);
 		virtual ~LinuxSimpleTimer();
 		//
 		// ISimpleTimer
@@ -92,11 +101,11 @@ namespace EPRI
 		TimerState State();
 		
 	private:
-		uint32_t GetTickCount() const;
-		
-		TimerState m_State;
-		uint32_t   m_DurationInMilliseconds;
-		uint32_t   m_End;
+		LinuxTimerWheel *       m_pWheel;
+		LinuxTimerWheel::Entry  m_Entry;
+		TimerState              m_State;
+		uint32_t                m_DurationInMilliseconds;
+		uint64_t                m_End;
 		
 	};
 	
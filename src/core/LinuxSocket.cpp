@@ -71,13 +71,16 @@
 // 
 
 #include <termios.h>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <string>
 
 #include "optional.h"
 #include "LinuxSocket.h"
+#include "LinuxScheduler.h"
 #include "IBaseLibrary.h"
 #include "IDebug.h"
 
@@ -98,6 +101,7 @@ namespace EPRI
         
     ISocket * LinuxIP::CreateSocket(const IIP::Options& Opt)
     {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
         return &(*m_TCPSockets.emplace(m_TCPSockets.begin(), Opt, m_IO));
     }
     
@@ -105,9 +109,11 @@ namespace EPRI
     {
         pSocket->Close();
         //
-        // Post to allow socket cleanup befor removal.
+        // Post to allow socket cleanup befor removal.  Going through the
+        // socket's strand keeps removal from overlapping its last handler.
         //
-        m_IO.post(std::bind(&LinuxIP::RemoveSocket, this, pSocket));
+        static_cast<LinuxTCPSocket *>(pSocket)->GetStrand().post(
+            std::bind(&LinuxIP::RemoveSocket, this, pSocket));
     }
     
     bool LinuxIP::Process()
@@ -117,6 +123,7 @@ namespace EPRI
 
     void LinuxIP::RemoveSocket(ISocket * pSocket)
     {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
         m_TCPSockets.remove_if(
             [pSocket](const LinuxTCPSocket& Socket)
             {
@@ -127,7 +134,7 @@ namespace EPRI
     // LinuxTCPSocket
     //
     LinuxTCPSocket::LinuxTCPSocket(const IIP::Options& Opt, asio::io_service& IO):
-        m_Options(Opt), m_Acceptor(IO), m_Socket(IO), m_Resolver(IO)
+        m_Options(Opt), m_Acceptor(IO), m_Socket(IO), m_Strand(IO), m_Resolver(IO)
     {
     }
     
@@ -152,7 +159,7 @@ namespace EPRI
         {
             tcp::endpoint Endpoint = *it;
             m_Socket.async_connect(Endpoint, 
-                std::bind(&LinuxTCPSocket::ASIO_Connect_Handler, this, std::placeholders::_1, ++it));
+                LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Connect_Handler, this, std::placeholders::_1, ++it)));
         }
     }
 
@@ -169,13 +176,18 @@ namespace EPRI
             m_Socket.close();
             tcp::endpoint Endpoint = *it;
             m_Socket.async_connect(Endpoint, 
-                std::bind(&LinuxTCPSocket::ASIO_Connect_Handler, this, std::placeholders::_1, ++it));
+                LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Connect_Handler, this, std::placeholders::_1, ++it)));
             
         }
     }
 
     void LinuxTCPSocket::ASIO_Write_Handler(const asio::error_code& Error, size_t BytesTransferred)
     {
+        std::vector<WriteBuffer> Written;
+        {
+            std::lock_guard<std::mutex> Lock(m_WriteMutex);
+            Written.swap(m_InFlight);
+        }
         //
         // Handle TCP Disconnection
         //
@@ -183,19 +195,57 @@ namespace EPRI
             (asio::error::connection_reset == Error) ||
             (asio::error::operation_aborted == Error))
         {
+            {
+                std::lock_guard<std::mutex> Lock(m_WriteMutex);
+                m_WriteQueue.clear();
+            }
             if (m_Close)
             {
                 m_Close(SUCCESSFUL);
             }
+            return;
         }
-        else if (m_Write)
+        //
+        // Callers still see one completion per Write().
+        //
+        ERROR_TYPE Result = Error || !m_Socket.is_open() ? !SUCCESSFUL : SUCCESSFUL;
+        for (const WriteBuffer& Buffer : Written)
         {
-            m_Write(Error || !m_Socket.is_open() ? !SUCCESSFUL : SUCCESSFUL, BytesTransferred);
+            if (m_Write)
+            {
+                m_Write(Result, Buffer.size());
+            }
         }
+        StartWrite();
+    }
+
+    void LinuxTCPSocket::StartWrite()
+    {
+        std::vector<asio::const_buffer> Buffers;
+        {
+            std::lock_guard<std::mutex> Lock(m_WriteMutex);
+            if (!m_InFlight.empty() || m_WriteQueue.empty())
+            {
+                return;
+            }
+            while (!m_WriteQueue.empty())
+            {
+                m_InFlight.push_back(std::move(m_WriteQueue.front()));
+                m_WriteQueue.pop_front();
+            }
+            Buffers.reserve(m_InFlight.size());
+            for (const WriteBuffer& Buffer : m_InFlight)
+            {
+                Buffers.push_back(asio::buffer(Buffer));
+            }
+        }
+        asio::async_write(m_Socket, Buffers, 
+            LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Write_Handler, this, std::placeholders::_1, std::placeholders::_2)));
     }
     
-    void LinuxTCPSocket::ASIO_Read_Handler(const asio::error_code& Error, size_t BytesTransferred)
+    void LinuxTCPSocket::ASIO_Read_Handler(const asio::error_code& Error, size_t BytesTransferred, size_t ReadAtLeast)
     {
+        m_ReadEnd += BytesTransferred;
         //
         // Handle TCP Disconnection
         //
@@ -210,7 +260,36 @@ namespace EPRI
         }
         else if (m_Read)
         {
-            m_Read(Error ? !SUCCESSFUL : SUCCESSFUL, BytesTransferred);
+            //
+            // With no minimum, report everything we have so the caller can
+            // take it in one go.
+            //
+            m_Read(Error ? !SUCCESSFUL : SUCCESSFUL, ReadAtLeast ? ReadAtLeast : Buffered());
+        }
+    }
+
+    size_t LinuxTCPSocket::Buffered() const
+    {
+        return m_ReadEnd - m_ReadStart;
+    }
+
+    void LinuxTCPSocket::PrepareReadBuffer(size_t ReadAtLeast)
+    {
+        size_t Pending = Buffered();
+        if (m_ReadStart)
+        {
+            //
+            // Only a partial APDU header or the like is ever left over, so
+            // moving it to the front is cheap.
+            //
+            std::memmove(m_ReadBuffer.data(), m_ReadBuffer.data() + m_ReadStart, Pending);
+            m_ReadStart = 0;
+            m_ReadEnd = Pending;
+        }
+        size_t Required = std::max(ReadAtLeast, Pending + READ_CHUNK_SIZE);
+        if (m_ReadBuffer.size() < Required)
+        {
+            m_ReadBuffer.resize(Required);
         }
     }
 
@@ -227,7 +306,7 @@ namespace EPRI
                 m_Acceptor.bind(EndPoint);
                 m_Acceptor.listen();
                 m_Acceptor.async_accept(m_Socket, 
-                    std::bind(&LinuxTCPSocket::ASIO_Accept_Handler, this, std::placeholders::_1));
+                    LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Accept_Handler, this, std::placeholders::_1)));
             }
             else 
             {
@@ -242,7 +321,7 @@ namespace EPRI
                 
                 m_Socket.close();
                 m_Resolver.async_resolve(Query, 
-                    std::bind(&LinuxTCPSocket::ASIO_Resolver_Handler, this, std::placeholders::_1, std::placeholders::_2));
+                    LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Resolver_Handler, this, std::placeholders::_1, std::placeholders::_2)));
             }
 		
         }
@@ -264,6 +343,11 @@ namespace EPRI
     {
         return m_Options;
     }
+
+    asio::io_service::strand& LinuxTCPSocket::GetStrand()
+    {
+        return m_Strand;
+    }
     
     ERROR_TYPE LinuxTCPSocket::Write(const DLMSVector& Data, bool Asynchronous /*= false*/)
     {
@@ -276,8 +360,11 @@ namespace EPRI
         {
             if (m_Write)
             {
-                asio::async_write(m_Socket, asio::buffer(Data.GetBytes()), 
-                    std::bind(&LinuxTCPSocket::ASIO_Write_Handler, this, std::placeholders::_1, std::placeholders::_2));
+                {
+                    std::lock_guard<std::mutex> Lock(m_WriteMutex);
+                    m_WriteQueue.emplace_back(Data.GetBytes());
+                }
+                StartWrite();
             }
         }
         else
@@ -307,22 +394,43 @@ namespace EPRI
         
         if (!pData /* Asynchronous */)
         {
+            size_t Needed = std::max<size_t>(ReadAtLeast, 1);
+            if (Buffered() >= Needed)
+            {
+                LinuxScheduler::PostTo(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Read_Handler, this, asio::error_code(), 0, ReadAtLeast));
+                return SUCCESSFUL;
+            }
+            PrepareReadBuffer(ReadAtLeast);
             asio::async_read(m_Socket,
-                m_ReadBuffer,
-                asio::transfer_exactly(ReadAtLeast ? ReadAtLeast : 1), 
-                std::bind(&LinuxTCPSocket::ASIO_Read_Handler, this, std::placeholders::_1, std::placeholders::_2));
+                asio::buffer(m_ReadBuffer.data() + m_ReadEnd, m_ReadBuffer.size() - m_ReadEnd),
+                asio::transfer_at_least(Needed - Buffered()),
+                LinuxScheduler::Wrap(m_Strand, std::bind(&LinuxTCPSocket::ASIO_Read_Handler, this, std::placeholders::_1, std::placeholders::_2,
+                    ReadAtLeast)));
         }
         else
         {
+            size_t           BufferedBytes = Buffered();
             size_t           ActualBytes = m_Socket.available();
-            if (0 == ActualBytes)
+            if (0 == ActualBytes && 0 == BufferedBytes)
             {
                 return !SUCCESSFUL;
             }
             asio::error_code ErrorCode;
-            uint8_t *        pAppend = &(*pData)[pData->AppendExtra(ActualBytes)];
+            //
+            // Anything left over from an asynchronous read comes first.
+            //
+            uint8_t *        pAppend = &(*pData)[pData->AppendExtra(BufferedBytes + ActualBytes)];
+            if (BufferedBytes)
+            {
+                std::memcpy(pAppend, m_ReadBuffer.data() + m_ReadStart, BufferedBytes);
+                m_ReadStart = m_ReadEnd = 0;
+                pAppend += BufferedBytes;
+            }
 
-            ActualBytes = m_Socket.read_some(asio::buffer(pAppend, ActualBytes), ErrorCode);
+            if (ActualBytes)
+            {
+                ActualBytes = m_Socket.read_some(asio::buffer(pAppend, ActualBytes), ErrorCode);
+            }
             //
             // Handle TCP Disconnection
             //
@@ -344,7 +452,7 @@ namespace EPRI
             }
             if (pActualBytes)
             {
-                *pActualBytes = ActualBytes;
+                *pActualBytes = BufferedBytes + ActualBytes;
             }
         }
         return RetVal;  
@@ -352,19 +460,26 @@ namespace EPRI
 
     bool LinuxTCPSocket::AppendAsyncReadResult(DLMSVector * pData, size_t ReadAtLeast /*= 0*/)
     {
-        std::istream Stream(&m_ReadBuffer);
+        size_t Available = Buffered();
         if (0 == ReadAtLeast)
         {
-            Stream.seekg(0, Stream.end);
-            ReadAtLeast = Stream.tellg();
-            Stream.seekg(0, Stream.beg);
+            ReadAtLeast = Available;
+        }
+        if (ReadAtLeast > Available || 0 == ReadAtLeast)
+        {
+            return false;
         }
         uint8_t * pBuffer = &(*pData)[pData->AppendExtra(ReadAtLeast)];
-        Stream.read((char *)pBuffer, ReadAtLeast);
+        std::memcpy(pBuffer, m_ReadBuffer.data() + m_ReadStart, ReadAtLeast);
+        m_ReadStart += ReadAtLeast;
+        if (m_ReadStart == m_ReadEnd)
+        {
+            m_ReadStart = m_ReadEnd = 0;
+        }
 
         Base()->GetDebug()->TRACE_BUFFER("IR", pBuffer, ReadAtLeast);
         
-        return static_cast<bool>(Stream);
+        return true;
     }
     
     
@@ -378,6 +493,9 @@ namespace EPRI
     ERROR_TYPE LinuxTCPSocket::Close()
     {
         m_Socket.close();
+        m_ReadStart = m_ReadEnd = 0;
+        std::lock_guard<std::mutex> Lock(m_WriteMutex);
+        m_WriteQueue.clear();
         return SUCCESSFUL;
     }
     
@@ -73,8 +73,11 @@
 #pragma once
 
 #include <asio.hpp>
+#include <deque>
 #include <memory>
 #include <list>
+#include <mutex>
+#include <vector>
 
 #include "ISocket.h"
 
@@ -93,6 +96,11 @@ namespace EPRI
         
         IIP::Options GetOptions();
         //
+        // All handlers for this connection run through this strand, so the
+        // engine on top of it is never entered from two threads at once.
+        //
+        asio::io_service::strand& GetStrand();
+        //
         // ISocket
         //
         virtual ERROR_TYPE Open(const char * DestinationAddress = nullptr, int Port = DEFAULT_DLMS_PORT);
@@ -114,12 +122,31 @@ namespace EPRI
         void ASIO_Resolver_Handler(const asio::error_code& Error, asio::ip::tcp::resolver::iterator it);
         void ASIO_Connect_Handler(const asio::error_code& Error, asio::ip::tcp::resolver::iterator it);
         void ASIO_Write_Handler(const asio::error_code& Error, size_t BytesTransferred);
-        void ASIO_Read_Handler(const asio::error_code& Error, size_t BytesTransferred);
+        void ASIO_Read_Handler(const asio::error_code& Error, size_t BytesTransferred, size_t ReadAtLeast);
+        size_t Buffered() const;
+        void PrepareReadBuffer(size_t ReadAtLeast);
+        void StartWrite();
+        //
+        // Received bytes are read straight into m_ReadBuffer in large chunks
+        // and live in [m_ReadStart, m_ReadEnd) until they are appended.
+        //
+        static const size_t READ_CHUNK_SIZE = 4096;
 
         asio::ip::tcp::resolver         m_Resolver;
         asio::ip::tcp::acceptor         m_Acceptor;
         asio::ip::tcp::socket           m_Socket;
-        asio::streambuf                 m_ReadBuffer;
+        asio::io_service::strand        m_Strand;
+        std::vector<uint8_t>            m_ReadBuffer;
+        size_t                          m_ReadStart = 0;
+        size_t                          m_ReadEnd = 0;
+        //
+        // Outbound APDUs are copied into m_WriteQueue.  Whatever has queued
+        // up goes out as one gathered write; only one write is in flight.
+        //
+        using WriteBuffer = std::vector<uint8_t>;
+        std::mutex                      m_WriteMutex;
+        std::deque<WriteBuffer>         m_WriteQueue;
+        std::vector<WriteBuffer>        m_InFlight;
         IIP::Options                    m_Options;
         ConnectCallbackFunction         m_Connect;
         WriteCallbackFunction           m_Write;
@@ -146,6 +173,7 @@ namespace EPRI
         
         using             TCPSocketList = std::list<LinuxTCPSocket>;        
         TCPSocketList     m_TCPSockets;
+        std::mutex        m_Mutex;
         asio::io_service& m_IO;
     };
 	
@@ -0,0 +1,323 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "LinuxTimerWheel.h"
+
+namespace EPRI
+{
+    LinuxTimerWheel::LinuxTimerWheel(asio::io_service& IO) :
+        m_Timer(IO), m_Current(Now())
+    {
+    }
+
+    LinuxTimerWheel::~LinuxTimerWheel()
+    {
+        m_Timer.cancel();
+    }
+
+    uint64_t LinuxTimerWheel::Now()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void LinuxTimerWheel::Schedule(Entry * pEntry, uint64_t Expiry)
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        if (pEntry->m_ppHead)
+        {
+            Unlink(pEntry);
+        }
+        if (!m_Count)
+        {
+            //
+            // Nothing to step through while the wheel was empty.
+            //
+            m_Current = std::max(m_Current, Now());
+        }
+        LinuxScheduler::Strand * pStrand = LinuxScheduler::CurrentStrand();
+        if (pStrand && !(pEntry->m_pStrand && pEntry->m_pStrand->running_in_this_thread()))
+        {
+            //
+            // Strand implementations outlive the strand objects, so the copy
+            // stays valid after the connection that owns it is gone.
+            //
+            pEntry->m_pStrand = std::make_shared<LinuxScheduler::Strand>(*pStrand);
+        }
+        pEntry->m_Fired = false;
+        pEntry->m_Expiry = std::max(Expiry, m_Current + 1);
+        Insert(pEntry);
+        Arm();
+    }
+
+    void LinuxTimerWheel::Cancel(Entry * pEntry)
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        if (pEntry->m_ppHead)
+        {
+            Unlink(pEntry);
+        }
+    }
+
+    void LinuxTimerWheel::Insert(Entry * pEntry)
+    {
+        uint64_t Delta = pEntry->m_Expiry - m_Current;
+        unsigned Level = 0;
+        while (Level < LEVELS - 1 && Delta >= (uint64_t(1) << (SLOT_BITS * (Level + 1))))
+        {
+            ++Level;
+        }
+        //
+        // Beyond the top level the entry waits in the furthest slot and is
+        // re-inserted each time that slot cascades.
+        //
+        uint64_t Slotted = std::min(pEntry->m_Expiry,
+            m_Current + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1);
+        Entry ** ppHead = &m_Slots[Level][(Slotted >> (SLOT_BITS * Level)) & (SLOTS - 1)];
+        if (*ppHead)
+        {
+            pEntry->m_pNext = *ppHead;
+            pEntry->m_pPrevious = (*ppHead)->m_pPrevious;
+            pEntry->m_pPrevious->m_pNext = pEntry;
+            (*ppHead)->m_pPrevious = pEntry;
+        }
+        else
+        {
+            pEntry->m_pNext = pEntry->m_pPrevious = pEntry;
+            *ppHead = pEntry;
+        }
+        pEntry->m_ppHead = ppHead;
+        pEntry->m_Level = Level;
+        ++m_LevelCount[Level];
+        ++m_Count;
+    }
+
+    void LinuxTimerWheel::Unlink(Entry * pEntry)
+    {
+        if (*pEntry->m_ppHead == pEntry)
+        {
+            *pEntry->m_ppHead = (pEntry->m_pNext == pEntry) ? nullptr : pEntry->m_pNext;
+        }
+        pEntry->m_pPrevious->m_pNext = pEntry->m_pNext;
+        pEntry->m_pNext->m_pPrevious = pEntry->m_pPrevious;
+        pEntry->m_pNext = pEntry->m_pPrevious = nullptr;
+        pEntry->m_ppHead = nullptr;
+        --m_LevelCount[pEntry->m_Level];
+        --m_Count;
+    }
+
+    void LinuxTimerWheel::Advance(uint64_t To, Entry ** ppExpired)
+    {
+        while (m_Current < To && m_Count)
+        {
+            ++m_Current;
+            for (unsigned Level = 1; Level < LEVELS; ++Level)
+            {
+                if (m_Current & ((uint64_t(1) << (SLOT_BITS * Level)) - 1))
+                {
+                    break;
+                }
+                Cascade(Level);
+            }
+            Entry ** ppHead = &m_Slots[0][m_Current & (SLOTS - 1)];
+            while (*ppHead)
+            {
+                Entry * pEntry = *ppHead;
+                Unlink(pEntry);
+                pEntry->m_pNext = *ppExpired;
+                *ppExpired = pEntry;
+            }
+        }
+        m_Current = std::max(m_Current, To);
+    }
+
+    void LinuxTimerWheel::Cascade(unsigned Level)
+    {
+        Entry ** ppHead = &m_Slots[Level][(m_Current >> (SLOT_BITS * Level)) & (SLOTS - 1)];
+        Entry *  pList = *ppHead;
+        if (!pList)
+        {
+            return;
+        }
+        //
+        // Detach the whole slot first; entries still beyond the top level
+        // land back in it.
+        //
+        *ppHead = nullptr;
+        pList->m_pPrevious->m_pNext = nullptr;
+        while (pList)
+        {
+            Entry * pEntry = pList;
+            pList = pList->m_pNext;
+            pEntry->m_pNext = pEntry->m_pPrevious = nullptr;
+            pEntry->m_ppHead = nullptr;
+            --m_LevelCount[Level];
+            --m_Count;
+            Insert(pEntry);
+        }
+    }
+
+    void LinuxTimerWheel::Arm()
+    {
+        if (!m_Count)
+        {
+            return;
+        }
+        //
+        // Wake at the next occupied tick in this turn of the first level,
+        // otherwise when the lowest occupied level next cascades.
+        //
+        uint64_t Wake = (m_Current | (SLOTS - 1)) + 1;
+        if (m_LevelCount[0])
+        {
+            for (uint64_t Tick = m_Current + 1; Tick < Wake; ++Tick)
+            {
+                if (m_Slots[0][Tick & (SLOTS - 1)])
+                {
+                    Wake = Tick;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            for (unsigned Level = 1; Level < LEVELS; ++Level)
+            {
+                if (m_LevelCount[Level])
+                {
+                    uint64_t Span = uint64_t(1) << (SLOT_BITS * Level);
+                    Wake = (m_Current | (Span - 1)) + 1;
+                    break;
+                }
+            }
+        }
+        if (m_Armed && m_ArmedFor <= Wake)
+        {
+            return;
+        }
+        m_Armed = true;
+        m_ArmedFor = Wake;
+        m_Timer.expires_at(std::chrono::steady_clock::time_point(std::chrono::milliseconds(Wake)));
+        m_Timer.async_wait(std::bind(&LinuxTimerWheel::ASIO_Timer_Handler, this, std::placeholders::_1));
+    }
+
+    void LinuxTimerWheel::ASIO_Timer_Handler(const asio::error_code& Error)
+    {
+        if (asio::error::operation_aborted == Error)
+        {
+            return;
+        }
+        std::vector<std::pair<ExpiryFunction, std::shared_ptr<LinuxScheduler::Strand>>> Handlers;
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            Entry * pExpired = nullptr;
+            m_Armed = false;
+            Advance(Now(), &pExpired);
+            while (pExpired)
+            {
+                Entry * pEntry = pExpired;
+                pExpired = pEntry->m_pNext;
+                pEntry->m_pNext = nullptr;
+                pEntry->m_Fired = true;
+                if (pEntry->m_Handler)
+                {
+                    Handlers.emplace_back(pEntry->m_Handler, pEntry->m_pStrand);
+                }
+            }
+            Arm();
+        }
+        //
+        // Handlers may start or stop timers, so they run unlocked.
+        //
+        for (auto& Handler : Handlers)
+        {
+            if (Handler.second)
+            {
+                //
+                // The posted handler holds the strand copy it runs on.
+                //
+                std::shared_ptr<LinuxScheduler::Strand> pStrand = Handler.second;
+                ExpiryFunction Expired = Handler.first;
+                LinuxScheduler::PostTo(*pStrand, [pStrand, Expired]() { Expired(); });
+            }
+            else
+            {
+                Handler.first();
+            }
+        }
+    }
+
+}
@@ -0,0 +1,150 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "LinuxScheduler.h"
+
+namespace EPRI
+{
+    //
+    // Hierarchical timing wheel with a one millisecond tick, driven by a
+    // single steady_timer on the io_service.  Starting and cancelling a
+    // timer are O(1); expired timers get a callback instead of being polled.
+    // A timer started from a handler on a connection's strand calls back
+    // through that strand; any other timer calls back on whichever
+    // io_service thread serves the wheel.
+    //
+    class LinuxTimerWheel
+    {
+    public:
+        typedef std::function<void()> ExpiryFunction;
+        //
+        // Intrusive entry, embedded in whatever owns the timer.
+        //
+        struct Entry
+        {
+            Entry *           m_pPrevious = nullptr;
+            Entry *           m_pNext = nullptr;
+            Entry **          m_ppHead = nullptr;
+            unsigned          m_Level = 0;
+            uint64_t          m_Expiry = 0;
+            std::atomic<bool> m_Fired{false};
+            ExpiryFunction    m_Handler;
+            //
+            // A copy of the strand the timer was last started on.
+            //
+            std::shared_ptr<LinuxScheduler::Strand> m_pStrand;
+        };
+
+        static const unsigned LEVELS = 4;
+        static const unsigned SLOT_BITS = 6;
+        static const unsigned SLOTS = 1 << SLOT_BITS;
+
+        LinuxTimerWheel() = delete;
+        LinuxTimerWheel(asio::io_service& IO);
+        virtual ~LinuxTimerWheel();
+        //
+        // Milliseconds on the monotonic clock, as 64 bits so it never wraps.
+        //
+        static uint64_t Now();
+
+        void Schedule(Entry * pEntry, uint64_t Expiry);
+        void Cancel(Entry * pEntry);
+
+    private:
+        void Insert(Entry * pEntry);
+        void Unlink(Entry * pEntry);
+        void Advance(uint64_t To, Entry ** ppExpired);
+        void Cascade(unsigned Level);
+        void Arm();
+        void ASIO_Timer_Handler(const asio::error_code& Error);
+
+        asio::steady_timer m_Timer;
+        std::mutex         m_Mutex;
+        Entry *            m_Slots[LEVELS][SLOTS] = {};
+        size_t             m_LevelCount[LEVELS] = {};
+        uint64_t           m_Current;
+        size_t             m_Count = 0;
+        bool               m_Armed = false;
+        uint64_t           m_ArmedFor = 0;
+
+    };
+
+}
@@ -0,0 +1,974 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "LinuxWrapperSocket.h"
+#include "IBaseLibrary.h"
+#include "IScheduler.h"
+
+namespace EPRI
+{
+    namespace
+    {
+        const size_t  HEADER_SIZE = 8;
+        const uint8_t AARQ = 0x60;
+        const uint8_t USER_INFORMATION = 0xBE;
+        const uint8_t INITIATE_REQUEST = 0x01;
+        const uint8_t GET_REQUEST = 0xC0;
+        const uint8_t GET_RESPONSE = 0xC4;
+        const uint8_t GET_NORMAL = 1;
+        const uint8_t GET_NEXT = 2;
+        const uint8_t GET_WITH_DATABLOCK = 2;
+        const uint8_t GET_WITH_LIST = 3;
+        //
+        // Data-Access-Result values for failed block transfers.
+        //
+        const uint8_t LONG_GET_ABORTED = 15;
+        const uint8_t NO_LONG_GET_IN_PROGRESS = 16;
+        const uint8_t DATA_BLOCK_NUMBER_INVALID = 19;
+        //
+        // Class, instance and attribute of a Cosem-Attribute-Descriptor.
+        //
+        const size_t  DESCRIPTOR_SIZE = 9;
+        //
+        // All of a GET-Response-With-Datablock but its raw data: tag, choice,
+        // invoke-id, last-block, block-number, the raw-data choice and a
+        // length of up to three bytes.
+        //
+        const size_t  BLOCK_OVERHEAD = 12;
+
+        inline size_t FrameLength(const uint8_t * pHeader)
+        {
+            return HEADER_SIZE + ((size_t(pHeader[6]) << 8) | pHeader[7]);
+        }
+
+        inline bool IsFrame(const LinuxWrapperSocket::Frame& Data)
+        {
+            return Data.size() > HEADER_SIZE && FrameLength(Data.data()) == Data.size();
+        }
+
+        inline bool IsAPDU(const LinuxWrapperSocket::Frame& Data, uint8_t Tag, uint8_t Choice)
+        {
+            return Data.size() >= HEADER_SIZE + 3 && Tag == Data[HEADER_SIZE] && Choice == Data[HEADER_SIZE + 1];
+        }
+        //
+        // A frame between the same wPorts as Like, carrying APDU.
+        //
+        LinuxWrapperSocket::Frame MakeFrame(const LinuxWrapperSocket::Frame& Like, const LinuxWrapperSocket::Frame& APDU)
+        {
+            LinuxWrapperSocket::Frame RetVal(Like.begin(), Like.begin() + HEADER_SIZE);
+            RetVal[6] = uint8_t(APDU.size() >> 8);
+            RetVal[7] = uint8_t(APDU.size());
+            RetVal.insert(RetVal.end(), APDU.begin(), APDU.end());
+            return RetVal;
+        }
+        //
+        // A-XDR length and quantity fields.
+        //
+        void AppendLength(LinuxWrapperSocket::Frame * pData, size_t Length)
+        {
+            if (Length < 0x80)
+            {
+                pData->push_back(uint8_t(Length));
+                return;
+            }
+            uint8_t Bytes = 0;
+            for (size_t Rest = Length; Rest; Rest >>= 8)
+            {
+                ++Bytes;
+            }
+            pData->push_back(0x80 | Bytes);
+            while (Bytes--)
+            {
+                pData->push_back(uint8_t(Length >> (8 * Bytes)));
+            }
+        }
+
+        bool ParseLength(const uint8_t ** ppData, const uint8_t * pEnd, size_t * pLength)
+        {
+            if (*ppData >= pEnd)
+            {
+                return false;
+            }
+            uint8_t First = *(*ppData)++;
+            if (First < 0x80)
+            {
+                *pLength = First;
+                return true;
+            }
+            size_t Bytes = First & 0x7F;
+            if (Bytes > sizeof(size_t) || size_t(pEnd - *ppData) < Bytes)
+            {
+                return false;
+            }
+            *pLength = 0;
+            while (Bytes--)
+            {
+                *pLength = (*pLength << 8) | *(*ppData)++;
+            }
+            return true;
+        }
+
+        bool Skip(const uint8_t ** ppData, const uint8_t * pEnd, size_t Bytes)
+        {
+            if (size_t(pEnd - *ppData) < Bytes)
+            {
+                return false;
+            }
+            *ppData += Bytes;
+            return true;
+        }
+
+        bool SkipTypeDescription(const uint8_t ** ppData, const uint8_t * pEnd)
+        {
+            if (*ppData >= pEnd)
+            {
+                return false;
+            }
+            size_t Count;
+            switch (*(*ppData)++)
+            {
+            case 1:
+                //
+                // array: number of elements, then the element type
+                //
+                return Skip(ppData, pEnd, 2) && SkipTypeDescription(ppData, pEnd);
+            case 2:
+                if (!ParseLength(ppData, pEnd, &Count))
+                {
+                    return false;
+                }
+                while (Count--)
+                {
+                    if (!SkipTypeDescription(ppData, pEnd))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            default:
+                return true;
+            }
+        }
+        //
+        // Steps over one A-XDR encoded Data.
+        //
+        bool SkipData(const uint8_t ** ppData, const uint8_t * pEnd)
+        {
+            if (*ppData >= pEnd)
+            {
+                return false;
+            }
+            size_t Length;
+            switch (*(*ppData)++)
+            {
+            case 0:     // null-data
+                return true;
+            case 1:     // array
+            case 2:     // structure
+                if (!ParseLength(ppData, pEnd, &Length))
+                {
+                    return false;
+                }
+                while (Length--)
+                {
+                    if (!SkipData(ppData, pEnd))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            case 4:     // bit-string
+                return ParseLength(ppData, pEnd, &Length) && Skip(ppData, pEnd, (Length + 7) / 8);
+            case 9:     // octet-string
+            case 10:    // visible-string
+            case 12:    // utf8-string
+                return ParseLength(ppData, pEnd, &Length) && Skip(ppData, pEnd, Length);
+            case 19:    // compact-array
+                return SkipTypeDescription(ppData, pEnd) &&
+                    ParseLength(ppData, pEnd, &Length) && Skip(ppData, pEnd, Length);
+            case 3:     // boolean
+            case 13:    // bcd
+            case 15:    // integer
+            case 17:    // unsigned
+            case 22:    // enum
+                return Skip(ppData, pEnd, 1);
+            case 16:    // long
+            case 18:    // long-unsigned
+                return Skip(ppData, pEnd, 2);
+            case 5:     // double-long
+            case 6:     // double-long-unsigned
+            case 23:    // float32
+            case 27:    // time
+                return Skip(ppData, pEnd, 4);
+            case 26:    // date
+                return Skip(ppData, pEnd, 5);
+            case 20:    // long64
+            case 21:    // long64-unsigned
+            case 24:    // float64
+                return Skip(ppData, pEnd, 8);
+            case 25:    // date-time
+                return Skip(ppData, pEnd, 12);
+            default:
+                return false;
+            }
+        }
+        //
+        // Splits the items of a list APDU, starting at pData, into the APDUs
+        // of the matching Normal service.  Each item is whatever Step() skips.
+        //
+        template <typename StepFunction>
+        bool SplitList(const uint8_t * pData, const uint8_t * pEnd, uint8_t Tag,
+            const std::vector<uint8_t>& InvokeIDs, StepFunction Step,
+            std::vector<LinuxWrapperSocket::Frame> * pAPDUs)
+        {
+            size_t Count;
+            if (!ParseLength(&pData, pEnd, &Count) || !Count || Count != InvokeIDs.size())
+            {
+                return false;
+            }
+            for (size_t Index = 0; Index < Count; ++Index)
+            {
+                const uint8_t * pItem = pData;
+                if (!Step(&pData, pEnd))
+                {
+                    return false;
+                }
+                LinuxWrapperSocket::Frame APDU = { Tag, GET_NORMAL, InvokeIDs[Index] };
+                APDU.insert(APDU.end(), pItem, pData);
+                pAPDUs->push_back(std::move(APDU));
+            }
+            return pData == pEnd;
+        }
+
+        bool SkipDescriptor(const uint8_t ** ppData, const uint8_t * pEnd)
+        {
+            if (!Skip(ppData, pEnd, DESCRIPTOR_SIZE + 1))
+            {
+                return false;
+            }
+            //
+            // With access selection: the selector, then its parameters.
+            //
+            return !(*ppData)[-1] || (Skip(ppData, pEnd, 1) && SkipData(ppData, pEnd));
+        }
+
+        //
+        // The client-max-receive-pdu-size of an AARQ which is not ciphered:
+        // the last two bytes of the xDLMS InitiateRequest, which is carried
+        // in an OCTET STRING in the user-information.  Its BER lengths are
+        // encoded just as A-XDR ones.
+        //
+        bool ProposedAPDUSize(const LinuxWrapperSocket::Frame& Incoming, size_t * pSize)
+        {
+            const uint8_t * pData = Incoming.data() + HEADER_SIZE + 1;
+            const uint8_t * pEnd = Incoming.data() + Incoming.size();
+            size_t          Length;
+            if (!ParseLength(&pData, pEnd, &Length) || size_t(pEnd - pData) != Length)
+            {
+                return false;
+            }
+            while (pData < pEnd)
+            {
+                const uint8_t Component = *pData++;
+                if (!ParseLength(&pData, pEnd, &Length) || size_t(pEnd - pData) < Length)
+                {
+                    return false;
+                }
+                if (USER_INFORMATION == Component)
+                {
+                    const uint8_t * pInfoEnd = pData + Length;
+                    if (!Skip(&pData, pInfoEnd, 1) || pData[-1] != 0x04 ||
+                        !ParseLength(&pData, pInfoEnd, &Length) || size_t(pInfoEnd - pData) != Length ||
+                        Length < 3 || *pData != INITIATE_REQUEST)
+                    {
+                        return false;
+                    }
+                    *pSize = (size_t(pInfoEnd[-2]) << 8) | pInfoEnd[-1];
+                    return true;
+                }
+                pData += Length;
+            }
+            return false;
+        }
+        //
+        // The encoded size of the Data starting at pData, if its first bytes
+        // say so: only strings announce their length in bytes.
+        //
+        bool AnnouncedSize(const uint8_t * pData, const uint8_t * pEnd, size_t * pSize)
+        {
+            const uint8_t * pStart = pData;
+            size_t          Length;
+            if (pData >= pEnd)
+            {
+                return false;
+            }
+            switch (*pData++)
+            {
+            case 4:     // bit-string
+                if (!ParseLength(&pData, pEnd, &Length))
+                {
+                    return false;
+                }
+                Length = (Length + 7) / 8;
+                break;
+            case 9:     // octet-string
+            case 10:    // visible-string
+            case 12:    // utf8-string
+                if (!ParseLength(&pData, pEnd, &Length))
+                {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+            *pSize = size_t(pData - pStart) + Length;
+            return true;
+        }
+
+        void AppendBlockNumber(LinuxWrapperSocket::Frame * pData, uint32_t Block)
+        {
+            for (int Shift = 24; Shift >= 0; Shift -= 8)
+            {
+                pData->push_back(uint8_t(Block >> Shift));
+            }
+        }
+
+        uint32_t BlockNumber(const uint8_t * pData)
+        {
+            return (uint32_t(pData[0]) << 24) | (uint32_t(pData[1]) << 16) | (uint32_t(pData[2]) << 8) | pData[3];
+        }
+
+        bool SkipResult(const uint8_t ** ppData, const uint8_t * pEnd)
+        {
+            if (*ppData >= pEnd)
+            {
+                return false;
+            }
+            //
+            // Either data or a data-access-result.
+            //
+            return *(*ppData)++ ? Skip(ppData, pEnd, 1) : SkipData(ppData, pEnd);
+        }
+    }
+
+    const size_t LinuxWrapperSocket::DEFAULT_BLOCK_SIZE;
+
+    LinuxWrapperSocket::LinuxWrapperSocket(ISocket * pSocket) :
+        m_pSocket(pSocket),
+        m_pOwner(std::make_shared<LinuxWrapperSocket *>(this))
+    {
+        m_pSocket->RegisterReadHandler(
+            std::bind(&LinuxWrapperSocket::Socket_Read_Handler, this, std::placeholders::_1, std::placeholders::_2));
+        m_pSocket->RegisterWriteHandler(
+            std::bind(&LinuxWrapperSocket::Socket_Write_Handler, this, std::placeholders::_1, std::placeholders::_2));
+    }
+
+    LinuxWrapperSocket::~LinuxWrapperSocket()
+    {
+        m_pSocket->RegisterReadHandler(nullptr);
+        m_pSocket->RegisterWriteHandler(nullptr);
+    }
+
+    void LinuxWrapperSocket::BeginList()
+    {
+        m_Listing = true;
+    }
+
+    void LinuxWrapperSocket::EndList()
+    {
+        m_Listing = false;
+        std::vector<Frame>  Requests;
+        std::vector<size_t> Writes;
+        Requests.swap(m_ListRequests);
+        Writes.swap(m_ListWrites);
+        if (Requests.empty())
+        {
+            return;
+        }
+        if (1 == Requests.size())
+        {
+            Send(Requests.front(), Writes, m_ListAsynchronous);
+            return;
+        }
+        //
+        // The list goes out under the invoke-id of its first request; each
+        // Cosem-Attribute-Descriptor-With-Selection is encoded just as it is
+        // in a GET-Request-Normal.
+        //
+        const uint8_t        InvokeID = Requests.front()[HEADER_SIZE + 2];
+        Frame                APDU = { GET_REQUEST, GET_WITH_LIST, InvokeID };
+        std::vector<uint8_t> InvokeIDs;
+        AppendLength(&APDU, Requests.size());
+        for (const Frame& Request : Requests)
+        {
+            InvokeIDs.push_back(Request[HEADER_SIZE + 2]);
+            APDU.insert(APDU.end(), Request.begin() + HEADER_SIZE + 3, Request.end());
+        }
+        m_Lists[InvokeID] = InvokeIDs;
+        Send(MakeFrame(Requests.front(), APDU), Writes, m_ListAsynchronous);
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::Open(const char * DestinationAddress /*= nullptr*/, int Port /*= DEFAULT_DLMS_PORT*/)
+    {
+        Reset();
+        return m_pSocket->Open(DestinationAddress, Port);
+    }
+
+    LinuxWrapperSocket::ConnectCallbackFunction LinuxWrapperSocket::RegisterConnectHandler(ConnectCallbackFunction Callback)
+    {
+        return m_pSocket->RegisterConnectHandler(Callback);
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::Write(const DLMSVector& Data, bool Asynchronous /*= false*/)
+    {
+        const Frame& Bytes = Data.GetBytes();
+        if (IsFrame(Bytes))
+        {
+            if (m_Listing && IsAPDU(Bytes, GET_REQUEST, GET_NORMAL))
+            {
+                m_ListRequests.push_back(Bytes);
+                m_ListWrites.push_back(Bytes.size());
+                m_ListAsynchronous = Asynchronous;
+                return SUCCESSFUL;
+            }
+            if (m_ListPending && IsAPDU(Bytes, GET_RESPONSE, GET_NORMAL) &&
+                Bytes[HEADER_SIZE + 2] == m_ListResponse[2])
+            {
+                m_ListResponse.insert(m_ListResponse.end(), Bytes.begin() + HEADER_SIZE + 3, Bytes.end());
+                m_ListResponseWrites.push_back(Bytes.size());
+                if (--m_ListPending)
+                {
+                    return SUCCESSFUL;
+                }
+                std::vector<size_t> Writes;
+                Writes.swap(m_ListResponseWrites);
+                return SendResponse(MakeFrame(Bytes, m_ListResponse), Writes, Asynchronous);
+            }
+            if (IsAPDU(Bytes, GET_RESPONSE, GET_NORMAL) || IsAPDU(Bytes, GET_RESPONSE, GET_WITH_LIST))
+            {
+                return SendResponse(Bytes, std::vector<size_t>(1, Bytes.size()), Asynchronous);
+            }
+        }
+        return Send(Bytes, std::vector<size_t>(1, Bytes.size()), Asynchronous);
+    }
+
+    LinuxWrapperSocket::WriteCallbackFunction LinuxWrapperSocket::RegisterWriteHandler(WriteCallbackFunction Callback)
+    {
+        WriteCallbackFunction RetVal = m_Write;
+        m_Write = Callback;
+        return RetVal;
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::Read(DLMSVector * pData,
+        size_t ReadAtLeast /*= 0*/,
+        uint32_t TimeOutInMS /*= 0*/,
+        size_t * pActualBytes /*= nullptr*/)
+    {
+        if (!pData /* Asynchronous */)
+        {
+            m_ReadWanted = true;
+            m_ReadAtLeast = ReadAtLeast;
+            if (m_ReadyBytes >= std::max<size_t>(ReadAtLeast, 1))
+            {
+                //
+                // Never call back from inside Read().
+                //
+                std::weak_ptr<LinuxWrapperSocket *> Owner = m_pOwner;
+                Base()->GetScheduler()->Post(
+                    [Owner]()
+                    {
+                        std::shared_ptr<LinuxWrapperSocket *> pOwner = Owner.lock();
+                        if (pOwner)
+                        {
+                            (*pOwner)->NotifyReader();
+                        }
+                    });
+            }
+            else if (!m_Reading)
+            {
+                ReadFrame();
+            }
+            return SUCCESSFUL;
+        }
+        if (!m_ReadyBytes)
+        {
+            //
+            // Synchronous reads are not translated.
+            //
+            return m_pSocket->Read(pData, ReadAtLeast, TimeOutInMS, pActualBytes);
+        }
+        size_t Bytes = m_ReadyBytes;
+        AppendAsyncReadResult(pData, Bytes);
+        if (pActualBytes)
+        {
+            *pActualBytes = Bytes;
+        }
+        return SUCCESSFUL;
+    }
+
+    bool LinuxWrapperSocket::AppendAsyncReadResult(DLMSVector * pData, size_t ReadAtLeast /*= 0*/)
+    {
+        size_t Available = m_ReadyBytes;
+        if (0 == ReadAtLeast)
+        {
+            ReadAtLeast = Available;
+        }
+        if (ReadAtLeast > Available || 0 == ReadAtLeast)
+        {
+            return false;
+        }
+        uint8_t * pBuffer = &(*pData)[pData->AppendExtra(ReadAtLeast)];
+        while (ReadAtLeast)
+        {
+            const Frame& Front = m_Ready.front();
+            const size_t Bytes = std::min(ReadAtLeast, Front.size() - m_ReadyOffset);
+            pBuffer = std::copy(Front.begin() + m_ReadyOffset, Front.begin() + m_ReadyOffset + Bytes, pBuffer);
+            m_ReadyOffset += Bytes;
+            m_ReadyBytes -= Bytes;
+            ReadAtLeast -= Bytes;
+            if (m_ReadyOffset == Front.size())
+            {
+                m_Ready.pop_front();
+                m_ReadyOffset = 0;
+            }
+        }
+        return true;
+    }
+
+    LinuxWrapperSocket::ReadCallbackFunction LinuxWrapperSocket::RegisterReadHandler(ReadCallbackFunction Callback)
+    {
+        ReadCallbackFunction RetVal = m_Read;
+        m_Read = Callback;
+        return RetVal;
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::Close()
+    {
+        Reset();
+        return m_pSocket->Close();
+    }
+
+    LinuxWrapperSocket::CloseCallbackFunction LinuxWrapperSocket::RegisterCloseHandler(CloseCallbackFunction Callback)
+    {
+        return m_pSocket->RegisterCloseHandler(Callback);
+    }
+
+    bool LinuxWrapperSocket::IsConnected()
+    {
+        return m_pSocket->IsConnected();
+    }
+
+    void LinuxWrapperSocket::Socket_Read_Handler(ERROR_TYPE Error, size_t BytesAvailable)
+    {
+        if (SUCCESSFUL != Error)
+        {
+            m_Reading = false;
+            if (m_ReadWanted && m_Read)
+            {
+                m_ReadWanted = false;
+                m_Read(Error, 0);
+            }
+            return;
+        }
+        if (!m_ReadingBody)
+        {
+            m_pSocket->AppendAsyncReadResult(&m_Incoming, HEADER_SIZE);
+            size_t Body = FrameLength(m_Incoming.GetData()) - HEADER_SIZE;
+            if (Body)
+            {
+                m_ReadingBody = true;
+                m_pSocket->Read(nullptr, Body);
+                return;
+            }
+        }
+        else
+        {
+            m_pSocket->AppendAsyncReadResult(&m_Incoming, FrameLength(m_Incoming.GetData()) - HEADER_SIZE);
+        }
+        //
+        // Still reading until the frame is handled, so that nothing started
+        // from inside Received() reads over it.
+        //
+        Received(m_Incoming.GetBytes());
+        m_Reading = false;
+        NotifyReader();
+        if (m_ReadWanted && !m_Reading)
+        {
+            //
+            // Whatever arrived was handled here; keep reading for the caller.
+            //
+            ReadFrame();
+        }
+    }
+
+    void LinuxWrapperSocket::Socket_Write_Handler(ERROR_TYPE Error, size_t BytesWritten)
+    {
+        if (m_Outgoing.empty())
+        {
+            return;
+        }
+        Outgoing Written = std::move(m_Outgoing.front());
+        m_Outgoing.pop_front();
+        for (size_t Size : Written.m_Writes)
+        {
+            if (m_Write)
+            {
+                m_Write(Error, Size);
+            }
+        }
+    }
+
+    void LinuxWrapperSocket::Reset()
+    {
+        m_Ready.clear();
+        m_ReadyOffset = m_ReadyBytes = 0;
+        m_Incoming = DLMSVector();
+        m_Reading = m_ReadingBody = m_ReadWanted = false;
+        m_Outgoing.clear();
+        m_BlockSize = DEFAULT_BLOCK_SIZE;
+        m_Listing = false;
+        m_ListRequests.clear();
+        m_ListWrites.clear();
+        m_Lists.clear();
+        m_ListPending = 0;
+        m_ListResponse.clear();
+        m_ListResponseWrites.clear();
+        m_Sending.clear();
+        m_Receiving.clear();
+    }
+
+    void LinuxWrapperSocket::ReadFrame()
+    {
+        m_Reading = true;
+        m_ReadingBody = false;
+        m_Incoming = DLMSVector();
+        m_pSocket->Read(nullptr, HEADER_SIZE);
+    }
+
+    void LinuxWrapperSocket::Received(const Frame& Incoming)
+    {
+        std::vector<Frame> APDUs;
+        const uint8_t *    pEnd = Incoming.data() + Incoming.size();
+        if (IsAPDU(Incoming, GET_RESPONSE, GET_WITH_DATABLOCK))
+        {
+            ReceiveBlock(Incoming);
+            return;
+        }
+        if (IsAPDU(Incoming, GET_REQUEST, GET_NEXT))
+        {
+            SendNextBlock(Incoming);
+            return;
+        }
+        if (Incoming.size() > HEADER_SIZE && AARQ == Incoming[HEADER_SIZE])
+        {
+            //
+            // Blocks fill what the client takes; one too small to carry a
+            // block, or a ciphered proposal, leaves the default.
+            //
+            size_t APDUSize;
+            m_BlockSize = ProposedAPDUSize(Incoming, &APDUSize) && APDUSize > BLOCK_OVERHEAD ?
+                APDUSize - BLOCK_OVERHEAD : DEFAULT_BLOCK_SIZE;
+        }
+        if (IsAPDU(Incoming, GET_RESPONSE, GET_WITH_LIST))
+        {
+            std::map<uint8_t, std::vector<uint8_t>>::iterator it = m_Lists.find(Incoming[HEADER_SIZE + 2]);
+            if (it != m_Lists.end())
+            {
+                std::vector<uint8_t> InvokeIDs;
+                InvokeIDs.swap(it->second);
+                m_Lists.erase(it);
+                if (SplitList(Incoming.data() + HEADER_SIZE + 3, pEnd, GET_RESPONSE, InvokeIDs, SkipResult, &APDUs))
+                {
+                    for (const Frame& APDU : APDUs)
+                    {
+                        Deliver(MakeFrame(Incoming, APDU));
+                    }
+                    return;
+                }
+            }
+        }
+        else if (IsAPDU(Incoming, GET_REQUEST, GET_WITH_LIST) && !m_ListPending)
+        {
+            //
+            // Each request is answered under the list's own invoke-id, and
+            // the engine answers them in order.
+            //
+            const uint8_t  InvokeID = Incoming[HEADER_SIZE + 2];
+            const uint8_t * pData = Incoming.data() + HEADER_SIZE + 3;
+            size_t         Count;
+            if (ParseLength(&pData, pEnd, &Count) &&
+                SplitList(Incoming.data() + HEADER_SIZE + 3, pEnd, GET_REQUEST,
+                    std::vector<uint8_t>(Count, InvokeID), SkipDescriptor, &APDUs))
+            {
+                m_ListPending = Count;
+                m_ListResponse = { GET_RESPONSE, GET_WITH_LIST, InvokeID };
+                AppendLength(&m_ListResponse, Count);
+                m_ListResponseWrites.clear();
+                for (const Frame& APDU : APDUs)
+                {
+                    Deliver(MakeFrame(Incoming, APDU));
+                }
+                return;
+            }
+        }
+        Deliver(Incoming);
+    }
+
+    void LinuxWrapperSocket::Deliver(Frame Incoming)
+    {
+        m_ReadyBytes += Incoming.size();
+        m_Ready.push_back(std::move(Incoming));
+    }
+
+    void LinuxWrapperSocket::ReceiveBlock(const Frame& Incoming)
+    {
+        //
+        // invoke-id, last-block, block-number, then raw-data or a
+        // data-access-result
+        //
+        const uint8_t   InvokeID = Incoming[HEADER_SIZE + 2];
+        const uint8_t * pData = Incoming.data() + HEADER_SIZE + 3;
+        const uint8_t * pEnd = Incoming.data() + Incoming.size();
+        size_t          Length;
+        if (pEnd - pData < 6)
+        {
+            Abort(Incoming, InvokeID, LONG_GET_ABORTED);
+            return;
+        }
+        const bool      Last = pData[0];
+        const uint32_t  Block = BlockNumber(pData + 1);
+        BlockTransfer&  Transfer = m_Receiving[InvokeID];
+        pData += 5;
+        if (*pData++)
+        {
+            uint8_t Result = pData < pEnd ? *pData : uint8_t(LONG_GET_ABORTED);
+            Abort(Incoming, InvokeID, Result);
+            return;
+        }
+        if (Block != Transfer.m_Block + 1 ||
+            !ParseLength(&pData, pEnd, &Length) || size_t(pEnd - pData) != Length)
+        {
+            Abort(Incoming, InvokeID, LONG_GET_ABORTED);
+            return;
+        }
+        size_t Announced;
+        if (1 == Block && !m_Lists.count(InvokeID) && AnnouncedSize(pData, pEnd, &Announced))
+        {
+            //
+            // The first block of a string says how long the whole is.
+            //
+            Transfer.m_Raw.reserve(Announced);
+        }
+        Transfer.m_Raw.insert(Transfer.m_Raw.end(), pData, pEnd);
+        Transfer.m_Block = Block;
+        if (!Last)
+        {
+            Frame Next = { GET_REQUEST, GET_NEXT, InvokeID };
+            AppendBlockNumber(&Next, Block);
+            Send(MakeFrame(Incoming, Next), std::vector<size_t>(), true);
+            return;
+        }
+        //
+        // The raw data of a list is the list of results; of anything else,
+        // the data of a successful GET-Response-Normal.
+        //
+        Frame APDU = { GET_RESPONSE, GET_NORMAL, InvokeID };
+        if (m_Lists.count(InvokeID))
+        {
+            APDU[1] = GET_WITH_LIST;
+        }
+        else
+        {
+            APDU.push_back(0);
+        }
+        APDU.insert(APDU.end(), Transfer.m_Raw.begin(), Transfer.m_Raw.end());
+        m_Receiving.erase(InvokeID);
+        Received(MakeFrame(Incoming, APDU));
+    }
+
+    void LinuxWrapperSocket::SendNextBlock(const Frame& Incoming)
+    {
+        const uint8_t InvokeID = Incoming[HEADER_SIZE + 2];
+        std::map<uint8_t, BlockTransfer>::iterator it = m_Sending.find(InvokeID);
+        if (Incoming.size() != HEADER_SIZE + 7 || it == m_Sending.end())
+        {
+            Frame APDU = { GET_RESPONSE, GET_WITH_DATABLOCK, InvokeID, 1, 0, 0, 0, 0, 1, NO_LONG_GET_IN_PROGRESS };
+            Send(MakeFrame(Incoming, APDU), std::vector<size_t>(), true);
+            return;
+        }
+        if (BlockNumber(&Incoming[HEADER_SIZE + 3]) != it->second.m_Block)
+        {
+            Frame APDU = { GET_RESPONSE, GET_WITH_DATABLOCK, InvokeID, 1 };
+            AppendBlockNumber(&APDU, it->second.m_Block);
+            APDU.push_back(1);
+            APDU.push_back(DATA_BLOCK_NUMBER_INVALID);
+            m_Sending.erase(it);
+            Send(MakeFrame(Incoming, APDU), std::vector<size_t>(), true);
+            return;
+        }
+        SendBlock(it->second, InvokeID, std::vector<size_t>(), true);
+    }
+
+    void LinuxWrapperSocket::SendBlock(BlockTransfer& Transfer, uint8_t InvokeID,
+        std::vector<size_t> Writes, bool Asynchronous)
+    {
+        const size_t Length = std::min(m_BlockSize, Transfer.m_Raw.size() - Transfer.m_Offset);
+        const bool   Last = Transfer.m_Offset + Length == Transfer.m_Raw.size();
+        Frame        APDU = { GET_RESPONSE, GET_WITH_DATABLOCK, InvokeID, uint8_t(Last ? 1 : 0) };
+        APDU.reserve(BLOCK_OVERHEAD + Length);
+        AppendBlockNumber(&APDU, ++Transfer.m_Block);
+        APDU.push_back(0);
+        AppendLength(&APDU, Length);
+        APDU.insert(APDU.end(), Transfer.m_Raw.begin() + Transfer.m_Offset,
+            Transfer.m_Raw.begin() + Transfer.m_Offset + Length);
+        Transfer.m_Offset += Length;
+        Frame Outgoing = MakeFrame(Transfer.m_Like, APDU);
+        if (Last)
+        {
+            m_Sending.erase(InvokeID);
+        }
+        Send(Outgoing, Writes, Asynchronous);
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::SendResponse(const Frame& Outgoing, std::vector<size_t> Writes, bool Asynchronous)
+    {
+        //
+        // Only data is sent in blocks; a failed GET-Response-Normal is short.
+        //
+        const bool   Normal = GET_NORMAL == Outgoing[HEADER_SIZE + 1];
+        const size_t Skip = HEADER_SIZE + (Normal ? 4 : 3);
+        if (Outgoing.size() <= Skip + m_BlockSize || (Normal && Outgoing[HEADER_SIZE + 3]))
+        {
+            return Send(Outgoing, Writes, Asynchronous);
+        }
+        const uint8_t  InvokeID = Outgoing[HEADER_SIZE + 2];
+        BlockTransfer& Transfer = m_Sending[InvokeID];
+        Transfer = BlockTransfer();
+        Transfer.m_Like.assign(Outgoing.begin(), Outgoing.begin() + HEADER_SIZE);
+        Transfer.m_Raw.assign(Outgoing.begin() + Skip, Outgoing.end());
+        SendBlock(Transfer, InvokeID, Writes, Asynchronous);
+        return SUCCESSFUL;
+    }
+
+    void LinuxWrapperSocket::Abort(const Frame& Like, uint8_t InvokeID, uint8_t Result)
+    {
+        //
+        // Every request behind the transfer fails with Result.
+        //
+        m_Receiving.erase(InvokeID);
+        std::vector<uint8_t> InvokeIDs(1, InvokeID);
+        std::map<uint8_t, std::vector<uint8_t>>::iterator it = m_Lists.find(InvokeID);
+        if (it != m_Lists.end())
+        {
+            InvokeIDs.swap(it->second);
+            m_Lists.erase(it);
+        }
+        for (uint8_t Request : InvokeIDs)
+        {
+            Frame APDU = { GET_RESPONSE, GET_NORMAL, Request, 1, Result };
+            Deliver(MakeFrame(Like, APDU));
+        }
+    }
+
+    void LinuxWrapperSocket::NotifyReader()
+    {
+        if (m_ReadWanted && m_ReadyBytes >= std::max<size_t>(m_ReadAtLeast, 1))
+        {
+            m_ReadWanted = false;
+            if (m_Read)
+            {
+                m_Read(SUCCESSFUL, m_ReadAtLeast ? m_ReadAtLeast : m_ReadyBytes);
+            }
+        }
+    }
+
+    ERROR_TYPE LinuxWrapperSocket::Send(const Frame& Outgoing, std::vector<size_t> Writes, bool Asynchronous)
+    {
+        if (!Asynchronous)
+        {
+            return m_pSocket->Write(DLMSVector(Outgoing), false);
+        }
+        m_Outgoing.push_back({ std::move(Writes) });
+        ERROR_TYPE RetVal = m_pSocket->Write(DLMSVector(Outgoing), true);
+        if (SUCCESSFUL != RetVal)
+        {
+            m_Outgoing.pop_back();
+        }
+        return RetVal;
+    }
+
+}
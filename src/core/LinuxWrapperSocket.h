@@ -0,0 +1,230 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "ISocket.h"
+
+namespace EPRI
+{
+    //
+    // An ISocket which sits between a TCPWrapper and the socket underneath
+    // it and works on whole wrapper frames (IEC 62056-47).  It carries the
+    // GET service variants which the library's engines do not build or parse
+    // themselves:
+    //
+    //   - GET-Request-With-List.  On the client, GET-Request-Normal APDUs
+    //     written between BeginList() and EndList() go out as one
+    //     GET-Request-With-List, and the GET-Response-With-List is handed
+    //     back as one GET-Response-Normal per request.  On the server, a
+    //     GET-Request-With-List is handed up as GET-Request-Normal APDUs,
+    //     and their responses go back as one GET-Response-With-List.
+    //
+    //   - GET-Response-With-Datablock.  On the server, a GET response which
+    //     does not fit in the APDU size the client proposed in its AARQ goes
+    //     out one block at a time, the next block on each GET-Request-Next.
+    //     The engine hands down the whole response at once, so it is kept
+    //     and each block cut from it when asked for.  On the client, the
+    //     blocks are requested in turn and appended to one buffer, and the
+    //     engine is handed the whole response as if it had come in one APDU.
+    //
+    // Everything else passes through unchanged.  The socket underneath is
+    // not owned, and must have no read or write handlers of its own.
+    //
+    class LinuxWrapperSocket : public ISocket
+    {
+    public:
+        typedef std::vector<uint8_t> Frame;
+        //
+        // Raw data per block until an AARQ says how large an APDU the client
+        // takes; with its headers a block fits in 640 bytes.
+        //
+        static const size_t DEFAULT_BLOCK_SIZE = 512;
+
+        LinuxWrapperSocket() = delete;
+        LinuxWrapperSocket(ISocket * pSocket);
+        virtual ~LinuxWrapperSocket();
+        //
+        // Bundles the GET-Request-Normal APDUs written until EndList() into
+        // a single GET-Request-With-List.  A list of one goes out as it is.
+        //
+        void BeginList();
+        void EndList();
+        //
+        // ISocket
+        //
+        virtual ERROR_TYPE Open(const char * DestinationAddress = nullptr, int Port = DEFAULT_DLMS_PORT);
+        virtual ConnectCallbackFunction RegisterConnectHandler(ConnectCallbackFunction Callback);
+        virtual ERROR_TYPE Write(const DLMSVector& Data, bool Asynchronous = false);
+        virtual WriteCallbackFunction RegisterWriteHandler(WriteCallbackFunction Callback);
+        virtual ERROR_TYPE Read(DLMSVector * pData, size_t ReadAtLeast = 0,
+            uint32_t TimeOutInMS = 0,
+            size_t * pActualBytes = nullptr);
+        virtual bool AppendAsyncReadResult(DLMSVector * pData, size_t ReadAtLeast = 0);
+        virtual ReadCallbackFunction RegisterReadHandler(ReadCallbackFunction Callback);
+        virtual ERROR_TYPE Close();
+        virtual CloseCallbackFunction RegisterCloseHandler(CloseCallbackFunction Callback);
+        virtual bool IsConnected();
+
+    private:
+        //
+        // A frame on its way down, and the sizes of the writes from above
+        // which complete with it.
+        //
+        struct Outgoing
+        {
+            std::vector<size_t> m_Writes;
+        };
+        //
+        // A long GET response on either side of a block transfer.
+        //
+        struct BlockTransfer
+        {
+            Frame    m_Like;
+            Frame    m_Raw;
+            size_t   m_Offset = 0;
+            uint32_t m_Block = 0;
+        };
+
+        void Socket_Read_Handler(ERROR_TYPE Error, size_t BytesAvailable);
+        void Socket_Write_Handler(ERROR_TYPE Error, size_t BytesWritten);
+
+        void Reset();
+        void ReadFrame();
+        void Received(const Frame& Incoming);
+        void Deliver(Frame Incoming);
+        void ReceiveBlock(const Frame& Incoming);
+        void SendNextBlock(const Frame& Incoming);
+        void SendBlock(BlockTransfer& Transfer, uint8_t InvokeID, std::vector<size_t> Writes, bool Asynchronous);
+        ERROR_TYPE SendResponse(const Frame& Outgoing, std::vector<size_t> Writes, bool Asynchronous);
+        void Abort(const Frame& Like, uint8_t InvokeID, uint8_t Result);
+        void NotifyReader();
+        ERROR_TYPE Send(const Frame& Outgoing, std::vector<size_t> Writes, bool Asynchronous);
+
+        ISocket *               m_pSocket;
+        //
+        // Expires with this socket, so that a notification posted to the
+        // scheduler does nothing once the socket is gone.
+        //
+        std::shared_ptr<LinuxWrapperSocket *> m_pOwner;
+        WriteCallbackFunction   m_Write;
+        ReadCallbackFunction    m_Read;
+        //
+        // Frames read from below, after translation, waiting to be read; the
+        // first of them from m_ReadyOffset on.  Each is moved in whole and
+        // copied once, into the reader's buffer.
+        //
+        std::deque<Frame>       m_Ready;
+        size_t                  m_ReadyOffset = 0;
+        size_t                  m_ReadyBytes = 0;
+        DLMSVector              m_Incoming;
+        bool                    m_Reading = false;
+        bool                    m_ReadingBody = false;
+        bool                    m_ReadWanted = false;
+        size_t                  m_ReadAtLeast = 0;
+        std::deque<Outgoing>    m_Outgoing;
+        //
+        // Server side: the raw data per block for the current association.
+        //
+        size_t                  m_BlockSize = DEFAULT_BLOCK_SIZE;
+        //
+        // Client side: the requests being bundled, and the invoke-ids of the
+        // requests behind each list sent, by the list's invoke-id.
+        //
+        bool                    m_Listing = false;
+        bool                    m_ListAsynchronous = true;
+        std::vector<Frame>      m_ListRequests;
+        std::vector<size_t>     m_ListWrites;
+        std::map<uint8_t, std::vector<uint8_t>> m_Lists;
+        //
+        // Server side: the responses still to come for a list being
+        // answered, and those which have.
+        //
+        size_t                  m_ListPending = 0;
+        Frame                   m_ListResponse;
+        std::vector<size_t>     m_ListResponseWrites;
+        //
+        // Block transfers in progress, by invoke-id: responses being sent on
+        // the server, and being received on the client.
+        //
+        std::map<uint8_t, BlockTransfer> m_Sending;
+        std::map<uint8_t, BlockTransfer> m_Receiving;
+
+    };
+
+}
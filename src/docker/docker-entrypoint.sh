@@ -9,5 +9,14 @@ if [ -z "$2" ]; then
     echo "Error: must supply an IPv6 address to Metersim"
     exit 1
 fi
+if [ "$1" == "access-point" ]; then
+    # APsim's relay listens on port 4061, and this rule is the only way
+    # traffic reaches it: the HES keeps connecting to the meters on 4059,
+    # and without the rule those connections bypass the relay entirely.
+    # The AP's own port 4059 is its registration server and is left alone.
+    ip6tables -t nat -A PREROUTING -s "$2" -p tcp --dport 4059 \
+        -m addrtype ! --dst-type LOCAL -j REDIRECT --to-ports 4061 \
+        || echo "Warning: no relay redirect, the HES will reach the meters directly"
+fi
 taskrunner "$3" &
-exec "${program}" "$2" 
+exec "${program}" "$2" "${@:4}"
@@ -97,7 +97,9 @@ namespace EPRI
         case ATTR_TIME:
             {
                 std::time_t t = std::time(nullptr);
-                auto tm = std::localtime(&t);
+                // meters may share a process and be served from several threads
+                std::tm local;
+                auto tm = ::localtime_r(&t, &local);
                 std::vector<std::uint8_t> time{{ 
                     static_cast<std::uint8_t>((tm->tm_year + 1900) >> 8),
                     static_cast<std::uint8_t>((tm->tm_year + 1900) & 0xff),
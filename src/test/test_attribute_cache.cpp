@@ -0,0 +1,165 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "LinuxAttributeCache.h"
+
+using EPRI::LinuxAttributeCache;
+
+/// only classes with a time to live are cached
+static void uncached_class() {
+    LinuxAttributeCache cache;
+    std::string value;
+    cache.Store("m", 1, 1, "0-0:96.1.0*255", 2, "v");
+    assert(!cache.Find("m", 1, 1, "0-0:96.1.0*255", 2, &value));
+    assert(cache.Size() == 0 && cache.GetMisses() == 1);
+}
+
+/// once full, the least recently used entry makes way
+static void lru() {
+    LinuxAttributeCache cache{2};
+    cache.SetTTL(1, std::chrono::hours{1});
+    std::string value;
+    cache.Store("a", 1, 1, "0-0:96.1.0*255", 2, "A");
+    cache.Store("b", 1, 1, "0-0:96.1.0*255", 2, "B");
+    // touching a makes b the least recently used
+    assert(cache.Find("a", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "A");
+    cache.Store("c", 1, 1, "0-0:96.1.0*255", 2, "C");
+    assert(cache.Size() == 2);
+    assert(!cache.Find("b", 1, 1, "0-0:96.1.0*255", 2, &value));
+    assert(cache.Find("a", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "A");
+    assert(cache.Find("c", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "C");
+    // storing again refreshes the value without growing the cache
+    cache.Store("c", 1, 1, "0-0:96.1.0*255", 2, "C2");
+    assert(cache.Size() == 2);
+    assert(cache.Find("c", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "C2");
+    assert(cache.GetHits() == 4 && cache.GetMisses() == 1);
+}
+
+/// an entry is gone once its class's time to live has passed
+static void ttl() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(1, std::chrono::milliseconds{50});
+    cache.SetTTL(8, std::chrono::hours{1});
+    std::string value;
+    cache.Store("m", 1, 1, "0-0:96.1.0*255", 2, "short");
+    cache.Store("m", 1, 8, "0-0:1.0.0*255", 2, "long");
+    assert(cache.Find("m", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "short");
+    std::this_thread::sleep_for(std::chrono::milliseconds{60});
+    assert(!cache.Find("m", 1, 1, "0-0:96.1.0*255", 2, &value));
+    assert(cache.Size() == 1);
+    assert(cache.Find("m", 1, 8, "0-0:1.0.0*255", 2, &value) && value == "long");
+}
+
+/// a value is only found by the client which read it
+static void per_client() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(1, std::chrono::hours{1});
+    std::string value;
+    cache.Store("m", 1, 1, "0-0:96.1.0*255", 2, "management");
+    assert(!cache.Find("m", 16, 1, "0-0:96.1.0*255", 2, &value));
+    cache.Store("m", 16, 1, "0-0:96.1.0*255", 2, "public");
+    assert(cache.Find("m", 1, 1, "0-0:96.1.0*255", 2, &value) && value == "management");
+    assert(cache.Find("m", 16, 1, "0-0:96.1.0*255", 2, &value) && value == "public");
+}
+
+/// invalidation drops every attribute of one object, as read by every
+/// client, and nothing else
+static void invalidate() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(70, std::chrono::hours{1});
+    std::string value;
+    cache.Store("m", 1, 70, "0-0:96.3.10*255", 2, "x");
+    cache.Store("m", 1, 70, "0-0:96.3.10*255", 3, "y");
+    cache.Store("m", 16, 70, "0-0:96.3.10*255", 2, "v");
+    cache.Store("m", 1, 70, "0-0:96.3.11*255", 2, "z");
+    cache.Store("n", 1, 70, "0-0:96.3.10*255", 2, "w");
+    cache.Invalidate("m", 70, "0-0:96.3.10*255");
+    assert(cache.Size() == 2);
+    assert(!cache.Find("m", 16, 70, "0-0:96.3.10*255", 2, &value));
+    assert(!cache.Find("m", 1, 70, "0-0:96.3.10*255", 3, &value));
+    assert(cache.Find("m", 1, 70, "0-0:96.3.11*255", 2, &value));
+    assert(cache.Find("n", 1, 70, "0-0:96.3.10*255", 2, &value));
+}
+
+int main() {
+    uncached_class();
+    lru();
+    ttl();
+    per_client();
+    invalidate();
+}
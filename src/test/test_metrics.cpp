@@ -0,0 +1,167 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <string>
+
+#include "LinuxMetrics.h"
+
+using EPRI::LinuxHistogram;
+using EPRI::LinuxMetrics;
+using std::chrono::microseconds;
+
+/// every value up to 16us has a bucket of its own
+static void linear_buckets() {
+    LinuxHistogram h;
+    assert(h.Count() == 0 && h.Percentile(50) == 0 && h.Max() == 0 && h.Mean() == 0);
+    for (int us = 0; us < 16; ++us) {
+        h.Record(microseconds{us});
+    }
+    assert(h.Count() == 16);
+    assert(h.Percentile(50) == 7);
+    assert(h.Percentile(100) == 15);
+    assert(h.Max() == 15);
+    // negative durations count as zero
+    LinuxHistogram n;
+    n.Record(microseconds{-5});
+    assert(n.Count() == 1 && n.Max() == 0 && n.Percentile(100) == 0);
+}
+
+/// a value's bucket reports it to within 12.5%, and never below it
+static void bucket_bounds() {
+    for (uint64_t us = 16; us < (uint64_t(1) << 40); us += us / 3 + 1) {
+        LinuxHistogram h;
+        h.Record(microseconds{us});
+        // a larger maximum, so that the percentile is the bucket's bound
+        h.Record(microseconds{us * 16});
+        const uint64_t bound{h.Percentile(1)};
+        assert(bound >= us);
+        assert(bound <= us + us / 8);
+        assert(h.Percentile(100) == us * 16);
+    }
+}
+
+static void percentiles() {
+    LinuxHistogram h;
+    for (int us = 1; us <= 1000; ++us) {
+        h.Record(microseconds{us});
+    }
+    assert(h.Count() == 1000);
+    assert(h.Mean() == 500);
+    assert(h.Max() == 1000);
+    const uint64_t p50{h.Percentile(50)};
+    assert(p50 >= 500 && p50 <= 500 + 500 / 8);
+    const uint64_t p90{h.Percentile(90)};
+    assert(p90 >= 900 && p90 <= 900 + 900 / 8);
+    // never beyond the largest value recorded
+    const uint64_t p99{h.Percentile(99)};
+    assert(p99 >= 990 && p99 <= 1000);
+    assert(h.Percentile(0) == 1);
+}
+
+static void metrics() {
+    LinuxMetrics m;
+    m.Count(LinuxMetrics::OUTCOME_SUCCESS);
+    m.Count(LinuxMetrics::OUTCOME_SUCCESS);
+    m.Count(LinuxMetrics::OUTCOME_TIMEOUT);
+    assert(m.GetCount(LinuxMetrics::OUTCOME_SUCCESS) == 2);
+    assert(m.GetCount(LinuxMetrics::OUTCOME_TIMEOUT) == 1);
+    assert(m.GetCount(LinuxMetrics::OUTCOME_ABORT) == 0);
+    m.Record(LinuxMetrics::PHASE_CONNECT, microseconds{100});
+    assert(m.GetHistogram(LinuxMetrics::PHASE_CONNECT).Count() == 1);
+    m.RecordMeter("fast", microseconds{10}, true);
+    m.RecordMeter("slow\"one", microseconds{5000}, false);
+    m.RecordMeter("middle", microseconds{300}, true);
+    assert(m.GetHistogram(LinuxMetrics::PHASE_TOTAL).Count() == 3);
+    // the slowest meters come first, with their names escaped
+    const std::string json{m.ToJSON(2)};
+    const auto slow{json.find("\"slow\\\"one\"")};
+    const auto middle{json.find("\"middle\"")};
+    assert(slow != std::string::npos && middle != std::string::npos && slow < middle);
+    assert(json.find("\"fast\"") == std::string::npos);
+    assert(json.find("\"success\":2") != std::string::npos);
+    assert(json.find("\"process\":{}") != std::string::npos);
+    // the latest value of each gauge, in name order
+    m.SetGauge("b", 1);
+    m.SetGauge("a", 7);
+    m.SetGauge("b", 2);
+    assert(m.ToJSON().find("\"process\":{\"a\":7,\"b\":2}}") != std::string::npos);
+}
+
+int main() {
+    linear_buckets();
+    bucket_bounds();
+    percentiles();
+    metrics();
+}
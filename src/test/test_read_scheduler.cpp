@@ -0,0 +1,216 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ReadScheduler.h"
+
+using Clock = ReadScheduler::Clock;
+
+namespace {
+
+/// work which records what started and keeps its completions for later
+struct Recorder {
+    std::vector<std::string> started;
+    std::vector<ReadScheduler::Done> pending;
+
+    ReadScheduler::Work work() {
+        return [this](const std::string& meter, ReadScheduler::Done done) {
+            started.push_back(meter);
+            pending.push_back(done);
+        };
+    }
+
+    void finish_all() {
+        auto done{std::move(pending)};
+        pending.clear();
+        for (auto& d : done) {
+            d(true);
+        }
+    }
+};
+
+}
+
+/// no more jobs run at once through one access point than its concurrency
+static void concurrency_budget() {
+    ReadScheduler scheduler{ReadScheduler::Budget{2, 1000000}};
+    Recorder rec;
+    const auto later{Clock::now() + std::chrono::hours{1}};
+    for (const char* meter : {"a", "b", "c", "d", "e"}) {
+        scheduler.submit(meter, "ap1", ReadScheduler::Priority::interval, later, 10, rec.work());
+    }
+    scheduler.submit("x", "ap2", ReadScheduler::Priority::interval, later, 10, rec.work());
+    const auto now{Clock::now()};
+    scheduler.dispatch(now);
+    // two through ap1, and the other access point has a budget of its own
+    assert(rec.started.size() == 3);
+    assert(scheduler.in_flight() == 3 && scheduler.queued() == 3);
+    assert(scheduler.in_flight_by_ap().at("ap1") == 2);
+    rec.finish_all();
+    assert(scheduler.completed() == 3 && scheduler.in_flight() == 0);
+    scheduler.dispatch(now);
+    assert(rec.started.size() == 5);
+    rec.finish_all();
+    scheduler.dispatch(now);
+    assert(rec.started.size() == 6 && scheduler.queued() == 0);
+    rec.finish_all();
+    assert(scheduler.completed() == 6);
+}
+
+/// a job waits until its access point's byte budget has refilled
+static void bandwidth_budget() {
+    ReadScheduler scheduler{ReadScheduler::Budget{16, 1000}};
+    Recorder rec;
+    const auto later{Clock::now() + std::chrono::hours{1}};
+    scheduler.submit("a", "ap", ReadScheduler::Priority::interval, later, 600, rec.work());
+    scheduler.submit("b", "ap", ReadScheduler::Priority::interval, later, 600, rec.work());
+    const auto now{Clock::now()};
+    scheduler.dispatch(now);
+    assert(rec.started.size() == 1);
+    // 400 bytes left, and 100 more after a tenth of a second
+    scheduler.dispatch(now + std::chrono::milliseconds{100});
+    assert(rec.started.size() == 1);
+    scheduler.dispatch(now + std::chrono::milliseconds{250});
+    assert(rec.started.size() == 2);
+    rec.finish_all();
+}
+
+/// on-demand work overtakes interval work, and nothing of lower rank
+/// overtakes a job held back by the budget
+static void priority_order() {
+    ReadScheduler scheduler{ReadScheduler::Budget{1, 1000000}};
+    Recorder rec;
+    const auto later{Clock::now() + std::chrono::hours{1}};
+    scheduler.submit("interval", "ap", ReadScheduler::Priority::interval, later, 10, rec.work());
+    scheduler.submit("urgent", "ap", ReadScheduler::Priority::on_demand, later, 10, rec.work());
+    const auto now{Clock::now()};
+    scheduler.dispatch(now);
+    assert(rec.started == std::vector<std::string>{"urgent"});
+    rec.finish_all();
+    scheduler.dispatch(now);
+    assert(rec.started.back() == "interval");
+    rec.finish_all();
+}
+
+/// a job which could not start before its deadline is counted as missed
+static void missed_deadline() {
+    ReadScheduler scheduler{ReadScheduler::Budget{1, 1000000}};
+    Recorder rec;
+    const auto start{Clock::now()};
+    scheduler.submit("a", "ap", ReadScheduler::Priority::on_demand, start + std::chrono::hours{1}, 10, rec.work());
+    scheduler.submit("b", "ap", ReadScheduler::Priority::interval, start + std::chrono::seconds{1}, 10, rec.work());
+    const auto now{Clock::now()};
+    scheduler.dispatch(now);
+    assert(rec.started == std::vector<std::string>{"a"});
+    scheduler.dispatch(now + std::chrono::seconds{2});
+    assert(scheduler.missed() == 1 && scheduler.queued() == 0);
+    rec.finish_all();
+    scheduler.dispatch(now + std::chrono::seconds{2});
+    assert(rec.started.size() == 1);
+}
+
+/// recurring jobs come round once per interval, and retain drops them
+static void recurring() {
+    ReadScheduler scheduler{ReadScheduler::Budget{16, 1000000}};
+    Recorder rec;
+    const auto interval{std::chrono::seconds{10}};
+    assert(scheduler.schedule("m", "ap", ReadScheduler::Priority::interval, interval, 10, rec.work()));
+    assert(!scheduler.schedule("m", "ap", ReadScheduler::Priority::interval, interval, 10, rec.work()));
+    const auto now{Clock::now()};
+    // the first slot is somewhere within the first interval
+    scheduler.dispatch(now + interval);
+    assert(rec.started.size() == 1);
+    rec.finish_all();
+    scheduler.dispatch(now + interval);
+    assert(rec.started.size() == 1);
+    scheduler.dispatch(now + 2 * interval);
+    assert(rec.started.size() == 2);
+    rec.finish_all();
+    scheduler.retain({});
+    scheduler.dispatch(now + 4 * interval);
+    assert(rec.started.size() == 2);
+    const auto latency{scheduler.take_latency()};
+    assert(latency->Count() == 2);
+}
+
+int main() {
+    concurrency_budget();
+    bandwidth_budget();
+    priority_order();
+    missed_deadline();
+    recurring();
+}
@@ -0,0 +1,172 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LinuxRegistration.h"
+
+using EPRI::RegistrationMessage;
+using EPRI::RegistrationParser;
+
+static RegistrationMessage sample() {
+    RegistrationMessage msg{RegistrationMessage::DELTA, 7, 2};
+    msg.m_Changes.emplace_back(RegistrationMessage::ADD, "[fd00::1]:4059");
+    msg.m_Changes.emplace_back(RegistrationMessage::REMOVE, "fd00::2");
+    return msg;
+}
+
+static void check(const RegistrationMessage& got) {
+    const RegistrationMessage want{sample()};
+    assert(got.m_Type == want.m_Type);
+    assert(got.m_Sequence == want.m_Sequence);
+    assert(got.m_Payload == want.m_Payload);
+    assert(got.m_Changes == want.m_Changes);
+}
+
+/// a message fed a byte at a time comes out once, when its last byte arrives
+static void split_frames() {
+    std::vector<uint8_t> frame;
+    sample().Encode(&frame);
+    sample().Encode(&frame);
+    std::vector<RegistrationMessage> got;
+    RegistrationParser parser{[&got](const RegistrationMessage& msg) { got.push_back(msg); }};
+    const std::size_t half{frame.size() / 2};
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        assert(parser.Parse(&frame[i], 1));
+        assert(got.size() == (i + 1 < half ? 0u : i + 1 < frame.size() ? 1u : 2u));
+    }
+    check(got[0]);
+    check(got[1]);
+}
+
+/// a frame whose length cuts a change short is rejected
+static void truncated_change() {
+    std::vector<uint8_t> frame;
+    sample().Encode(&frame);
+    // drop the last address byte, and shorten the frame length to match
+    frame.pop_back();
+    frame[3] = static_cast<uint8_t>(frame[3] - 1);
+    bool called{false};
+    RegistrationParser parser{[&called](const RegistrationMessage&) { called = true; }};
+    assert(!parser.Parse(frame.data(), frame.size()));
+    assert(!called);
+}
+
+/// trailing bytes after the last change are rejected as well
+static void trailing_bytes() {
+    std::vector<uint8_t> frame;
+    sample().Encode(&frame);
+    frame.push_back(0);
+    frame[3] = static_cast<uint8_t>(frame[3] + 1);
+    RegistrationParser parser{[](const RegistrationMessage&) { assert(false); }};
+    assert(!parser.Parse(frame.data(), frame.size()));
+}
+
+/// a change count larger than the frame could hold is rejected before
+/// anything is reserved for it
+static void impossible_count() {
+    RegistrationMessage msg{RegistrationMessage::SNAPSHOT, 1, 0};
+    std::vector<uint8_t> frame;
+    msg.Encode(&frame);
+    frame[10] = frame[11] = frame[12] = frame[13] = 0xff;
+    RegistrationParser parser{[](const RegistrationMessage&) { assert(false); }};
+    assert(!parser.Parse(frame.data(), frame.size()));
+}
+
+static void oversized_frame() {
+    const uint32_t length{RegistrationMessage::MAX_FRAME_LENGTH + 1};
+    const uint8_t header[]{
+        static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+        static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    RegistrationParser parser{[](const RegistrationMessage&) { assert(false); }};
+    assert(!parser.Parse(header, sizeof header));
+}
+
+static void acks() {
+    std::vector<uint8_t> ack;
+    RegistrationMessage::EncodeAck(0x01020304, &ack);
+    assert(ack.size() == RegistrationMessage::ACK_LENGTH);
+    assert(RegistrationMessage::DecodeAck(ack.data()) == 0x01020304);
+}
+
+int main() {
+    split_frames();
+    truncated_change();
+    trailing_bytes();
+    impossible_count();
+    oversized_frame();
+    acks();
+}
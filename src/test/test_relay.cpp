@@ -0,0 +1,324 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+
+#undef NDEBUG
+#include <asio.hpp>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "LinuxAttributeCache.h"
+#include "LinuxRelay.h"
+
+using asio::ip::tcp;
+using EPRI::LinuxAttributeCache;
+using EPRI::LinuxRelay;
+using Frame = std::vector<uint8_t>;
+
+/// a wrapper frame from the src wPort to the dst wPort carrying apdu
+static Frame frame(uint16_t src, uint16_t dst, const Frame& apdu) {
+    Frame f{0, 1, uint8_t(src >> 8), uint8_t(src), uint8_t(dst >> 8), uint8_t(dst),
+        uint8_t(apdu.size() >> 8), uint8_t(apdu.size())};
+    f.insert(f.end(), apdu.begin(), apdu.end());
+    return f;
+}
+
+/// GET-Request-Normal for attribute 2 of the Data object 0-0:96.1.0*255
+static Frame get(uint8_t invoke) {
+    return {0xC0, 0x01, invoke, 0x00, 0x01, 0, 0, 96, 1, 0, 255, 0x02, 0x00};
+}
+
+/// GET-Response-Normal with the visible string "ok"
+static Frame data(uint8_t invoke) {
+    return {0xC4, 0x01, invoke, 0x00, 0x0A, 0x02, 'o', 'k'};
+}
+
+static void send(tcp::socket& socket, const Frame& f) {
+    asio::write(socket, asio::buffer(f));
+}
+
+/// runs the relay until a whole frame has arrived on socket, and reads it
+static Frame receive(asio::io_service& io, tcp::socket& socket) {
+    Frame f(8);
+    while (socket.available() < f.size()) {
+        io.poll();
+    }
+    asio::read(socket, asio::buffer(f));
+    const std::size_t length{std::size_t(f[6] << 8 | f[7])};
+    while (socket.available() < length) {
+        io.poll();
+    }
+    f.resize(f.size() + length);
+    asio::read(socket, asio::buffer(&f[8], length));
+    return f;
+}
+
+/// whether nothing arrives on socket while the relay runs for a while
+static bool quiet(asio::io_service& io, tcp::socket& socket) {
+    const auto until{std::chrono::steady_clock::now() + std::chrono::milliseconds{100}};
+    while (std::chrono::steady_clock::now() < until) {
+        io.poll();
+    }
+    return socket.available() == 0;
+}
+
+/// AARE with the given association result, 0 for accepted
+static Frame aare(uint8_t result) {
+    return {0x61, 0x05, 0xA2, 0x03, 0x02, 0x01, result};
+}
+
+/// A meter, a relay in front of it and three HES associations: a and b
+/// with the client wPorts 1 and 2 share one link to the meter, while c,
+/// with wPort 1 again, needs a second link.
+struct Bench {
+    explicit Bench(LinuxAttributeCache* cache = nullptr)
+        : meter_acceptor{io, tcp::endpoint(asio::ip::address_v6::loopback(), 0)}
+        , relay{io, LinuxRelay::Options(0, 60000, cache, meter_acceptor.local_endpoint())}
+        , a{io}
+        , b{io}
+        , c{io}
+        , meter{io}
+        , meter2{io}
+    {
+        const tcp::endpoint at{asio::ip::address_v6::loopback(), relay.GetPort()};
+        a.connect(at);
+        b.connect(at);
+        c.connect(at);
+        meter_acceptor.non_blocking(true);
+        send(a, frame(1, 1, {0x60}));
+        link(meter);
+        assert(receive(io, meter) == frame(1, 1, {0x60}));
+        send(b, frame(2, 1, {0x60}));
+        assert(receive(io, meter) == frame(2, 1, {0x60}));
+        send(c, frame(1, 1, {0x60}));
+        link(meter2);
+        assert(receive(io, meter2) == frame(1, 1, {0x60}));
+        send(meter, frame(1, 1, aare(0)));
+        send(meter, frame(1, 2, aare(0)));
+        send(meter2, frame(1, 1, aare(0)));
+        assert(receive(io, a) == frame(1, 1, aare(0)));
+        assert(receive(io, b) == frame(1, 2, aare(0)));
+        assert(receive(io, c) == frame(1, 1, aare(0)));
+    }
+
+    /// the relay only connects to the meter once it has a frame for it
+    void link(tcp::socket& socket) {
+        asio::error_code error{asio::error::would_block};
+        while (error == asio::error::would_block) {
+            io.poll();
+            meter_acceptor.accept(socket, error);
+        }
+        assert(!error);
+    }
+
+    asio::io_service io;
+    tcp::acceptor meter_acceptor;
+    LinuxRelay relay;
+    tcp::socket a;
+    tcp::socket b;
+    tcp::socket c;
+    tcp::socket meter;
+    tcp::socket meter2;
+};
+
+/// two identical reads in flight at once under the same client SAP share
+/// one meter transaction, and each association gets the answer under its
+/// own invoke-id
+static void coalesced() {
+    Bench bench;
+    send(bench.a, frame(1, 1, get(0xC1)));
+    assert(receive(bench.io, bench.meter) == frame(1, 1, get(0xC1)));
+    send(bench.c, frame(1, 1, get(0xC5)));
+    assert(quiet(bench.io, bench.meter2));
+    assert(bench.relay.GetCoalesced() == 1);
+    send(bench.meter, frame(1, 1, data(0xC1)));
+    assert(receive(bench.io, bench.a) == frame(1, 1, data(0xC1)));
+    assert(receive(bench.io, bench.c) == frame(1, 1, data(0xC5)));
+    // once answered, the next read goes to the meter again
+    send(bench.c, frame(1, 1, get(0xC6)));
+    assert(receive(bench.io, bench.meter2) == frame(1, 1, get(0xC6)));
+}
+
+/// reads under other client SAPs, or on an association the meter turned
+/// down, are never shared
+static void separate() {
+    Bench bench;
+    send(bench.a, frame(1, 1, get(0xC1)));
+    receive(bench.io, bench.meter);
+    send(bench.b, frame(2, 1, get(0xC2)));
+    assert(receive(bench.io, bench.meter) == frame(2, 1, get(0xC2)));
+
+    send(bench.c, frame(1, 1, {0x60}));
+    receive(bench.io, bench.meter2);
+    send(bench.meter2, frame(1, 1, aare(1)));
+    receive(bench.io, bench.c);
+    send(bench.c, frame(1, 1, get(0xC3)));
+    assert(receive(bench.io, bench.meter2) == frame(1, 1, get(0xC3)));
+    assert(bench.relay.GetCoalesced() == 0);
+}
+
+/// a read waiting on one which is answered in blocks is sent to the meter
+/// itself, as is one waiting on a read whose association went away
+static void released() {
+    Bench bench;
+    send(bench.a, frame(1, 1, get(0xC1)));
+    receive(bench.io, bench.meter);
+    send(bench.c, frame(1, 1, get(0xC2)));
+    assert(quiet(bench.io, bench.meter2));
+    const Frame block{0xC4, 0x02, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x0A};
+    send(bench.meter, frame(1, 1, block));
+    assert(receive(bench.io, bench.a) == frame(1, 1, block));
+    assert(receive(bench.io, bench.meter2) == frame(1, 1, get(0xC2)));
+
+    send(bench.a, frame(1, 1, get(0xC3)));
+    assert(quiet(bench.io, bench.meter));
+    bench.c.close();
+    assert(receive(bench.io, bench.meter) == frame(1, 1, get(0xC3)));
+}
+
+/// an invoke-id used again before its read was answered gives up on that
+/// read: the reads waiting on it are sent, and the new read passes through
+/// without being shared or cached
+static void reused() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(1, std::chrono::seconds{60});
+    Bench bench{&cache};
+    send(bench.a, frame(1, 1, get(0xC1)));
+    receive(bench.io, bench.meter);
+    send(bench.c, frame(1, 1, get(0xC5)));
+    assert(quiet(bench.io, bench.meter2));
+    send(bench.a, frame(1, 1, get(0xC1)));
+    assert(receive(bench.io, bench.meter2) == frame(1, 1, get(0xC5)));
+    assert(receive(bench.io, bench.meter) == frame(1, 1, get(0xC1)));
+    // the first answer belongs to either read, so it is not stored
+    send(bench.meter, frame(1, 1, data(0xC1)));
+    assert(receive(bench.io, bench.a) == frame(1, 1, data(0xC1)));
+    send(bench.meter, frame(1, 1, data(0xC1)));
+    assert(receive(bench.io, bench.a) == frame(1, 1, data(0xC1)));
+    // the read which c now makes is the one in flight
+    send(bench.a, frame(1, 1, get(0xC2)));
+    assert(quiet(bench.io, bench.meter));
+    assert(quiet(bench.io, bench.a));
+    send(bench.meter2, frame(1, 1, data(0xC5)));
+    assert(receive(bench.io, bench.c) == frame(1, 1, data(0xC5)));
+    assert(receive(bench.io, bench.a) == frame(1, 1, data(0xC2)));
+}
+
+/// a cached value is answered by the relay to the client SAP which read
+/// it, until a SET of its object
+static void cached() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(1, std::chrono::seconds{60});
+    Bench bench{&cache};
+    send(bench.a, frame(1, 1, get(0xC1)));
+    receive(bench.io, bench.meter);
+    send(bench.meter, frame(1, 1, data(0xC1)));
+    receive(bench.io, bench.a);
+    send(bench.c, frame(1, 1, get(0xC2)));
+    assert(receive(bench.io, bench.c) == frame(1, 1, data(0xC2)));
+    assert(quiet(bench.io, bench.meter2));
+    // another client SAP has its own values
+    send(bench.b, frame(2, 1, get(0xC3)));
+    assert(receive(bench.io, bench.meter) == frame(2, 1, get(0xC3)));
+    send(bench.meter, frame(1, 2, data(0xC3)));
+    receive(bench.io, bench.b);
+
+    const Frame set{0xC1, 0x01, 0xC4, 0x00, 0x01, 0, 0, 96, 1, 0, 255, 0x02, 0x00, 0x0A, 0x01, 'x'};
+    send(bench.a, frame(1, 1, set));
+    assert(receive(bench.io, bench.meter) == frame(1, 1, set));
+    send(bench.a, frame(1, 1, get(0xC5)));
+    assert(receive(bench.io, bench.meter) == frame(1, 1, get(0xC5)));
+}
+
+/// an association the meter turned down is never answered from the cache
+static void rejected() {
+    LinuxAttributeCache cache;
+    cache.SetTTL(1, std::chrono::seconds{60});
+    Bench bench{&cache};
+    send(bench.b, frame(2, 1, get(0xC1)));
+    receive(bench.io, bench.meter);
+    send(bench.meter, frame(1, 2, data(0xC1)));
+    receive(bench.io, bench.b);
+    send(bench.b, frame(2, 1, {0x60}));
+    receive(bench.io, bench.meter);
+    send(bench.meter, frame(1, 2, aare(1)));
+    receive(bench.io, bench.b);
+    send(bench.b, frame(2, 1, get(0xC2)));
+    assert(receive(bench.io, bench.meter) == frame(2, 1, get(0xC2)));
+}
+
+int main() {
+    coalesced();
+    separate();
+    released();
+    reused();
+    cached();
+    rejected();
+}
@@ -0,0 +1,138 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <asio.hpp>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "LinuxTimerWheel.h"
+
+using EPRI::LinuxTimerWheel;
+
+/// timers on every level fire in order, no earlier than their expiry and
+/// not much later, after cascading down from the level they started on
+static void cascading() {
+    asio::io_service io;
+    LinuxTimerWheel wheel{io};
+    // level 0 covers 64ms, level 1 4.096s, and level 2 262s
+    const uint64_t delays[]{5, 63, 64, 150, 1000, 4200};
+    const std::size_t count{sizeof delays / sizeof delays[0]};
+    LinuxTimerWheel::Entry entries[count];
+    std::vector<std::size_t> order;
+    std::vector<uint64_t> fired(count);
+    const uint64_t start{LinuxTimerWheel::Now()};
+    for (std::size_t i = 0; i < count; ++i) {
+        entries[i].m_Handler = [i, &order, &fired]() {
+            order.push_back(i);
+            fired[i] = LinuxTimerWheel::Now();
+        };
+        wheel.Schedule(&entries[i], start + delays[i]);
+    }
+    io.run();
+    assert(order.size() == count);
+    for (std::size_t i = 0; i < count; ++i) {
+        assert(order[i] == i);
+        assert(fired[i] >= start + delays[i]);
+        assert(fired[i] < start + delays[i] + 100);
+    }
+}
+
+/// a cancelled timer never fires, and a rescheduled one fires only at its
+/// new expiry
+static void cancel_and_reschedule() {
+    asio::io_service io;
+    LinuxTimerWheel wheel{io};
+    LinuxTimerWheel::Entry cancelled, moved, kept;
+    bool cancelled_fired{false};
+    uint64_t moved_fired{0};
+    bool kept_fired{false};
+    cancelled.m_Handler = [&cancelled_fired]() { cancelled_fired = true; };
+    moved.m_Handler = [&moved_fired]() { moved_fired = LinuxTimerWheel::Now(); };
+    kept.m_Handler = [&kept_fired]() { kept_fired = true; };
+    const uint64_t start{LinuxTimerWheel::Now()};
+    wheel.Schedule(&cancelled, start + 100);
+    wheel.Schedule(&moved, start + 20);
+    wheel.Schedule(&kept, start + 200);
+    wheel.Cancel(&cancelled);
+    wheel.Schedule(&moved, start + 300);
+    io.run();
+    assert(!cancelled_fired);
+    assert(kept_fired);
+    assert(moved_fired >= start + 300);
+}
+
+int main() {
+    cascading();
+    cancel_and_reschedule();
+}
@@ -0,0 +1,127 @@
+// ===========================================================================
+// Copyright (c) 2020, Electric Power Research Institute (EPRI)
+// All rights reserved.
+//
+// dlms-access-point ("this software") is licensed under BSD 3-Clause license.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// *  Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// *  Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// *  Neither the name of EPRI nor the names of its contributors may
+//    be used to endorse or promote products derived from this software without
+//    specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+// NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+// OF SUCH DAMAGE.
+//
+// This EPRI software incorporates work covered by the following copyright and permission
+// notices. You may not use these works except in compliance with their respective
+// licenses, which are provided below.
+//
+// These works are provided by the copyright holders and contributors "as is" and any express or
+// implied warranties, including, but not limited to, the implied warranties of merchantability
+// and fitness for a particular purpose are disclaimed.
+//
+// This software relies on the following libraries and licenses:
+//
+// ###########################################################################
+// Boost Software License, Version 1.0
+// ###########################################################################
+//
+// * asio v1.10.8 (https://sourceforge.net/projects/asio/files/)
+//
+// Boost Software License - Version 1.0 - August 17th, 2003
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#undef NDEBUG
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include "UplinkEncoder.h"
+
+/// a cycle is one JSON document, with every string escaped
+static void json() {
+    std::ostringstream out;
+    UplinkEncoder uplink{out};
+    uplink.begin();
+    uplink.add(MeterReading{"[fd00::1]:4059", "plain"});
+    uplink.add(MeterReading{"m2", std::string{"q\"b\\n\nt\tc\x01", 10}});
+    uplink.end();
+    assert(out.str() ==
+        "{\"meterdata\":[\n"
+        "{\"meter\":\"[fd00::1]:4059\",\"data\":\"plain\"},\n"
+        "{\"meter\":\"m2\",\"data\":\"q\\\"b\\\\n\\nt\\tc\\u0001\"}\n"
+        "]}\n");
+}
+
+/// an empty cycle is still a whole document
+static void empty() {
+    std::ostringstream out;
+    UplinkEncoder uplink{out};
+    uplink.begin();
+    uplink.end();
+    assert(out.str() == "{\"meterdata\":[\n]}\n");
+}
+
+/// binary records are written as each reading arrives, and a zero meter
+/// length ends the cycle
+static void binary() {
+    std::ostringstream out;
+    UplinkEncoder uplink{out, UplinkEncoder::Framing::binary, 16};
+    uplink.begin();
+    uplink.add(MeterReading{"ab", "xyz"});
+    assert(out.str() == std::string("\x00\x02\x00\x00\x00\x03" "abxyz", 11));
+    // larger than the initial capacity
+    const std::string big(1000, 'd');
+    uplink.add(MeterReading{"c", big});
+    uplink.end();
+    const std::string s{out.str()};
+    assert(s.size() == 11 + 6 + 1 + 1000 + 2);
+    assert(s.substr(11, 6) == std::string("\x00\x01\x00\x00\x03\xe8", 6));
+    assert(s.substr(17, 1) == "c" && s.substr(18, 1000) == big);
+    assert(s.substr(s.size() - 2) == std::string("\x00\x00", 2));
+}
+
+int main() {
+    json();
+    empty();
+    binary();
+}
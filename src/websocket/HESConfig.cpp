@@ -41,7 +41,80 @@ struct translator_between<std::string, HESConfig::payload>
 } // namespace property_tree
 } // namespace boost
 
-HESConfig::HESConfig(unsigned short portnum) {
+namespace {
+
+// a settings object, with anything it leaves out taken from base
+HESConfig::settings read_settings(const pt::ptree& tree, const HESConfig::settings& base) {
+    HESConfig::settings result;
+    result.payload_size = tree.get<HESConfig::payload>("payload_size", base.payload_size);
+    result.route_only = tree.get<bool>("route_only", base.route_only);
+    return result;
+}
+
+pt::ptree write_settings(const HESConfig::settings& settings) {
+    pt::ptree tree;
+    tree.put("payload_size", settings.payload_size);
+    tree.put("route_only", settings.route_only);
+    return tree;
+}
+
+// The AP and meter addresses contain dots and colons, so the per-AP and
+// per-meter entries are walked as children rather than looked up by path
+void read_entries(const pt::ptree& tree, const char* name, const HESConfig::settings& base,
+        std::map<std::string, HESConfig::settings>& entries) {
+    if (auto children = tree.get_child_optional(pt::ptree::path_type{name, '/'})) {
+        for (const auto& child : *children) {
+            entries[child.first] = read_settings(child.second, base);
+        }
+    }
+}
+
+void write_entries(pt::ptree& tree, const char* name,
+        const std::map<std::string, HESConfig::settings>& entries) {
+    if (entries.empty()) {
+        return;
+    }
+    pt::ptree children;
+    for (const auto& entry : entries) {
+        children.push_back(std::make_pair(entry.first, write_settings(entry.second)));
+    }
+    tree.put_child(pt::ptree::path_type{name, '/'}, children);
+}
+
+// parses the whole document before anything is published
+std::shared_ptr<HESConfig::snapshot> parse(const pt::ptree& tree) {
+    auto next{std::make_shared<HESConfig::snapshot>()};
+    next->defaults.payload_size = tree.get<HESConfig::payload>("hes.payload_size");
+    next->defaults.route_only = tree.get<bool>("hes.route_only");
+    read_entries(tree, "hes/aps", next->defaults, next->aps);
+    read_entries(tree, "hes/meters", next->defaults, next->meters);
+    return next;
+}
+
+pt::ptree unparse(const HESConfig::snapshot& config) {
+    pt::ptree tree;
+    tree.put("hes.payload_size", config.defaults.payload_size);
+    tree.put("hes.route_only", config.defaults.route_only);
+    write_entries(tree, "hes/aps", config.aps);
+    write_entries(tree, "hes/meters", config.meters);
+    return tree;
+}
+
+} // anonymous namespace
+
+const HESConfig::settings& HESConfig::snapshot::for_ap(const std::string& ap) const {
+    auto it{aps.find(ap)};
+    return it == aps.end() ? defaults : it->second;
+}
+
+const HESConfig::settings& HESConfig::snapshot::for_meter(const std::string& meter, const std::string& ap) const {
+    auto it{meters.find(meter)};
+    return it == meters.end() ? for_ap(ap) : it->second;
+}
+
+HESConfig::HESConfig(unsigned short portnum)
+    : current(std::make_shared<const snapshot>())
+{
     serverthread = std::thread(server, portnum, std::ref(*this));
 }
 
@@ -52,15 +125,13 @@ HESConfig::~HESConfig() {
 void HESConfig::load(const std::string& filename) {
     pt::ptree tree;
     pt::read_json(filename, tree);
-    payload_size = tree.get<payload>("hes.payload_size"); 
-    route_only = tree.get<bool>("hes.route_only"); 
+    publish(parse(tree));
 }
 
 void HESConfig::load(std::istream& json) {
     pt::ptree tree;
     pt::read_json(json, tree);
-    payload_size = tree.get<payload>("hes.payload_size"); 
-    route_only = tree.get<bool>("hes.route_only"); 
+    publish(parse(tree));
 }
 
 void HESConfig::load_from_string(std::string str) {
@@ -73,25 +144,40 @@ void HESConfig::load_from_string(std::string str) {
 }
 
 void HESConfig::save(const std::string& filename) const {
-    pt::ptree tree;
-    tree.put("hes.payload_size", payload_size);
-    tree.put("hes.route_only", route_only); 
-    pt::write_json(filename, tree);
+    pt::write_json(filename, unparse(*get()));
 }
 
 void HESConfig::save(std::ostream& json) const {
-    pt::ptree tree;
-    tree.put("hes.payload_size", payload_size);
-    tree.put("hes.route_only", route_only); 
-    pt::write_json(json, tree);
+    pt::write_json(json, unparse(*get()));
+}
+
+// Readers never take the lock: they copy the shared_ptr to the current
+// snapshot, which keeps that snapshot alive for as long as they use it
+std::shared_ptr<const HESConfig::snapshot> HESConfig::get() const {
+    return std::atomic_load(&current);
 }
 
 HESConfig::payload HESConfig::get_payload_size() const {
-    std::lock_guard<std::mutex> lk(m);
-    return payload_size;
+    return get()->defaults.payload_size;
 }
 
 bool HESConfig::get_route_only() const {
+    return get()->defaults.route_only;
+}
+
+void HESConfig::publish(std::shared_ptr<snapshot> next) {
+    std::lock_guard<std::mutex> lk(m);
+    next->version = get()->version + 1;
+    std::atomic_store(&current, std::shared_ptr<const snapshot>{std::move(next)});
+}
+
+void HESConfig::publish_metrics(std::string frame) {
+    auto published{std::make_shared<const std::string>(std::move(frame))};
+    std::lock_guard<std::mutex> lk(m);
+    metrics = std::move(published);
+}
+
+std::shared_ptr<const std::string> HESConfig::get_metrics() const {
     std::lock_guard<std::mutex> lk(m);
-    return route_only;
+    return metrics;
 }
@@ -1,13 +1,36 @@
 #ifndef HESCONFIG_H
 #define HESCONFIG_H
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <thread>
 #include <mutex>
 
 class HESConfig {
 public:
     enum class payload { small, medium, large };
+    // what applies to the meters read through one AP, or to one meter
+    struct settings {
+        payload payload_size = payload::small;
+        bool route_only = true;
+    };
+    // An immutable, versioned copy of the whole configuration.  A reload
+    // publishes a new snapshot; readers keep whichever one they took, and
+    // an old snapshot is freed once its last reader lets go of it.
+    struct snapshot {
+        uint64_t version = 0;
+        settings defaults;
+        std::map<std::string, settings> aps;
+        std::map<std::string, settings> meters;
+
+        // the AP's own settings, else the defaults
+        const settings& for_ap(const std::string& ap) const;
+        // the meter's own settings, else its AP's, else the defaults
+        const settings& for_meter(const std::string& meter, const std::string& ap) const;
+    };
+
     HESConfig(unsigned short portnum = 4060);
     ~HESConfig();
 
@@ -16,12 +39,21 @@ public:
     void load_from_string(std::string str);
     void save(const std::string &filename) const;
     void save(std::ostream &json) const;
+    // the current snapshot; never blocks, so it may be called per meter
+    std::shared_ptr<const snapshot> get() const;
     payload get_payload_size() const;
     bool get_route_only() const;
+    // the HES publishes a serialized metrics frame which the websocket
+    // server pushes, unchanged, to every subscribed client
+    void publish_metrics(std::string frame);
+    std::shared_ptr<const std::string> get_metrics() const;
 private:
+    void publish(std::shared_ptr<snapshot> next);
+
+    // serializes writers only; readers go through current
     mutable std::mutex m;
-    payload payload_size = payload::small;
-    bool route_only = true;
+    std::shared_ptr<const snapshot> current;
+    std::shared_ptr<const std::string> metrics;
     std::thread serverthread;
 };
 
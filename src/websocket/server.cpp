@@ -74,7 +74,9 @@
 #include "server.h"
 #include "HESConfig.h"
 
+#include <boost/asio/post.hpp>
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -93,10 +95,11 @@ static void fail(boost::system::error_code ec, char const* what) {
 }
 
 // Take ownership of the socket
-session::session(tcp::socket socket, HESConfig& cfg)
+session::session(tcp::socket socket, HESConfig& cfg, metrics_feed& feed)
     : ws(std::move(socket))
     , strand(ws.get_executor())
     , cfg(cfg)
+    , feed(feed)
 { }
 
 // Start the asynchronous operation
@@ -144,22 +147,61 @@ void session::on_read(boost::system::error_code ec, std::size_t bytes_transferre
     boost::ignore_unused(bytes_transferred);
 
     if (ec == websocket::error::closed) {
+        feed.unsubscribe(this);
         return;
     }
 
     if (ec) {
         fail(ec, "read");
+        feed.unsubscribe(this);
+        return;
     }
 
-    // Echo the message
-    ws.text(ws.got_text());
-    try {
-        cfg.load_from_string(boost::beast::buffers_to_string(buffer.data()));
-    } catch (...) {
-        std::cerr << "Error loading configuration from string\n";
+    auto message{std::make_shared<const std::string>(boost::beast::buffers_to_string(buffer.data()))};
+    buffer.consume(buffer.size());
+    if (*message == "{subscribe:metrics}") {
+        feed.subscribe(shared_from_this());
+    } else if (*message == "{unsubscribe:metrics}") {
+        feed.unsubscribe(this);
+    } else {
+        // Echo the message
+        try {
+            cfg.load_from_string(*message);
+        } catch (...) {
+            std::cerr << "Error loading configuration from string\n";
+        }
+        send(message);
     }
+
+    // Do another read
+    do_read();
+}
+
+// Queue a message; replies and pushed frames share the one write chain
+void session::send(std::shared_ptr<const std::string> message) {
+    outbox.push_back(std::move(message));
+    if (outbox.size() == 1) {
+        do_write();
+    }
+}
+
+// Called by the feed; a client which has not yet taken the previous frame
+// skips this one rather than building up a queue
+void session::push(std::shared_ptr<const std::string> frame) {
+    boost::asio::post(
+        strand,
+        [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            if (self->outbox.empty()) {
+                self->send(std::move(frame));
+            }
+        }
+    );
+}
+
+void session::do_write() {
+    ws.text(true);
     ws.async_write(
-        buffer.data(),
+        boost::asio::buffer(*outbox.front()),
         boost::asio::bind_executor(
             strand,
             std::bind(
@@ -180,22 +222,83 @@ void session::on_write(boost::system::error_code ec, std::size_t bytes_transferr
         return;
     }
 
-    // Clear the buffer
-    buffer.consume(buffer.size());
+    outbox.pop_front();
+    if (!outbox.empty()) {
+        do_write();
+    }
+}
 
-    // Do another read
-    do_read();
+//------------------------------------------------------------------------------
+
+// The server runs on a single thread, so the subscriber list needs no lock
+metrics_feed::metrics_feed(HESConfig& cfg, boost::asio::io_context& ioc)
+    : cfg(cfg)
+    , timer(ioc)
+{ }
+
+void metrics_feed::run() {
+    do_tick();
+}
+
+void metrics_feed::subscribe(const std::shared_ptr<session>& s) {
+    unsubscribe(s.get());
+    subscribers.emplace_back(s);
+    // a new subscriber gets the current frame straight away
+    if (last) {
+        s->push(last);
+    }
+}
+
+void metrics_feed::unsubscribe(const session* s) {
+    subscribers.erase(
+        std::remove_if(subscribers.begin(), subscribers.end(),
+            [s](const std::weak_ptr<session>& w) {
+                auto sp{w.lock()};
+                return !sp || sp.get() == s;
+            }),
+        subscribers.end());
+}
+
+void metrics_feed::do_tick() {
+    static const std::chrono::seconds push_interval{1};
+    timer.expires_after(push_interval);
+    timer.async_wait(
+        std::bind(
+            &metrics_feed::on_tick,
+            shared_from_this(),
+            std::placeholders::_1
+        )
+    );
 }
 
+void metrics_feed::on_tick(boost::system::error_code ec) {
+    if (ec) {
+        fail(ec, "metrics");
+        return;
+    }
+    // only push when the HES has published something new
+    auto frame{cfg.get_metrics()};
+    if (frame && frame != last) {
+        last = frame;
+        for (const auto& w : subscribers) {
+            if (auto s{w.lock()}) {
+                s->push(frame);
+            }
+        }
+    }
+    do_tick();
+}
 
 //------------------------------------------------------------------------------
 
 // Accepts incoming connections and launches the sessions
 listener::listener(
     HESConfig& cfg,
+    metrics_feed& feed,
     boost::asio::io_context& ioc,
     tcp::endpoint endpoint)
     : cfg(cfg)
+    , feed(feed)
     , acceptor(ioc)
     , sock(ioc)
 {
@@ -254,7 +357,7 @@ void listener::on_accept(boost::system::error_code ec) {
         fail(ec, "accept");
     } else {
         // Create the session and run it
-        std::make_shared<session>(std::move(sock), cfg)->run();
+        std::make_shared<session>(std::move(sock), cfg, feed)->run();
     }
 
     // Accept another connection
@@ -263,7 +366,9 @@ void listener::on_accept(boost::system::error_code ec) {
 
 void server(unsigned short port, HESConfig& cfg) {
     boost::asio::io_context ioc;
-    std::make_shared<listener>(cfg, ioc, tcp::endpoint{boost::asio::ip::tcp::v6(), port})->run();
+    auto feed{std::make_shared<metrics_feed>(cfg, ioc)};
+    feed->run();
+    std::make_shared<listener>(cfg, *feed, ioc, tcp::endpoint{boost::asio::ip::tcp::v6(), port})->run();
     ioc.run();
 }
 
@@ -78,39 +78,72 @@
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <deque>
 #include <memory>
+#include <string>
+#include <vector>
 
 //------------------------------------------------------------------------------
 
-// Echoes back all received WebSocket messages
+class metrics_feed;
+
+// Loads each received message as the HES configuration and echoes it back;
+// a client which sends {subscribe:metrics} also gets the HES metrics pushed
 class session : public std::enable_shared_from_this<session> {
     boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws;
     boost::asio::strand<boost::asio::io_context::executor_type> strand;
     boost::beast::multi_buffer buffer;
     HESConfig& cfg;
+    metrics_feed& feed;
+    std::deque<std::shared_ptr<const std::string>> outbox;
 
 public:
     // Take ownership of the socket
-    explicit session(boost::asio::ip::tcp::socket socket, HESConfig& cfg);
+    explicit session(boost::asio::ip::tcp::socket socket, HESConfig& cfg, metrics_feed& feed);
 
     // Start the asynchronous operation
     void run();
     void on_accept(boost::system::error_code ec);
     void do_read();
     void on_read(boost::system::error_code ec, std::size_t bytes_transferred);
+    void send(std::shared_ptr<const std::string> message);
+    void push(std::shared_ptr<const std::string> frame);
+    void do_write();
     void on_write(boost::system::error_code ec, std::size_t bytes_transferred);
 };
 
 //------------------------------------------------------------------------------
 
+// Pushes the latest published metrics frame to every subscribed session at
+// a fixed rate.  The frame is serialized once and shared by all sessions.
+class metrics_feed : public std::enable_shared_from_this<metrics_feed> {
+    HESConfig& cfg;
+    boost::asio::steady_timer timer;
+    std::vector<std::weak_ptr<session>> subscribers;
+    std::shared_ptr<const std::string> last;
+
+public:
+    metrics_feed(HESConfig& cfg, boost::asio::io_context& ioc);
+
+    void run();
+    void subscribe(const std::shared_ptr<session>& s);
+    void unsubscribe(const session* s);
+    void do_tick();
+    void on_tick(boost::system::error_code ec);
+};
+
+//------------------------------------------------------------------------------
+
 // Accepts incoming connections and launches the sessions
 class listener : public std::enable_shared_from_this<listener> {
     HESConfig& cfg;
+    metrics_feed& feed;
     boost::asio::ip::tcp::acceptor acceptor;
     boost::asio::ip::tcp::socket sock;
 
 public:
-    listener(HESConfig& cfg, boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint);
+    listener(HESConfig& cfg, metrics_feed& feed, boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint);
 
     // Start accepting incoming connections
     void run();
@@ -73,12 +73,14 @@
 
 #include "taskrunner.h"
 
-#include <boost/process.hpp>
+#include <boost/asio/read.hpp>
 #include <boost/beast/core/buffers_to_string.hpp>
 #include <algorithm>
 #include <cstdlib>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -88,47 +90,215 @@ namespace websocket = boost::beast::websocket;  // from <boost/beast/websocket.h
 
 //------------------------------------------------------------------------------
 
-std::string fetchNetStats() {
-    using namespace boost::process;
-    ipstream pipe_stream;
-    child c("ifstat -j", std_out > pipe_stream);
-
+net_sample read_net_dev() {
+    net_sample sample;
+    sample.taken = std::chrono::steady_clock::now();
+    std::ifstream dev{"/proc/net/dev"};
     std::string line;
-    std::stringstream ss;
-
-    while (pipe_stream && std::getline(pipe_stream, line) && !line.empty())
-        ss << line << '\n';
-
-    c.wait();
-    return ss.str();
+    // the first two lines are column headings
+    std::getline(dev, line);
+    std::getline(dev, line);
+    while (std::getline(dev, line)) {
+        const auto colon{line.find(':')};
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name{line.substr(0, colon)};
+        name.erase(0, name.find_first_not_of(' '));
+        std::istringstream fields{line.substr(colon + 1)};
+        if_counters c;
+        uint64_t fifo, frame, compressed, multicast;
+        fields >> c.rx_bytes >> c.rx_packets >> c.rx_errors >> c.rx_dropped
+               >> fifo >> frame >> compressed >> multicast
+               >> c.tx_bytes >> c.tx_packets >> c.tx_errors >> c.tx_dropped;
+        if (fields) {
+            sample.interfaces.emplace(std::move(name), c);
+        }
+    }
+    return sample;
 }
 
-std::string invokeNetem() {
-    using namespace boost::process;
-    ipstream pipe_stream;
-    child c("tc qdisc add dev eth0 root netem corrupt 25% 50%", std_out > pipe_stream);
-
-    std::string line;
-    std::stringstream ss;
+std::string netstat_json(const net_sample& now, const net_sample& before) {
+    const std::chrono::duration<double> elapsed{now.taken - before.taken};
+    const bool have_rates{!before.interfaces.empty() && elapsed.count() > 0};
+    std::ostringstream out;
+    out << "{\"kernel\":{";
+    bool first{true};
+    for (const auto& item : now.interfaces) {
+        if_counters d{item.second};
+        const auto prev{before.interfaces.find(item.first)};
+        // a counter which went backwards was reset, so report it afresh
+        auto delta = [](uint64_t current, uint64_t previous) {
+            return current >= previous ? current - previous : current;
+        };
+        if (prev != before.interfaces.end()) {
+            const if_counters& p{prev->second};
+            d.rx_bytes = delta(d.rx_bytes, p.rx_bytes);
+            d.rx_packets = delta(d.rx_packets, p.rx_packets);
+            d.rx_errors = delta(d.rx_errors, p.rx_errors);
+            d.rx_dropped = delta(d.rx_dropped, p.rx_dropped);
+            d.tx_bytes = delta(d.tx_bytes, p.tx_bytes);
+            d.tx_packets = delta(d.tx_packets, p.tx_packets);
+            d.tx_errors = delta(d.tx_errors, p.tx_errors);
+            d.tx_dropped = delta(d.tx_dropped, p.tx_dropped);
+        }
+        out << (first ? "" : ",") << '"' << item.first << "\":{"
+            << "\"rx_packets\":" << d.rx_packets
+            << ",\"rx_bytes\":" << d.rx_bytes
+            << ",\"rx_errors\":" << d.rx_errors
+            << ",\"rx_dropped\":" << d.rx_dropped
+            << ",\"tx_packets\":" << d.tx_packets
+            << ",\"tx_bytes\":" << d.tx_bytes
+            << ",\"tx_errors\":" << d.tx_errors
+            << ",\"tx_dropped\":" << d.tx_dropped;
+        if (have_rates) {
+            out << ",\"rx_bytes_per_sec\":" << static_cast<uint64_t>(d.rx_bytes / elapsed.count())
+                << ",\"tx_bytes_per_sec\":" << static_cast<uint64_t>(d.tx_bytes / elapsed.count());
+        }
+        out << '}';
+        first = false;
+    }
+    out << "}}";
+    return out.str();
+}
 
-    while (pipe_stream && std::getline(pipe_stream, line) && !line.empty())
-        ss << line << '\n';
+// One request for the meter transaction metrics which APsim serves on the
+// loopback interface; the pending operations keep it alive
+struct metrics_fetch {
+    explicit metrics_fetch(boost::asio::io_context& context)
+        : sock{context}
+        , deadline{context}
+    { }
 
-    c.wait();
-    return ss.str();
-}
+    tcp::socket sock;
+    boost::asio::steady_timer deadline;
+    std::string report;
+};
 
 // Report a failure
 static void fail(boost::system::error_code ec, char const* what) {
     std::cerr << what << ": " << ec.message() << "\n";
 }
 
+// how often subscribed sessions are sent network statistics
+static const std::chrono::seconds push_interval{1};
+
+// where APsim serves its metrics, and how long it may take to answer
+static const unsigned short metrics_port{9101};
+static const std::chrono::seconds metrics_timeout{2};
+
 // Take ownership of the socket
 session::session(tcp::socket socket)
     : ws(std::move(socket))
     , strand(ws.get_executor())
+    , push_timer(ws.get_executor().context())
 { }
 
+// The statistics since the last ones this session was sent
+std::string session::next_netstat() {
+    net_sample sample{read_net_dev()};
+    std::string json{netstat_json(sample, last_sample)};
+    last_sample = std::move(sample);
+    return json + '\n';
+}
+
+// Queue a message, starting the writer if it is idle
+void session::send(std::string message) {
+    outbox.push_back(std::move(message));
+    if (outbox.size() == 1) {
+        do_write();
+    }
+}
+
+void session::do_write() {
+    ws.text(true);
+    ws.async_write(
+        boost::asio::buffer(outbox.front()),
+        boost::asio::bind_executor(
+            strand,
+            std::bind(
+                &session::on_write,
+                shared_from_this(),
+                std::placeholders::_1,
+                std::placeholders::_2
+            )
+        )
+    );
+}
+
+// Ask APsim for its metrics without holding up the other sessions; if
+// APsim isn't running, or doesn't answer in time, there is nothing to report
+void session::fetch_metrics() {
+    auto fetch{std::make_shared<metrics_fetch>(ws.get_executor().context())};
+    auto self{shared_from_this()};
+    auto finish = [this, fetch](bool ok) {
+        fetch->deadline.cancel();
+        send(ok ? fetch->report : "{error:metrics_unavailable}");
+    };
+    fetch->deadline.expires_after(metrics_timeout);
+    fetch->deadline.async_wait(
+        boost::asio::bind_executor(
+            strand,
+            [fetch](boost::system::error_code ec) {
+                if (!ec) {
+                    // the pending connect or read then fails
+                    boost::system::error_code ignored;
+                    fetch->sock.close(ignored);
+                }
+            }
+        )
+    );
+    fetch->sock.async_connect(
+        tcp::endpoint{boost::asio::ip::address_v6::loopback(), metrics_port},
+        boost::asio::bind_executor(
+            strand,
+            [this, self, fetch, finish](boost::system::error_code ec) {
+                if (ec) {
+                    finish(false);
+                    return;
+                }
+                // APsim closes the connection once the report is sent
+                boost::asio::async_read(
+                    fetch->sock,
+                    boost::asio::dynamic_buffer(fetch->report),
+                    boost::asio::bind_executor(
+                        strand,
+                        [self, finish](boost::system::error_code ec, std::size_t) {
+                            finish(ec == boost::asio::error::eof);
+                        }
+                    )
+                );
+            }
+        )
+    );
+}
+
+void session::start_push() {
+    push_timer.expires_after(push_interval);
+    push_timer.async_wait(
+        boost::asio::bind_executor(
+            strand,
+            std::bind(
+                &session::on_push,
+                shared_from_this(),
+                std::placeholders::_1
+            )
+        )
+    );
+}
+
+void session::on_push(boost::system::error_code ec) {
+    if (ec) {
+        return;
+    }
+    // don't let a slow reader pile up samples; it gets the combined delta
+    // with the next one instead
+    if (outbox.empty()) {
+        send(next_netstat());
+    }
+    start_push();
+}
+
 // Start the asynchronous operation
 void session::run() {
     // Accept the websocket handshake
@@ -174,35 +344,34 @@ void session::on_read(boost::system::error_code ec, std::size_t bytes_transferre
     boost::ignore_unused(bytes_transferred);
 
     if (ec == websocket::error::closed) {
+        push_timer.cancel();
         return;
     }
 
     if (ec) {
         fail(ec, "read");
+        push_timer.cancel();
+        return;
     }
 
-    // Echo the message
-    ws.text(ws.got_text());
-    if (buffers_to_string(buffer.data()) == "{netstat}") {
-        buffer.consume(buffer.size());
-        ostream(buffer) << fetchNetStats() << '\n';
+    const std::string command{buffers_to_string(buffer.data())};
+    buffer.consume(buffer.size());
+    if (command == "{netstat}") {
+        send(next_netstat());
+    } else if (command == "{subscribe:netstat}") {
+        send(next_netstat());
+        if (!subscribed) {
+            subscribed = true;
+            start_push();
+        }
+    } else if (command == "{metrics}") {
+        fetch_metrics();
     } else {
-        // uncomment this to echo back the faulty command
-        // buffer.consume(buffer.size());  
-        ostream(buffer) << "{error:unknown_command}\n";
+        send("{error:unknown_command}\n");
     }
-    ws.async_write(
-        buffer.data(),
-        boost::asio::bind_executor(
-            strand,
-            std::bind(
-                &session::on_write,
-                shared_from_this(),
-                std::placeholders::_1,
-                std::placeholders::_2
-            )
-        )
-    );
+
+    // Do another read while the reply goes out
+    do_read();
 }
 
 void session::on_write(boost::system::error_code ec, std::size_t bytes_transferred) {
@@ -210,14 +379,14 @@ void session::on_write(boost::system::error_code ec, std::size_t bytes_transferr
 
     if (ec) {
         fail(ec, "write");
+        push_timer.cancel();
         return;
     }
 
-    // Clear the buffer
-    buffer.consume(buffer.size());
-
-    // Do another read
-    do_read();
+    outbox.pop_front();
+    if (!outbox.empty()) {
+        do_write();
+    }
 }
 
 
@@ -311,7 +480,7 @@ int main(int argc, char *argv[]) {
         usage();
         return 1;
     }
-    std::cout << fetchNetStats() << '\n';
+    std::cout << netstat_json(read_net_dev(), net_sample{}) << '\n';
     // just camp here, waiting for network connections
     server(port);
 }
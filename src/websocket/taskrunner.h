@@ -77,15 +77,62 @@
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
 #include <memory>
+#include <string>
 
 //------------------------------------------------------------------------------
 
-// Echoes back all received WebSocket messages
+// Counters for one network interface, as found in /proc/net/dev
+struct if_counters {
+    uint64_t rx_bytes{0};
+    uint64_t rx_packets{0};
+    uint64_t rx_errors{0};
+    uint64_t rx_dropped{0};
+    uint64_t tx_bytes{0};
+    uint64_t tx_packets{0};
+    uint64_t tx_errors{0};
+    uint64_t tx_dropped{0};
+};
+
+// Counters for every interface, keyed by interface name, and when they were read
+struct net_sample {
+    std::chrono::steady_clock::time_point taken{};
+    std::map<std::string, if_counters> interfaces;
+};
+
+// Reads the kernel's interface counters without forking anything
+net_sample read_net_dev();
+
+// Formats the change from before to now the way `ifstat -j` does, plus
+// byte rates; an empty before gives the absolute counters
+std::string netstat_json(const net_sample& now, const net_sample& before);
+
+//------------------------------------------------------------------------------
+
+// Answers commands sent over the WebSocket, and pushes network statistics
+// to the session once it has subscribed to them
 class session : public std::enable_shared_from_this<session> {
     boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws;
     boost::asio::strand<boost::asio::io_context::executor_type> strand;
     boost::beast::multi_buffer buffer;
+    // replies and pushes waiting to be written, front one in progress
+    std::deque<std::string> outbox;
+    // netstat deltas are relative to the last sample sent to this session
+    net_sample last_sample;
+    boost::asio::steady_timer push_timer;
+    bool subscribed{false};
+
+    std::string next_netstat();
+    void send(std::string message);
+    void do_write();
+    void start_push();
+    void on_push(boost::system::error_code ec);
+    void fetch_metrics();
 
 public:
     // Take ownership of the socket